@@ -0,0 +1,255 @@
+/**
+ * @file BackendBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Epoll compared to io_uring server backend at growing connection
+ * counts
+ *
+ * Usage: BackendBench [port]
+ *
+ * Starts one single-reactor server per backend in child processes. For
+ * every connection count, all connections keep one request in flight, and
+ * round trip latency percentiles are reported together with CPU time and
+ * context switches of the server reactor per request, taken from procfs.
+ * Build with `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-17
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Client/Client.hpp"
+#include "Client/ClientLoop.hpp"
+#include "Client/LatencyHistogram.hpp"
+#include "Message/Message.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using message::Message;
+using client::Client;
+using client::ClientLoop;
+using client::LatencyHistogram;
+using Clock = std::chrono::steady_clock;
+using bench::connect_with_retry;
+using bench::start_server;
+using bench::stop_server;
+
+static constexpr size_t CommentCount = 1024;
+static constexpr size_t CommentSize = 64;
+static constexpr size_t Requests = 40000;
+static constexpr size_t Warmup = 4000;
+static constexpr size_t ConnectionCounts[] = { 16, 256, 1024 };
+
+/**
+ * @brief Resource usage of server reactor, which is its main thread
+ */
+struct ServerUsage {
+  uint64_t cpu_ns = 0;
+  uint64_t context_switches = 0;
+
+  static ServerUsage read(pid_t server) {
+    ServerUsage usage;
+
+    std::string path = "/proc/" + std::to_string(server) + "/schedstat";
+    if (FILE* file = fopen(path.c_str(), "r")) {
+      unsigned long long cpu_ns = 0;
+      if (fscanf(file, "%llu", &cpu_ns) == 1) {
+        usage.cpu_ns = cpu_ns;
+      }
+      fclose(file);
+    }
+
+    path = "/proc/" + std::to_string(server) + "/status";
+    if (FILE* file = fopen(path.c_str(), "r")) {
+      char line[256];
+      unsigned long long count = 0;
+      while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "voluntary_ctxt_switches: %llu", &count) == 1 ||
+            sscanf(line, "nonvoluntary_ctxt_switches: %llu", &count) == 1) {
+          usage.context_switches += count;
+        }
+      }
+      fclose(file);
+    }
+
+    return usage;
+  }
+};
+
+/**
+ * @brief Keep one request in flight on every connection until `Requests`
+ * responses are recorded after warmup
+ *
+ * @return No request failed
+ */
+static bool bench_backend(
+    const char* backend,
+    pid_t server,
+    std::vector<std::unique_ptr<Client>>& clients,
+    const Message& request
+) {
+  ClientLoop loop;
+  for (auto& client : clients) {
+    loop.add(*client);
+  }
+
+  LatencyHistogram latency;
+  size_t completed = 0;
+  size_t errors = 0;
+  ServerUsage before;
+
+  // Every response immediately issues next request on its connection
+  std::function<void(Client&)> issue = [&](Client& client) {
+    const auto start = Clock::now();
+    client.request(request,
+        [&, start](std::optional<message::MessageView> response) {
+          if (!response.has_value()) {
+            ++errors;
+            return;
+          }
+
+          if (++completed == Warmup) {
+            before = ServerUsage::read(server);
+          } else if (completed > Warmup) {
+            latency.record((uint64_t) std::chrono::duration_cast<
+                std::chrono::nanoseconds>(Clock::now() - start).count());
+          }
+          if (completed < Warmup + Requests) {
+            issue(client);
+          }
+        }
+    );
+  };
+
+  for (auto& client : clients) {
+    issue(*client);
+  }
+
+  while (completed < Warmup + Requests && errors == 0) {
+    loop.runOnce(1000);
+  }
+  const ServerUsage after = ServerUsage::read(server);
+
+  // Wait for requests which were still in flight
+  bool in_flight = true;
+  while (in_flight && errors == 0) {
+    in_flight = false;
+    for (auto& client : clients) {
+      in_flight = in_flight || client->inFlight() > 0;
+    }
+    if (in_flight) {
+      loop.runOnce(1000);
+    }
+  }
+  for (auto& client : clients) {
+    loop.remove(*client);
+  }
+
+  if (errors > 0) {
+    fprintf(stderr, "%s: %zu requests failed\n", backend, errors);
+    return false;
+  }
+
+  constexpr double NsPerUs = 1e3;
+  const double requests = (double) latency.count();
+  printf("%-9s %6zu %9.1f %9.1f %9.1f %12.2f %12.4f\n",
+      backend,
+      clients.size(),
+      (double) latency.percentile(50) / NsPerUs,
+      (double) latency.percentile(99) / NsPerUs,
+      (double) latency.percentile(99.9) / NsPerUs,
+      (double) (after.cpu_ns - before.cpu_ns) / NsPerUs / requests,
+      (double) (after.context_switches - before.context_switches) / requests
+  );
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 9104;
+  if (argc > 1) {
+    port = (uint16_t) strtoul(argv[1], NULL, 10);
+  }
+
+  struct Backend {
+    const char* name;
+    server::IoBackend io_backend;
+    uint16_t port;
+    pid_t server;
+  };
+  Backend backends[] = {
+    { "epoll", server::IoBackend::Epoll, port, -1 },
+    { "io_uring", server::IoBackend::IoUring, (uint16_t) (port + 1), -1 },
+  };
+
+  if (server::select_io_backend(server::IoBackend::IoUring)
+      != server::IoBackend::IoUring) {
+    fprintf(stderr, "io_uring is not supported, comparing epoll to itself\n");
+  }
+
+  for (Backend& backend : backends) {
+    server::ServerConfig config;
+    config.io_backend = backend.io_backend;
+    backend.server = start_server(backend.port, config);
+  }
+
+  bool success = true;
+  const std::string comment(CommentSize, 'c');
+  const Message request = Message::getComments(0, 16);
+
+  printf("Round trip latency, one request in flight per connection, "
+         "%zu requests\n", Requests);
+  printf("%-9s %6s %9s %9s %9s %12s %12s\n",
+      "", "conns", "p50 us", "p99 us", "p99.9 us", "cpu us/req", "ctxsw/req");
+
+  for (const Backend& backend : backends) {
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<std::string> comments(CommentCount, comment);
+
+    for (size_t count : ConnectionCounts) {
+      while (success && clients.size() < count) {
+        auto client = connect_with_retry(backend.port);
+        success = client != nullptr;
+        clients.push_back(std::move(client));
+      }
+      if (!success) {
+        fprintf(stderr, "Server is not reachable on port %hu\n", backend.port);
+        break;
+      }
+
+      if (count == ConnectionCounts[0]) {
+        clients[0]->request(Message::newCommentsBatch(comments), nullptr);
+        ClientLoop loop;
+        loop.add(*clients[0]);
+        while (clients[0]->inFlight() > 0 && !clients[0]->isClosed()) {
+          loop.runOnce(1000);
+        }
+        loop.remove(*clients[0]);
+      }
+
+      success = success
+        && bench_backend(backend.name, backend.server, clients, request);
+    }
+
+    for (auto& client : clients) {
+      if (client != nullptr) {
+        client->post(Message::goodbye());
+        client->flush();
+      }
+    }
+  }
+
+  for (const Backend& backend : backends) {
+    stop_server(backend.server);
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include "BenchServer.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace bench {
+
+uint8_t s_loopback[4] = { 127, 0, 0, 1 };
+
+pid_t start_server(uint16_t port, const server::ServerConfig& config) {
+  fflush(stdout);
+  pid_t server = fork();
+  if (server != 0) {
+    return server;
+  }
+
+  freopen("/dev/null", "w", stdout);
+  server::listen_tcp(s_loopback, port, config);
+  _exit(0);
+}
+
+void stop_server(pid_t server) {
+  kill(server, SIGINT);
+  waitpid(server, NULL, 0);
+}
+
+std::unique_ptr<client::Client> connect_with_retry(
+    const std::function<std::unique_ptr<client::Client>(void)>& connect
+) {
+  for (size_t attempt = 0; attempt < 500; ++attempt) {
+    auto client = connect();
+    if (client != nullptr) {
+      return client;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+std::unique_ptr<client::Client> connect_with_retry(
+    uint16_t port,
+    uint32_t capabilities
+) {
+  return connect_with_retry([port, capabilities] {
+    return client::Client::connect(s_loopback, port, capabilities);
+  });
+}
+
+} // namespace bench
@@ -0,0 +1,58 @@
+/**
+ * @file BenchServer.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Server under benchmark, running in a child process on loopback
+ *
+ * Benchmarks fork server with `start_server()`, wait for it with
+ * `connect_with_retry()` and stop it with `stop_server()`. Output of the
+ * child is discarded, so that it does not mix with benchmark results.
+ *
+ * @version 0.0.1
+ * @date 2024-11-23
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __BENCH_BENCH_SERVER_HPP
+#define __BENCH_BENCH_SERVER_HPP
+
+#include "Client/Client.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <sys/types.h>
+
+namespace bench {
+
+extern uint8_t s_loopback[4];
+
+/**
+ * @brief Fork server listening on loopback `port`
+ *
+ * @return Server process
+ */
+pid_t start_server(uint16_t port, const server::ServerConfig& config = {});
+
+void stop_server(pid_t server);
+
+/**
+ * @brief Retry until server child is ready to accept connections
+ *
+ * @return Connected client, or `nullptr` if server did not come up within
+ * five seconds
+ */
+std::unique_ptr<client::Client> connect_with_retry(
+    const std::function<std::unique_ptr<client::Client>(void)>& connect
+);
+
+std::unique_ptr<client::Client> connect_with_retry(
+    uint16_t port,
+    uint32_t capabilities = 0
+);
+
+} // namespace bench
+
+#endif /* BenchServer.hpp */
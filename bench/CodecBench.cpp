@@ -0,0 +1,415 @@
+/**
+ * @file CodecBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Microbenchmarks of message encoding and decoding
+ *
+ * Usage: CodecBench [filter]
+ *
+ * Runs every benchmark whose name contains `filter` and reports time per
+ * operation, processed message bytes per second and heap allocations per
+ * operation. Build with `make codec-bench`, which uses Release flags.
+ *
+ * Before measuring, vectorized comment splitters are checked against the
+ * scalar reference on random payloads and indexed and annotated responses
+ * are checked against plain ones. The run fails on mismatch.
+ *
+ * @version 0.0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Message/CommentSplitter.hpp"
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+#include "Message/SendCommentsMessage.hpp"
+#include "Storage/CommentStore.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using message::Message;
+using Clock = std::chrono::steady_clock;
+
+static size_t s_allocations = 0;
+
+void* operator new(size_t size) {
+  ++s_allocations;
+  void* memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+/**
+ * @brief Make compiler assume value is used
+ */
+template <typename T>
+static inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+  double ns_per_op;
+  double bytes_per_sec;
+  double allocs_per_op;
+};
+
+static const char* s_filter = "";
+
+/**
+ * @brief Run `op` repeatedly for about `MinTime`, several times, and report
+ * the fastest repetition
+ *
+ * @param[in] name          Benchmark name
+ * @param[in] bytes_per_op  Message bytes processed by one operation
+ * @param[in] op            Operation
+ */
+template <typename Op>
+static void run(const char* name, size_t bytes_per_op, Op&& op) {
+  constexpr auto MinTime = std::chrono::milliseconds(100);
+  constexpr size_t Repetitions = 5;
+
+  if (strstr(name, s_filter) == nullptr) {
+    return;
+  }
+
+  // Find iteration count which takes long enough to time reliably
+  size_t iterations = 1;
+  for (;;) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      op();
+    }
+    if (Clock::now() - start >= MinTime / 10) {
+      break;
+    }
+    iterations *= 2;
+  }
+  iterations *= 10;
+
+  Result best = { .ns_per_op = 1e300, .bytes_per_sec = 0, .allocs_per_op = 0 };
+  for (size_t rep = 0; rep < Repetitions; ++rep) {
+    size_t allocations = s_allocations;
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      op();
+    }
+    double elapsed =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    allocations = s_allocations - allocations;
+
+    double ns_per_op = elapsed / (double) iterations;
+    if (ns_per_op < best.ns_per_op) {
+      best.ns_per_op = ns_per_op;
+      best.bytes_per_sec = (double) bytes_per_op / ns_per_op * 1e9;
+      best.allocs_per_op = (double) allocations / (double) iterations;
+    }
+  }
+
+  printf("%-40s %12.1f %12.1f %10.2f\n",
+      name,
+      best.ns_per_op,
+      best.bytes_per_sec / (1024 * 1024),
+      best.allocs_per_op
+  );
+}
+
+static void fill_store(
+    storage::CommentStore& store,
+    size_t count,
+    size_t comment_size
+) {
+  std::string comment(comment_size, 'c');
+  for (size_t i = 0; i < count; ++i) {
+    comment[i % comment_size] = (char) ('a' + i % 26);
+    store.append(comment);
+  }
+}
+
+static void bench_new_comment(void) {
+  for (size_t size : { 16, 256, 4096, 65536 }) {
+    std::string comment(size, 'x');
+    Message message = Message::newComment(comment);
+    auto bytes = message.getBytes();
+
+    char name[64] = "";
+    snprintf(name, sizeof(name), "newComment/%zu", size);
+    run(name, bytes.size(), [&] {
+      Message encoded = Message::newComment(comment);
+      keep(encoded.getBytes().data());
+    });
+
+    snprintf(name, sizeof(name), "fromBytes/NewComment/%zu", size);
+    run(name, bytes.size(), [&] {
+      size_t message_size = 0;
+      auto decoded = Message::fromBytes(bytes, message_size);
+      keep(decoded->getBytes().data());
+    });
+
+    snprintf(name, sizeof(name), "MessageView/NewComment/%zu", size);
+    run(name, bytes.size(), [&] {
+      size_t message_size = 0;
+      auto view = message::MessageView::fromBytes(bytes, message_size);
+      keep(view->getBytes().data());
+    });
+
+    snprintf(name, sizeof(name), "getBytes/NewComment/%zu", size);
+    run(name, bytes.size(), [&] {
+      auto encoded = message.getBytes();
+      keep(encoded.data());
+    });
+  }
+}
+
+static void bench_comments_response(void) {
+  constexpr size_t MaxCount = 4096;
+
+  for (size_t comment_size : { 16, 256 }) {
+    storage::CommentStore store;
+    fill_store(store, MaxCount, comment_size);
+    auto snapshot = store.snapshot();
+
+    for (size_t count : { 1, 16, 256, 4096 }) {
+      Message message = Message::sendComments(snapshot, 0, count);
+      auto bytes = message.getBytes();
+
+      char name[64] = "";
+      snprintf(name, sizeof(name), "sendComments/%zux%zu", count, comment_size);
+      run(name, bytes.size(), [&] {
+        Message encoded = Message::sendComments(snapshot, 0, count);
+        keep(encoded.getBytes().data());
+      });
+
+      snprintf(name, sizeof(name),
+          "fromBytes/CommentsResponse/%zux%zu", count, comment_size);
+      run(name, bytes.size(), [&] {
+        size_t message_size = 0;
+        auto decoded = Message::fromBytes(bytes, message_size);
+        keep(decoded->getBytes().data());
+      });
+
+      snprintf(name, sizeof(name),
+          "SendCommentsMessage/%zux%zu", count, comment_size);
+      run(name, bytes.size(), [&] {
+        auto decoded = message::SendCommentsMessage::fromView(message.view());
+        keep(decoded->getCount());
+      });
+
+      Message indexed = Message::sendComments(
+          snapshot, 0, count, Message::ResponseEncoding::Indexed
+      );
+
+      snprintf(name, sizeof(name),
+          "sendComments/indexed/%zux%zu", count, comment_size);
+      run(name, indexed.getBytes().size(), [&] {
+        Message encoded = Message::sendComments(
+            snapshot, 0, count, Message::ResponseEncoding::Indexed
+        );
+        keep(encoded.getBytes().data());
+      });
+
+      Message annotated = Message::sendComments(
+          snapshot, 0, count, Message::ResponseEncoding::Annotated
+      );
+
+      snprintf(name, sizeof(name),
+          "sendComments/annotated/%zux%zu", count, comment_size);
+      run(name, annotated.getBytes().size(), [&] {
+        Message encoded = Message::sendComments(
+            snapshot, 0, count, Message::ResponseEncoding::Annotated
+        );
+        keep(encoded.getBytes().data());
+      });
+
+      // Construct and read the last comment, the worst case for scanning
+      snprintf(name, sizeof(name),
+          "SendCommentsMessage/last/%zux%zu", count, comment_size);
+      run(name, bytes.size(), [&] {
+        auto decoded = message::SendCommentsMessage::fromView(message.view());
+        keep((*decoded)[count - 1].data());
+      });
+
+      snprintf(name, sizeof(name),
+          "SendCommentsMessage/indexed/last/%zux%zu", count, comment_size);
+      run(name, indexed.getBytes().size(), [&] {
+        auto decoded = message::SendCommentsMessage::fromView(indexed.view());
+        keep((*decoded)[count - 1].data());
+      });
+    }
+  }
+}
+
+struct Splitter {
+  const char* name;
+  void (*split)(std::span<const char>, message::CommentList&);
+};
+
+static std::vector<Splitter> available_splitters(void) {
+  std::vector<Splitter> splitters = {
+    { "scalar", message::split_comments_scalar },
+    { "dispatch", message::split_comments },
+  };
+#ifdef __x86_64__
+  splitters.push_back({ "sse2", message::split_comments_sse2 });
+  if (message::has_avx2()) {
+    splitters.push_back({ "avx2", message::split_comments_avx2 });
+  }
+#endif
+  return splitters;
+}
+
+/**
+ * @brief Compare every splitter with scalar reference
+ *
+ * @return All splitters agree
+ */
+static bool check_splitters(void) {
+  constexpr size_t Rounds = 2000;
+  constexpr size_t MaxSize = 300;
+
+  auto splitters = available_splitters();
+  std::mt19937 random(42);
+  std::vector<char> chars;
+
+  for (size_t round = 0; round < Rounds; ++round) {
+    // Vary both length and NUL density, including no NULs and all NULs
+    size_t size = random() % MaxSize;
+    unsigned nul_percent = (unsigned) (round % 11) * 10;
+    chars.resize(size);
+    for (char& c : chars) {
+      c = random() % 100 < nul_percent ? '\0' : (char) ('a' + random() % 26);
+    }
+
+    // Offset start to exercise unaligned loads
+    size_t skip = size > 0 ? random() % std::min<size_t>(size, 40) : 0;
+    auto input = std::span<const char>(chars).subspan(skip);
+
+    message::CommentList expected;
+    message::split_comments_scalar(input, expected);
+
+    for (const Splitter& splitter : splitters) {
+      message::CommentList actual;
+      splitter.split(input, actual);
+
+      bool equal = std::equal(
+          expected.begin(), expected.end(), actual.begin(), actual.end(),
+          [](auto lhs, auto rhs) {
+            return lhs.data() == rhs.data() && lhs.size() == rhs.size();
+          }
+      );
+      if (!equal) {
+        fprintf(stderr, "Splitter '%s' differs from scalar on round %zu\n",
+            splitter.name, round);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Compare indexed and annotated decoding of the same responses to
+ * plain one, and annotations to stored metadata
+ *
+ * @return All decodings agree
+ */
+static bool check_indexed(void) {
+  storage::CommentStore store;
+  std::string comment;
+  for (size_t i = 0; i < 300; ++i) {
+    store.append(comment, (uint32_t) (i % 7));
+    comment.push_back((char) ('a' + i % 26));
+  }
+  auto snapshot = store.snapshot();
+
+  using Encoding = Message::ResponseEncoding;
+  for (Encoding encoding : { Encoding::Indexed, Encoding::Annotated }) {
+    for (size_t count : { 0, 1, 2, 17, 300 }) {
+      Message plain = Message::sendComments(snapshot, 0, count);
+      Message tabled = Message::sendComments(snapshot, 0, count, encoding);
+      auto expected = message::SendCommentsMessage::fromView(plain.view());
+      auto actual = message::SendCommentsMessage::fromView(tabled.view());
+
+      bool equal = actual.has_value() && actual->getCount() == count
+                   && expected->getCount() == count
+                   && actual->hasMetadata() == (encoding == Encoding::Annotated);
+      for (size_t i = 0; equal && i < count; ++i) {
+        equal = std::ranges::equal((*expected)[i], (*actual)[i]);
+        if (equal && actual->hasMetadata()) {
+          equal = actual->getTimestamp(i) == snapshot.record(i).timestamp
+                  && actual->getAuthor(i) == snapshot.record(i).author;
+        }
+      }
+      if (!equal) {
+        fprintf(stderr, "%s response of %zu comments differs\n",
+            encoding == Encoding::Indexed ? "Indexed" : "Annotated", count);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static void bench_split(void) {
+  for (size_t comment_size : { 16, 256 }) {
+    constexpr size_t Count = 4096;
+
+    std::vector<char> chars;
+    for (size_t i = 0; i < Count; ++i) {
+      chars.insert(chars.end(), comment_size, 'x');
+      chars.push_back('\0');
+    }
+
+    message::CommentList comments;
+    comments.reserve(Count);
+
+    for (const Splitter& splitter : available_splitters()) {
+      char name[64] = "";
+      snprintf(name, sizeof(name),
+          "split/%s/%zux%zu", splitter.name, Count, comment_size);
+      run(name, chars.size(), [&] {
+        comments.clear();
+        splitter.split(chars, comments);
+        keep(comments.data());
+      });
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    s_filter = argv[1];
+  }
+
+  if (!check_splitters() || !check_indexed()) {
+    return 1;
+  }
+
+  printf("%-40s %12s %12s %10s\n", "benchmark", "ns/op", "MiB/s", "allocs/op");
+
+  bench_new_comment();
+  bench_comments_response();
+  bench_split();
+
+  return 0;
+}
@@ -0,0 +1,301 @@
+/**
+ * @file CompressionBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Compression codec speed and end-to-end cost of compressed responses
+ *
+ * Usage: CompressionBench [port]
+ *
+ * First measures compression ratio and speed of the block codec on comment
+ * text and on random bytes. Then starts server in a child process, uploads
+ * comments and fetches pages of them with and without compression agreed
+ * on in Hello, reporting bytes on the wire and CPU time of client and
+ * server per request. Build with `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-14
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Client/Client.hpp"
+#include "Message/Compression.hpp"
+#include "Message/Message.hpp"
+#include "Message/SendCommentsMessage.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using message::Message;
+using client::Client;
+using Clock = std::chrono::steady_clock;
+using bench::connect_with_retry;
+using bench::start_server;
+using bench::stop_server;
+
+static constexpr size_t CommentCount = 4096;
+static constexpr uint32_t PageSize = 64;
+static constexpr size_t Requests = 20000;
+static constexpr size_t Depth = 16;
+
+/**
+ * @brief Comment made of words from small vocabulary, like chat text
+ */
+static std::string make_comment(std::mt19937& random) {
+  static const char* const words[] = {
+    "the", "server", "comment", "is", "really", "fast", "and", "I", "think",
+    "that", "response", "latency", "should", "be", "lower", "than", "before",
+    "great", "work", "thanks", "for", "sharing", "this", "with", "everyone",
+  };
+  constexpr size_t WordCount = sizeof(words) / sizeof(*words);
+
+  std::string comment = "user" + std::to_string(random() % 1000) + ":";
+  size_t length = 8 + random() % 24;
+  for (size_t i = 0; i < length; ++i) {
+    comment += ' ';
+    comment += words[random() % WordCount];
+  }
+  return comment;
+}
+
+static void bench_codec(
+    const char* name,
+    const std::vector<std::byte>& input
+) {
+  constexpr auto MinTime = std::chrono::milliseconds(200);
+
+  std::vector<std::byte> compressed;
+  message::lz_compress(input, compressed);
+  std::vector<std::byte> restored(input.size());
+  if (!message::lz_decompress(compressed, restored) || restored != input) {
+    fprintf(stderr, "Codec round trip failed on %s\n", name);
+    exit(1);
+  }
+
+  size_t iterations = 0;
+  auto start = Clock::now();
+  while (Clock::now() - start < MinTime) {
+    compressed.clear();
+    message::lz_compress(input, compressed);
+    ++iterations;
+  }
+  double compress_sec =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  double compress_rate = (double) (input.size() * iterations) / compress_sec;
+
+  iterations = 0;
+  start = Clock::now();
+  while (Clock::now() - start < MinTime) {
+    message::lz_decompress(compressed, restored);
+    ++iterations;
+  }
+  double decompress_sec =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  double decompress_rate = (double) (input.size() * iterations) / decompress_sec;
+
+  printf("%-24s %10zu %10zu %8.2f %12.1f %12.1f\n",
+      name,
+      input.size(),
+      compressed.size(),
+      (double) input.size() / (double) compressed.size(),
+      compress_rate / (1024 * 1024),
+      decompress_rate / (1024 * 1024)
+  );
+}
+
+/**
+ * @brief Write queued requests and read responses, blocking until some
+ * progress is possible, so that waiting does not count as client CPU time
+ */
+static void exchange(Client& client) {
+  client.flush();
+  if (client.poll() > 0 || client.isClosed()) {
+    return;
+  }
+
+  struct pollfd socket = {
+    .fd = client.getSocket(),
+    .events = (short) (POLLIN | (client.wantsWrite() ? POLLOUT : 0)),
+    .revents = 0
+  };
+  ::poll(&socket, 1, 100);
+}
+
+/**
+ * @brief Wait until every request of client is answered
+ */
+static bool drain(Client& client) {
+  while (client.inFlight() > 0 && !client.isClosed()) {
+    exchange(client);
+  }
+  return !client.isClosed();
+}
+
+/**
+ * @brief CPU time used by process, in seconds
+ */
+static double cpu_seconds(const struct rusage& usage) {
+  return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+/**
+ * @brief CPU time used by another process so far, in seconds
+ */
+static double process_cpu_seconds(pid_t pid) {
+  char path[64] = "";
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+  FILE* stat = fopen(path, "r");
+  if (stat == nullptr) {
+    return 0;
+  }
+
+  // Fields 14 and 15 are user and system time, command name may have spaces
+  unsigned long user = 0;
+  unsigned long system = 0;
+  int result = fscanf(stat,
+      "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+      &user, &system
+  );
+  fclose(stat);
+  if (result != 2) {
+    return 0;
+  }
+
+  return (double) (user + system) / (double) sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * @brief Fetch pages of comments with given capabilities and report costs
+ *
+ * @return No request failed
+ */
+static bool bench_requests(
+    const char* name,
+    uint16_t port,
+    pid_t server,
+    uint32_t capabilities
+) {
+  auto client = connect_with_retry(port, capabilities);
+  if (client == nullptr || !drain(*client)) {
+    fprintf(stderr, "Failed to connect to server\n");
+    return false;
+  }
+  if (client->getCapabilities() != capabilities) {
+    fprintf(stderr, "Server agreed to capabilities %#x instead of %#x\n",
+        client->getCapabilities(), capabilities);
+    return false;
+  }
+
+  const size_t sent_before = client->getBytesSent();
+  const size_t received_before = client->getBytesReceived();
+  struct rusage usage_before = {};
+  getrusage(RUSAGE_SELF, &usage_before);
+  const double server_before = process_cpu_seconds(server);
+  const auto start = Clock::now();
+
+  size_t issued = 0;
+  size_t errors = 0;
+  auto on_response = [&errors](std::optional<message::MessageView> response) {
+    if (!response.has_value() ||
+        !message::SendCommentsMessage::fromView(*response).has_value()) {
+      ++errors;
+    }
+  };
+  while (issued < Requests && !client->isClosed()) {
+    while (client->inFlight() < Depth && issued < Requests) {
+      uint32_t first = (uint32_t) ((issued * PageSize) % CommentCount);
+      client->request(Message::getComments(first, PageSize), on_response);
+      ++issued;
+    }
+    exchange(*client);
+  }
+  if (!drain(*client) || errors > 0) {
+    fprintf(stderr, "%zu requests failed\n", errors);
+    return false;
+  }
+
+  const double elapsed =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  const double server_cpu = process_cpu_seconds(server) - server_before;
+  struct rusage usage_after = {};
+  getrusage(RUSAGE_SELF, &usage_after);
+  const double client_cpu = cpu_seconds(usage_after) - cpu_seconds(usage_before);
+
+  constexpr double UsPerSec = 1e6;
+  printf("%-12s %10.1f %10.1f %10.2f %10.2f %12.0f\n",
+      name,
+      (double) (client->getBytesSent() - sent_before) / Requests,
+      (double) (client->getBytesReceived() - received_before) / Requests,
+      client_cpu * UsPerSec / Requests,
+      server_cpu * UsPerSec / Requests,
+      Requests / elapsed
+  );
+
+  client->post(Message::goodbye());
+  client->flush();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 9101;
+  if (argc > 1) {
+    port = (uint16_t) strtoul(argv[1], NULL, 10);
+  }
+
+  std::mt19937 random(42);
+  std::vector<std::string> comments;
+  std::vector<std::byte> text;
+  for (size_t i = 0; i < CommentCount; ++i) {
+    comments.push_back(make_comment(random));
+    auto bytes = std::as_bytes(std::span(comments.back()));
+    text.insert(text.end(), bytes.begin(), bytes.end());
+    text.push_back(std::byte{0});
+  }
+
+  std::vector<std::byte> noise(64 * 1024);
+  for (std::byte& byte : noise) {
+    byte = std::byte(random());
+  }
+
+  printf("%-24s %10s %10s %8s %12s %12s\n",
+      "input", "bytes", "compressed", "ratio", "comp MiB/s", "decomp MiB/s");
+  std::vector<std::byte> page(text.begin(), text.begin() + 4096);
+  bench_codec("comments/4KiB", page);
+  bench_codec("comments/all", text);
+  bench_codec("random/64KiB", noise);
+  printf("\n");
+
+  pid_t server = start_server(port);
+  auto uploader = connect_with_retry(port, 0);
+  if (uploader == nullptr) {
+    fprintf(stderr, "Server is not reachable on port %hu\n", port);
+    stop_server(server);
+    return 1;
+  }
+  uploader->request(Message::newCommentsBatch(comments), nullptr);
+  bool success = drain(*uploader);
+  uploader->post(Message::goodbye());
+  uploader->flush();
+
+  printf("%u comments per response, %zu requests, depth %zu\n",
+      PageSize, Requests, Depth);
+  printf("%-12s %10s %10s %10s %10s %12s\n",
+      "mode", "sent B/req", "recv B/req", "client us", "server us", "requests/s");
+  success = success
+    && bench_requests("plain", port, server, 0)
+    && bench_requests("compressed", port, server,
+                      Message::CapabilityCompression);
+
+  stop_server(server);
+  return success ? 0 : 1;
+}
@@ -0,0 +1,504 @@
+/**
+ * @file LoadGenerator.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Closed-loop load generator reporting throughput and latencies
+ *
+ * Usage: client-server-bench [-p port] [-c connections] [-t threads]
+ *                            [-d seconds] [-w write_percent] [-q depth]
+ *                            [-s comment_size] [-b batch_size]
+ *                            [-n page_size] [-i] [-u subscribers]
+ *                            [-S reactors] [-m]
+ *
+ * Every connection keeps `depth` requests in flight. A request is a write
+ * (NewComment, or NewCommentsBatch of `batch_size` comments) with
+ * probability `write_percent`, otherwise it reads the last `page_size`
+ * comments, in indexed encoding if `-i` is given. With `-u`, additional
+ * connections subscribe to new comments and report delivery latency, from
+ * sending a comment to receiving its push; written comments then carry
+ * their send time in the first 16 characters. With `-S` server is
+ * started in a child process, so that a run is reproducible with a single
+ * command. With `-m`, metrics reported by server are printed after the run.
+ *
+ * @version 0.0.1
+ * @date 2024-11-11
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Client/Client.hpp"
+#include "Client/ClientLoop.hpp"
+#include "Client/LatencyHistogram.hpp"
+#include "Message/Message.hpp"
+#include "Message/SendCommentsMessage.hpp"
+#include "Message/StatsMessage.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using message::Message;
+using client::Client;
+using client::ClientLoop;
+using client::LatencyHistogram;
+using Clock = std::chrono::steady_clock;
+using bench::connect_with_retry;
+using bench::s_loopback;
+using bench::start_server;
+using bench::stop_server;
+
+struct Options {
+  uint16_t port = 9100;
+  size_t connections = 64;
+  size_t threads = 4;
+  double seconds = 5;
+  unsigned write_percent = 90;
+  size_t depth = 16;
+  size_t comment_size = 64;
+  size_t batch_size = 0;
+  uint32_t page_size = 16;
+  bool indexed = false;
+  size_t subscribers = 0;
+  size_t server_reactors = 0;  // Do not start server if zero
+  bool server_stats = false;
+};
+
+struct ThreadStats {
+  LatencyHistogram writes{};
+  LatencyHistogram reads{};
+  LatencyHistogram pushes{};  // Delivery latency of every pushed comment
+  size_t errors = 0;
+};
+
+// Send time stamped into comment, as hexadecimal nanoseconds
+static constexpr size_t StampSize = 16;
+
+static uint64_t now_ns(void) {
+  return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now().time_since_epoch()
+  ).count();
+}
+
+class Worker final {
+public:
+  Worker(const Options& options, size_t seed)
+    : m_options(options),
+      m_random(seed * 0x9E3779B97F4A7C15ull + 1),
+      m_comment(options.comment_size, 'x'),
+      m_batch(options.batch_size, m_comment) {
+  }
+
+  bool connect(size_t connections, size_t subscribers) {
+    for (size_t i = 0; i < connections; ++i) {
+      auto client = Client::connect(s_loopback, m_options.port);
+      if (client == nullptr) {
+        return false;
+      }
+      m_loop.add(*client);
+      m_clients.push_back(std::move(client));
+    }
+
+    for (size_t i = 0; i < subscribers; ++i) {
+      auto client = Client::connect(s_loopback, m_options.port);
+      if (client == nullptr) {
+        return false;
+      }
+      subscribe(*client);
+      m_loop.add(*client);
+      m_subscribers.push_back(std::move(client));
+    }
+    return true;
+  }
+
+  void run(const std::atomic<bool>& running) {
+    m_issuing = true;
+    for (auto& client : m_clients) {
+      for (size_t i = 0; i < m_options.depth; ++i) {
+        issue(*client);
+      }
+    }
+
+    while (running.load(std::memory_order_relaxed)) {
+      m_loop.runOnce(10);
+    }
+
+    // Let requests in flight complete, so that their latency is counted
+    m_issuing = false;
+    auto deadline = Clock::now() + std::chrono::seconds(2);
+    while (inFlight() > 0 && Clock::now() < deadline) {
+      m_loop.runOnce(10);
+    }
+
+    for (auto& client : m_clients) {
+      client->post(Message::goodbye());
+      client->flush();
+    }
+    for (auto& client : m_subscribers) {
+      client->post(Message::goodbye());
+      client->flush();
+    }
+  }
+
+  const ThreadStats& getStats(void) const noexcept { return m_stats; }
+
+private:
+  size_t inFlight(void) const {
+    size_t count = 0;
+    for (const auto& client : m_clients) {
+      count += client->isClosed() ? 0 : client->inFlight();
+    }
+    return count;
+  }
+
+  uint64_t nextRandom(void) noexcept {
+    // xorshift64, deterministic for given seed
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 7;
+    m_random ^= m_random << 17;
+    return m_random;
+  }
+
+  /**
+   * @brief Subscribe to comments stored from now on
+   */
+  void subscribe(Client& client) {
+    // Page past the end carries only total number of comments
+    client.request(
+        Message::getComments(UINT32_MAX, 1),
+        [this, &client](std::optional<message::MessageView> response) {
+          auto page = response.has_value()
+            ? message::SendCommentsMessage::fromView(*response)
+            : std::nullopt;
+          if (!page.has_value()) {
+            ++m_stats.errors;
+            return;
+          }
+          client.subscribe(
+              (uint32_t) page->getTotal(),
+              [this](message::MessageView push) { receivePush(push); }
+          );
+        }
+    );
+  }
+
+  void receivePush(message::MessageView push) {
+    auto page = message::SendCommentsMessage::fromView(push);
+    if (!page.has_value()) {
+      ++m_stats.errors;
+      return;
+    }
+
+    const uint64_t now = now_ns();
+    for (size_t i = 0; i < page->getCount(); ++i) {
+      auto comment = (*page)[i];
+      if (comment.size() < StampSize) {
+        continue;
+      }
+      uint64_t sent = strtoull(
+          std::string(comment.data(), StampSize).c_str(), NULL, 16
+      );
+      if (sent != 0 && sent <= now) {
+        m_stats.pushes.record(now - sent);
+      }
+    }
+  }
+
+  /**
+   * @brief Put current time into comments, if someone measures delivery
+   */
+  void stampComments(void) {
+    if (m_options.subscribers == 0 || m_comment.size() < StampSize) {
+      return;
+    }
+
+    char stamp[StampSize + 1] = "";
+    snprintf(stamp, sizeof(stamp), "%016llx", (unsigned long long) now_ns());
+    m_comment.replace(0, StampSize, stamp, StampSize);
+    for (std::string& comment : m_batch) {
+      comment.replace(0, StampSize, stamp, StampSize);
+    }
+  }
+
+  void issue(Client& client) {
+    const bool is_write = nextRandom() % 100 < m_options.write_percent;
+    const auto start = Clock::now();
+
+    auto on_response =
+      [this, &client, is_write, start](auto response) {
+        complete(client, is_write, start, response);
+      };
+
+    if (!is_write) {
+      uint32_t first = m_known_total > m_options.page_size
+        ? m_known_total - m_options.page_size
+        : 0;
+      auto encoding = m_options.indexed
+        ? Message::ResponseEncoding::Indexed
+        : Message::ResponseEncoding::Plain;
+      client.request(
+          Message::getComments(first, m_options.page_size, 0, encoding),
+          on_response
+      );
+    } else if (m_options.batch_size == 0) {
+      stampComments();
+      client.request(Message::newComment(m_comment), on_response);
+    } else {
+      stampComments();
+      client.request(Message::newCommentsBatch(m_batch), on_response);
+    }
+  }
+
+  void complete(
+      Client& client,
+      bool is_write,
+      Clock::time_point start,
+      std::optional<message::MessageView> response
+  ) {
+    if (!response.has_value()) {
+      ++m_stats.errors;
+      return;
+    }
+
+    const uint64_t latency = (uint64_t)
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - start
+      ).count();
+
+    if (is_write) {
+      m_stats.writes.record(latency);
+    } else {
+      auto comments = message::SendCommentsMessage::fromView(*response);
+      if (!comments.has_value()) {
+        ++m_stats.errors;
+      } else {
+        m_known_total = (uint32_t) comments->getTotal();
+      }
+      m_stats.reads.record(latency);
+    }
+
+    if (m_issuing) {
+      issue(client);
+    }
+  }
+
+  const Options& m_options;
+  uint64_t m_random;
+  std::string m_comment;
+  std::vector<std::string> m_batch;
+  bool m_issuing = false;
+  uint32_t m_known_total = 0;
+
+  // Clients fail their requests on destruction, so they go first
+  ThreadStats m_stats{};
+  ClientLoop m_loop{};
+  std::vector<std::unique_ptr<Client>> m_clients{};
+  std::vector<std::unique_ptr<Client>> m_subscribers{};
+};
+
+static bool wait_for_server(uint16_t port) {
+  auto probe = connect_with_retry(port);
+  if (probe == nullptr) {
+    return false;
+  }
+
+  probe->post(Message::goodbye());
+  probe->flush();
+  return true;
+}
+
+/**
+ * @brief Ask server for its metrics
+ *
+ * @return Metrics text, empty if server did not answer
+ */
+static std::string get_server_stats(uint16_t port) {
+  auto client = Client::connect(s_loopback, port);
+  if (client == nullptr) {
+    return "";
+  }
+
+  std::string text;
+  client->request(Message::getStats(),
+      [&text](std::optional<message::MessageView> response) {
+        if (!response.has_value()) {
+          return;
+        }
+        if (auto stats = message::StatsMessage::fromView(*response)) {
+          text = stats->getText();
+        }
+      }
+  );
+
+  ClientLoop loop;
+  loop.add(*client);
+  while (client->inFlight() > 0 && !client->isClosed()) {
+    loop.runOnce(1000);
+  }
+  loop.remove(*client);
+
+  client->post(Message::goodbye());
+  client->flush();
+  return text;
+}
+
+static void print_latency(const char* name, const LatencyHistogram& hist) {
+  constexpr double NsPerUs = 1000;
+  printf("%-6s %10lu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+      name,
+      (unsigned long) hist.count(),
+      hist.mean() / NsPerUs,
+      (double) hist.percentile(50) / NsPerUs,
+      (double) hist.percentile(99) / NsPerUs,
+      (double) hist.percentile(99.9) / NsPerUs,
+      (double) hist.max() / NsPerUs
+  );
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+  int opt = 0;
+  while ((opt = getopt(argc, argv, "p:c:t:d:w:q:s:b:n:iu:S:m")) != -1) {
+    switch (opt) {
+    case 'p': options.port = (uint16_t) strtoul(optarg, NULL, 10); break;
+    case 'c': options.connections = strtoul(optarg, NULL, 10); break;
+    case 't': options.threads = strtoul(optarg, NULL, 10); break;
+    case 'd': options.seconds = strtod(optarg, NULL); break;
+    case 'w': options.write_percent = (unsigned) strtoul(optarg, NULL, 10); break;
+    case 'q': options.depth = strtoul(optarg, NULL, 10); break;
+    case 's': options.comment_size = strtoul(optarg, NULL, 10); break;
+    case 'b': options.batch_size = strtoul(optarg, NULL, 10); break;
+    case 'n': options.page_size = (uint32_t) strtoul(optarg, NULL, 10); break;
+    case 'i': options.indexed = true; break;
+    case 'u': options.subscribers = strtoul(optarg, NULL, 10); break;
+    case 'S': options.server_reactors = strtoul(optarg, NULL, 10); break;
+    case 'm': options.server_stats = true; break;
+    default:
+      return false;
+    }
+  }
+
+  return options.connections > 0 && options.threads > 0 && options.depth > 0
+         && options.write_percent <= 100;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    fprintf(stderr,
+        "Usage: %s [-p port] [-c connections] [-t threads] [-d seconds]\n"
+        "       [-w write_percent] [-q depth] [-s comment_size]\n"
+        "       [-b batch_size] [-n page_size] [-i] [-u subscribers]\n"
+        "       [-S server_reactors] [-m]\n",
+        argv[0]
+    );
+    return 1;
+  }
+  if (options.threads > options.connections) {
+    options.threads = options.connections;
+  }
+
+  pid_t server = -1;
+  if (options.server_reactors > 0) {
+    server = start_server(
+        options.port,
+        server::ServerConfig{ .reactor_count = options.server_reactors }
+    );
+  }
+  if (!wait_for_server(options.port)) {
+    fprintf(stderr, "Server is not reachable on port %hu\n", options.port);
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (size_t i = 0; i < options.threads; ++i) {
+    // Spread connections evenly, first threads take the remainder
+    size_t connections = options.connections / options.threads
+      + (i < options.connections % options.threads ? 1 : 0);
+    size_t subscribers = options.subscribers / options.threads
+      + (i < options.subscribers % options.threads ? 1 : 0);
+
+    workers.push_back(std::make_unique<Worker>(options, i));
+    if (!workers.back()->connect(connections, subscribers)) {
+      fprintf(stderr, "Failed to connect to server\n");
+      return 1;
+    }
+  }
+
+  std::atomic<bool> running = true;
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (auto& worker : workers) {
+    threads.emplace_back([&worker, &running] { worker->run(running); });
+  }
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+  running = false;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double elapsed =
+    std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::string server_stats;
+  if (options.server_stats) {
+    server_stats = get_server_stats(options.port);
+  }
+
+  if (server > 0) {
+    stop_server(server);
+  }
+
+  ThreadStats total;
+  for (const auto& worker : workers) {
+    total.writes.merge(worker->getStats().writes);
+    total.reads.merge(worker->getStats().reads);
+    total.pushes.merge(worker->getStats().pushes);
+    total.errors += worker->getStats().errors;
+  }
+  LatencyHistogram all;
+  all.merge(total.writes);
+  all.merge(total.reads);
+
+  const size_t comments_per_write =
+    options.batch_size == 0 ? 1 : options.batch_size;
+
+  printf("connections %zu, threads %zu, depth %zu, writes %u%%, "
+         "comment %zu B, batch %zu\n",
+      options.connections, options.threads, options.depth,
+      options.write_percent, options.comment_size, options.batch_size
+  );
+  printf("%.2f s, %lu requests, %.0f requests/s, %.0f comments/s written, "
+         "%zu errors\n\n",
+      elapsed,
+      (unsigned long) all.count(),
+      (double) all.count() / elapsed,
+      (double) (total.writes.count() * comments_per_write) / elapsed,
+      total.errors
+  );
+
+  printf("%-6s %10s %9s %9s %9s %9s %9s\n",
+      "us", "count", "mean", "p50", "p99", "p999", "max");
+  print_latency("write", total.writes);
+  print_latency("read", total.reads);
+  print_latency("all", all);
+  if (options.subscribers > 0) {
+    print_latency("push", total.pushes);
+  }
+
+  if (options.server_stats) {
+    if (server_stats.empty()) {
+      fprintf(stderr, "Server did not report metrics\n");
+    }
+    printf("\n%s", server_stats.c_str());
+  }
+
+  return total.errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file MetricsBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Cost of server metrics instrumentation
+ *
+ * Usage: MetricsBench [threads]
+ *
+ * Reports time per operation of every recording call used on hot paths,
+ * and of clock reads which `SampledTimer` saves. Then compares sharded
+ * counter to a single atomic counter shared by up to `threads` threads,
+ * and measures rendering of collected metrics. Build with
+ * `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Message/Message.hpp"
+#include "Metrics/Metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using metrics::Counter;
+using metrics::Distribution;
+using metrics::Metrics;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Make compiler assume value is used
+ */
+template <typename T>
+static inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Run `op` repeatedly for about `MinTime`, several times, and report
+ * the fastest repetition
+ */
+template <typename Op>
+static void run(const char* name, Op&& op) {
+  constexpr auto MinTime = std::chrono::milliseconds(100);
+  constexpr size_t Repetitions = 5;
+
+  // Find iteration count which takes long enough to time reliably
+  size_t iterations = 1;
+  for (;;) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      op(i);
+    }
+    if (Clock::now() - start >= MinTime / 10) {
+      break;
+    }
+    iterations *= 2;
+  }
+  iterations *= 10;
+
+  double best = 1e300;
+  for (size_t rep = 0; rep < Repetitions; ++rep) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      op(i);
+    }
+    double elapsed =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    best = std::min(best, elapsed / (double) iterations);
+  }
+
+  printf("%-36s %10.2f\n", name, best);
+}
+
+/**
+ * @brief Time `iterations` calls of `op` on each of `threads` threads
+ *
+ * @return Nanoseconds per call of one thread
+ */
+template <typename Op>
+static double run_threads(size_t threads, size_t iterations, Op&& op) {
+  std::atomic<bool> go = false;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&go, &op, iterations] {
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (size_t i = 0; i < iterations; ++i) {
+        op();
+      }
+    });
+  }
+
+  auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double elapsed =
+    std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+  return elapsed / (double) iterations;
+}
+
+int main(int argc, char** argv) {
+  size_t max_threads = std::thread::hardware_concurrency();
+  if (argc > 1) {
+    max_threads = strtoul(argv[1], NULL, 10);
+  }
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+
+  printf("%-36s %10s\n", "single thread", "ns/op");
+
+  std::atomic<uint64_t> shared = 0;
+  run("atomic fetch_add (reference)", [&shared](size_t) {
+    shared.fetch_add(1, std::memory_order_relaxed);
+  });
+  run("Metrics::add", [](size_t) {
+    Metrics::add(Counter::ResponseBytes, 64);
+  });
+  run("Metrics::countFrame", [](size_t) {
+    Metrics::countFrame(message::Message::Type::NewComment);
+  });
+  run("Metrics::record", [](size_t i) {
+    Metrics::record(Distribution::OutputQueueBytes, i % 65536);
+  });
+  run("steady_clock::now x2", [](size_t) {
+    auto start = Clock::now();
+    keep(Clock::now() - start);
+  });
+  run("SampledTimer", [](size_t) {
+    metrics::SampledTimer timer(Distribution::AppendLatency);
+  });
+  run("append instrumentation", [](size_t) {
+    {
+      metrics::SampledTimer timer(Distribution::AppendLatency);
+    }
+    Metrics::add(Counter::StoredComments);
+  });
+
+  constexpr size_t Iterations = 10'000'000;
+  printf("\n%-8s %14s %14s\n", "threads", "shared ns/op", "sharded ns/op");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    double shared_ns = run_threads(threads, Iterations, [&shared] {
+      shared.fetch_add(1, std::memory_order_relaxed);
+    });
+    double sharded_ns = run_threads(threads, Iterations, [] {
+      Metrics::add(Counter::ResponseBytes);
+    });
+    printf("%-8zu %14.2f %14.2f\n", threads, shared_ns, sharded_ns);
+  }
+
+  const metrics::Gauge gauges[] = {
+    { "comments", "Comments in store", 1e6 },
+  };
+  printf("\n");
+  run("Metrics::format", [&gauges](size_t) {
+    std::string text = Metrics::format(gauges);
+    keep(text.data());
+  });
+
+  printf("\n%s", Metrics::format(gauges).c_str());
+  return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file ReactorScaling.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Measure server throughput as number of reactor threads grows
+ *
+ * Usage: ReactorScaling [max_reactors] [clients] [seconds] [port]
+ *
+ * For every reactor count from 1 to `max_reactors` server is started in a
+ * child process, `clients` threads run request-response loops against it
+ * over loopback and total requests per second are reported.
+ *
+ * @version 0.0.1
+ * @date 2024-11-06
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Message/Message.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using message::Message;
+
+static constexpr size_t WritesPerRead = 8;
+static constexpr uint32_t ReadWindow = 16;
+
+static int connect_to(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  assert(fd >= 0);
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (connect(fd, (const struct sockaddr*) &address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  int enable = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  return fd;
+}
+
+static bool send_message(int fd, const Message& message) {
+  auto bytes = message.getBytes();
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    ssize_t res = send(fd, bytes.data() + sent, bytes.size() - sent, 0);
+    if (res <= 0) {
+      return false;
+    }
+    sent += (size_t) res;
+  }
+  return true;
+}
+
+static std::optional<Message> recv_message(int fd, std::vector<std::byte>& buffer) {
+  size_t size = Message::MinSize;
+  size_t offset = 0;
+  buffer.resize(size);
+
+  for (;;) {
+    while (offset < size) {
+      ssize_t res = recv(fd, buffer.data() + offset, size - offset, 0);
+      if (res <= 0) {
+        return std::nullopt;
+      }
+      offset += (size_t) res;
+    }
+
+    size_t msg_size = 0;
+    auto msg = Message::fromBytes(std::span(buffer.data(), offset), msg_size);
+    if (msg.has_value() || msg_size <= offset) {
+      return msg;
+    }
+
+    size = msg_size;
+    buffer.resize(size);
+  }
+}
+
+static void run_client(
+    uint16_t port,
+    const std::atomic<bool>& running,
+    std::atomic<size_t>& requests
+) {
+  int fd = connect_to(port);
+  assert(fd >= 0);
+
+  std::vector<std::byte> buffer;
+  size_t done = 0;
+  uint32_t known_total = 0;
+
+  while (running.load(std::memory_order_relaxed)) {
+    bool is_read = (done % (WritesPerRead + 1)) == WritesPerRead;
+    uint32_t start = known_total > ReadWindow ? known_total - ReadWindow : 0;
+
+    bool ok = is_read
+      ? send_message(fd, Message::getComments(start))
+      : send_message(fd, Message::newComment("benchmark comment"));
+    if (!ok || !recv_message(fd, buffer).has_value()) {
+      break;
+    }
+
+    known_total += is_read ? 0 : 1;
+    ++done;
+  }
+
+  send_message(fd, Message::goodbye());
+  close(fd);
+  requests.fetch_add(done);
+}
+
+static double measure(size_t reactors, size_t clients, double seconds, uint16_t port) {
+  pid_t server = bench::start_server(
+      port, server::ServerConfig{ .reactor_count = reactors }
+  );
+  assert(server >= 0);
+
+  // Wait until server accepts connections
+  for (;;) {
+    int probe = connect_to(port);
+    if (probe >= 0) {
+      send_message(probe, Message::goodbye());
+      close(probe);
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::atomic<bool> running = true;
+  std::atomic<size_t> requests = 0;
+  std::vector<std::thread> threads;
+  threads.reserve(clients);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < clients; ++i) {
+    threads.emplace_back(run_client, port, std::cref(running), std::ref(requests));
+  }
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  running = false;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start
+  ).count();
+
+  bench::stop_server(server);
+
+  return (double) requests.load() / elapsed;
+}
+
+int main(int argc, char** argv) {
+  size_t max_reactors = std::thread::hardware_concurrency();
+  size_t clients = 64;
+  double seconds = 2;
+  uint16_t port = 9100;
+
+  if (argc > 1) max_reactors = strtoul(argv[1], NULL, 10);
+  if (argc > 2) clients = strtoul(argv[2], NULL, 10);
+  if (argc > 3) seconds = strtod(argv[3], NULL);
+  if (argc > 4) port = (uint16_t) strtoul(argv[4], NULL, 10);
+
+  if (max_reactors == 0) {
+    max_reactors = 1;
+  }
+
+  printf("%10s %14s %10s\n", "reactors", "requests/s", "speedup");
+
+  double baseline = 0;
+  for (size_t reactors = 1; reactors <= max_reactors; ++reactors) {
+    double rps = measure(reactors, clients, seconds, port);
+    if (reactors == 1) {
+      baseline = rps;
+    }
+    printf("%10zu %14.0f %9.2fx\n", reactors, rps, rps / baseline);
+    fflush(stdout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,337 @@
+/**
+ * @file ReplicationBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Read throughput of leader with growing number of followers
+ *
+ * Usage: ReplicationBench [port]
+ *
+ * Starts leader server in a child process, fills it with comments and adds
+ * single-reactor followers one by one, each in its own child process. For
+ * every number of followers, connections are spread evenly over all
+ * servers and keep one GetComments of random page in flight each, and
+ * total throughput is reported with latency percentiles. Replication delay
+ * is time from leader acknowledging a comment to the last follower pushing
+ * it to its subscriber. Every server takes a core at most, so throughput
+ * only grows while there are idle cores. Build with
+ * `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-23
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Client/Client.hpp"
+#include "Client/ClientLoop.hpp"
+#include "Client/LatencyHistogram.hpp"
+#include "Message/Message.hpp"
+#include "Message/SendCommentsMessage.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using message::Message;
+using client::Client;
+using client::ClientLoop;
+using client::LatencyHistogram;
+using Clock = std::chrono::steady_clock;
+using bench::connect_with_retry;
+using bench::start_server;
+using bench::stop_server;
+
+static constexpr size_t CommentCount = 16384;
+static constexpr size_t CommentSize = 128;
+static constexpr size_t BatchSize = 1024;
+static constexpr uint32_t PageSize = 32;
+static constexpr size_t MaxFollowers = 3;
+static constexpr size_t ConnectionsPerServer = 32;
+static constexpr size_t Requests = 60000;
+static constexpr size_t Warmup = 6000;
+static constexpr size_t DelaySamples = 200;
+
+/**
+ * @brief Send request and wait for its response, passed to `on_response`
+ *
+ * @return Response was received
+ */
+static bool round_trip(
+    Client& client,
+    const Message& request,
+    std::function<void(message::MessageView)> on_response = nullptr
+) {
+  bool done = false;
+  bool received = false;
+  client.request(request,
+      [&](std::optional<message::MessageView> response) {
+        done = true;
+        received = response.has_value();
+        if (received && on_response) {
+          on_response(*response);
+        }
+      }
+  );
+
+  ClientLoop loop;
+  loop.add(client);
+  while (!done && !client.isClosed()) {
+    loop.runOnce(1000);
+  }
+  loop.remove(client);
+  return received;
+}
+
+/**
+ * @brief Wait until server at `port` stores `count` comments
+ *
+ * @return Server caught up in time
+ */
+static bool wait_for_comments(uint16_t port, size_t count) {
+  auto client = connect_with_retry(port);
+  if (client == nullptr) {
+    return false;
+  }
+
+  auto deadline = Clock::now() + std::chrono::seconds(30);
+  while (Clock::now() < deadline) {
+    size_t total = 0;
+    bool received = round_trip(*client, Message::getComments(0, 1),
+        [&total](message::MessageView response) {
+          auto page = message::SendCommentsMessage::fromView(response);
+          if (page.has_value()) {
+            total = page->getTotal();
+          }
+        }
+    );
+    if (!received) {
+      return false;
+    }
+    if (total >= count) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+/**
+ * @brief Keep one request for random page in flight on every connection
+ * until `Requests` responses are recorded after warmup
+ *
+ * @return No request failed
+ */
+static bool bench_reads(
+    size_t followers,
+    std::vector<std::unique_ptr<Client>>& clients
+) {
+  ClientLoop loop;
+  for (auto& client : clients) {
+    loop.add(*client);
+  }
+
+  std::mt19937 random(followers);
+  std::uniform_int_distribution<uint32_t> pick(0, CommentCount - PageSize);
+
+  LatencyHistogram latency;
+  size_t completed = 0;
+  size_t errors = 0;
+  Clock::time_point time_before{};
+
+  // Every response immediately issues next request on its connection
+  std::function<void(Client&)> issue = [&](Client& client) {
+    const auto start = Clock::now();
+    client.request(Message::getComments(pick(random), PageSize),
+        [&, start](std::optional<message::MessageView> response) {
+          if (!response.has_value()) {
+            ++errors;
+            return;
+          }
+
+          if (++completed == Warmup) {
+            time_before = Clock::now();
+          } else if (completed > Warmup) {
+            latency.record((uint64_t) std::chrono::duration_cast<
+                std::chrono::nanoseconds>(Clock::now() - start).count());
+          }
+          if (completed < Warmup + Requests) {
+            issue(client);
+          }
+        }
+    );
+  };
+
+  for (auto& client : clients) {
+    issue(*client);
+  }
+
+  while (completed < Warmup + Requests && errors == 0) {
+    loop.runOnce(1000);
+  }
+  const double seconds =
+    std::chrono::duration<double>(Clock::now() - time_before).count();
+
+  // Wait for requests which were still in flight
+  bool in_flight = true;
+  while (in_flight && errors == 0) {
+    in_flight = false;
+    for (auto& client : clients) {
+      in_flight = in_flight || client->inFlight() > 0;
+    }
+    if (in_flight) {
+      loop.runOnce(1000);
+    }
+  }
+  for (auto& client : clients) {
+    loop.remove(*client);
+  }
+
+  if (errors > 0) {
+    fprintf(stderr, "%zu requests failed\n", errors);
+    return false;
+  }
+
+  constexpr double NsPerUs = 1e3;
+  printf("%9zu %7zu %10.0f %9.1f %9.1f ",
+      followers, clients.size(),
+      (double) latency.count() / seconds,
+      (double) latency.percentile(50) / NsPerUs,
+      (double) latency.percentile(99) / NsPerUs
+  );
+  return true;
+}
+
+/**
+ * @brief Median time from leader acknowledging comment to follower at
+ * `follower_port` pushing it, in microseconds
+ */
+static double replication_delay_us(
+    uint16_t leader_port,
+    uint16_t follower_port,
+    size_t stored
+) {
+  auto writer = connect_with_retry(leader_port);
+  auto subscriber = connect_with_retry(follower_port);
+  if (writer == nullptr || subscriber == nullptr) {
+    return -1;
+  }
+
+  size_t pushed = 0;
+  subscriber->subscribe((uint32_t) stored,
+      [&pushed](message::MessageView view) {
+        auto push = message::SendCommentsMessage::fromView(view);
+        if (push.has_value()) {
+          pushed += push->getCount();
+        }
+      }
+  );
+
+  ClientLoop loop;
+  loop.add(*subscriber);
+
+  const std::string comment(CommentSize, 'd');
+  LatencyHistogram delay;
+  for (size_t i = 0; i < DelaySamples; ++i) {
+    if (!round_trip(*writer, Message::newComment(comment))) {
+      return -1;
+    }
+
+    const auto start = Clock::now();
+    while (pushed < i + 1 && !subscriber->isClosed()) {
+      loop.runOnce(1000);
+    }
+    delay.record((uint64_t) std::chrono::duration_cast<
+        std::chrono::nanoseconds>(Clock::now() - start).count());
+  }
+  loop.remove(*subscriber);
+
+  return (double) delay.percentile(50) / 1e3;
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 9110;
+  if (argc > 1) {
+    port = (uint16_t) strtoul(argv[1], NULL, 10);
+  }
+
+  std::vector<pid_t> servers;
+  servers.push_back(start_server(port, {}));
+
+  bool success = true;
+
+  auto writer = connect_with_retry(port);
+  success = writer != nullptr;
+
+  std::vector<std::string> batch(BatchSize, std::string(CommentSize, 'c'));
+  for (size_t i = 0; success && i < CommentCount / BatchSize; ++i) {
+    success = round_trip(*writer, Message::newCommentsBatch(batch));
+  }
+  size_t stored = CommentCount;
+
+  printf("Servers share %u CPU(s), %zu connections per server, "
+         "pages of %u comments\n",
+         std::thread::hardware_concurrency(), ConnectionsPerServer, PageSize);
+  printf("%9s %7s %10s %9s %9s %12s\n",
+      "followers", "conns", "req/s", "p50 us", "p99 us", "repl p50 us");
+
+  std::vector<std::unique_ptr<Client>> clients;
+  for (size_t followers = 0; success && followers <= MaxFollowers;
+       ++followers) {
+    const uint16_t server_port = (uint16_t) (port + followers);
+    if (followers > 0) {
+      server::ServerConfig config;
+      config.reactor_count = 1;
+      config.leader_address[0] = 127;
+      config.leader_address[3] = 1;
+      config.leader_port = port;
+      servers.push_back(start_server(server_port, config));
+
+      success = wait_for_comments(server_port, stored);
+      if (!success) {
+        fprintf(stderr, "Follower on port %hu did not catch up\n",
+            server_port);
+        break;
+      }
+    }
+
+    for (size_t i = 0; success && i < ConnectionsPerServer; ++i) {
+      auto client = connect_with_retry(server_port);
+      success = client != nullptr;
+      clients.push_back(std::move(client));
+    }
+
+    success = success && bench_reads(followers, clients);
+    if (!success) {
+      break;
+    }
+
+    if (followers > 0) {
+      printf("%12.1f\n", replication_delay_us(port, server_port, stored));
+      stored += DelaySamples;
+    } else {
+      printf("%12s\n", "-");
+    }
+    fflush(stdout);
+  }
+
+  for (auto& client : clients) {
+    if (client != nullptr) {
+      client->post(Message::goodbye());
+      client->flush();
+    }
+  }
+
+  for (pid_t server : servers) {
+    stop_server(server);
+  }
+  return success ? 0 : 1;
+}
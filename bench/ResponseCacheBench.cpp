@@ -0,0 +1,259 @@
+/**
+ * @file ResponseCacheBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Server cost of repeated GetComments with and without response
+ * cache
+ *
+ * Usage: ResponseCacheBench [port]
+ *
+ * Starts one single-reactor server with response cache and one without it
+ * in child processes. All connections poll the same few pages, keeping one
+ * request in flight each, and server CPU time per request is reported
+ * together with throughput and latency. In mixed rows one of connections
+ * stores a comment once `WriteInterval` responses passed since its
+ * previous one, so that cached pages go stale. Build with
+ * `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-22
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Client/Client.hpp"
+#include "Client/ClientLoop.hpp"
+#include "Client/LatencyHistogram.hpp"
+#include "Message/Message.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using message::Message;
+using client::Client;
+using client::ClientLoop;
+using client::LatencyHistogram;
+using Clock = std::chrono::steady_clock;
+using bench::connect_with_retry;
+using bench::start_server;
+using bench::stop_server;
+
+static constexpr size_t CommentCount = 4096;
+static constexpr size_t CommentSize = 128;
+static constexpr size_t ConnectionCount = 64;
+static constexpr size_t Requests = 40000;
+static constexpr size_t Warmup = 4000;
+static constexpr size_t WriteInterval = 100;
+static constexpr uint32_t PageStarts[] = { 0, 1024, 2048, 3072 };
+static constexpr uint32_t PageSizes[] = { 16, 256 };
+
+/**
+ * @brief CPU time of server reactor, which is its main thread
+ */
+static uint64_t server_cpu_ns(pid_t server) {
+  std::string path = "/proc/" + std::to_string(server) + "/schedstat";
+  unsigned long long cpu_ns = 0;
+  if (FILE* file = fopen(path.c_str(), "r")) {
+    if (fscanf(file, "%llu", &cpu_ns) != 1) {
+      cpu_ns = 0;
+    }
+    fclose(file);
+  }
+  return cpu_ns;
+}
+
+/**
+ * @brief Wait for all requests of clients to complete
+ */
+static void drain(
+    ClientLoop& loop,
+    std::vector<std::unique_ptr<Client>>& clients
+) {
+  bool in_flight = true;
+  while (in_flight) {
+    in_flight = false;
+    for (auto& client : clients) {
+      in_flight = in_flight
+        || (client->inFlight() > 0 && !client->isClosed());
+    }
+    if (in_flight) {
+      loop.runOnce(1000);
+    }
+  }
+}
+
+/**
+ * @brief Poll pages of `page_size` comments on all connections until
+ * `Requests` responses are recorded after warmup
+ *
+ * @return No request failed
+ */
+static bool bench_polling(
+    const char* name,
+    pid_t server,
+    std::vector<std::unique_ptr<Client>>& clients,
+    uint32_t page_size,
+    bool writes
+) {
+  ClientLoop loop;
+  for (auto& client : clients) {
+    loop.add(*client);
+  }
+
+  std::vector<Message> requests;
+  for (uint32_t start : PageStarts) {
+    requests.push_back(Message::getComments(start, page_size));
+  }
+  const Message write = Message::newComment(std::string(CommentSize, 'w'));
+
+  LatencyHistogram latency;
+  size_t completed = 0;
+  size_t errors = 0;
+  size_t next_write = WriteInterval;
+  uint64_t cpu_before = 0;
+  Clock::time_point time_before{};
+
+  // Every response immediately issues next request on its connection
+  std::function<void(Client&, size_t)> issue = [&](Client& client,
+                                                   size_t page) {
+    const bool store = writes && &client == clients[0].get()
+      && completed >= next_write;
+    if (store) {
+      next_write = completed + WriteInterval;
+    }
+    const Message& request = store ? write : requests[page];
+    const auto start = Clock::now();
+    client.request(request,
+        [&, start, page](std::optional<message::MessageView> response) {
+          if (!response.has_value()) {
+            ++errors;
+            return;
+          }
+
+          if (++completed == Warmup) {
+            cpu_before = server_cpu_ns(server);
+            time_before = Clock::now();
+          } else if (completed > Warmup) {
+            latency.record((uint64_t) std::chrono::duration_cast<
+                std::chrono::nanoseconds>(Clock::now() - start).count());
+          }
+          if (completed < Warmup + Requests) {
+            issue(client, (page + 1) % std::size(PageStarts));
+          }
+        }
+    );
+  };
+
+  for (size_t i = 0; i < clients.size(); ++i) {
+    issue(*clients[i], i % std::size(PageStarts));
+  }
+
+  while (completed < Warmup + Requests && errors == 0) {
+    loop.runOnce(1000);
+  }
+  const uint64_t cpu_after = server_cpu_ns(server);
+  const double seconds =
+    std::chrono::duration<double>(Clock::now() - time_before).count();
+
+  // Wait for requests which were still in flight
+  drain(loop, clients);
+  for (auto& client : clients) {
+    loop.remove(*client);
+  }
+
+  if (errors > 0) {
+    fprintf(stderr, "%s: %zu requests failed\n", name, errors);
+    return false;
+  }
+
+  constexpr double NsPerUs = 1e3;
+  const double requests_done = (double) latency.count();
+  printf("%-9s %6s %5u %10.0f %9.1f %9.1f %12.2f\n",
+      name,
+      writes ? "mixed" : "reads",
+      page_size,
+      requests_done / seconds,
+      (double) latency.percentile(50) / NsPerUs,
+      (double) latency.percentile(99) / NsPerUs,
+      (double) (cpu_after - cpu_before) / NsPerUs / requests_done
+  );
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 9106;
+  if (argc > 1) {
+    port = (uint16_t) strtoul(argv[1], NULL, 10);
+  }
+
+  struct Variant {
+    const char* name;
+    size_t response_cache_bytes;
+    uint16_t port;
+    pid_t server;
+  };
+  Variant variants[] = {
+    { "no cache", 0, port, -1 },
+    { "cache", 64 * 1024 * 1024, (uint16_t) (port + 1), -1 },
+  };
+
+  for (Variant& variant : variants) {
+    server::ServerConfig config;
+    config.response_cache_bytes = variant.response_cache_bytes;
+    variant.server = start_server(variant.port, config);
+  }
+
+  bool success = true;
+
+  printf("Polling %zu pages over %zu connections, %zu requests\n",
+      std::size(PageStarts), ConnectionCount, Requests);
+  printf("%-9s %6s %5s %10s %9s %9s %12s\n",
+      "", "load", "page", "req/s", "p50 us", "p99 us", "cpu us/req");
+
+  for (const Variant& variant : variants) {
+    std::vector<std::unique_ptr<Client>> clients;
+    while (success && clients.size() < ConnectionCount) {
+      auto client = connect_with_retry(variant.port);
+      success = client != nullptr;
+      clients.push_back(std::move(client));
+    }
+    if (!success) {
+      fprintf(stderr, "Server is not reachable on port %hu\n", variant.port);
+      break;
+    }
+
+    std::vector<std::string> comments(CommentCount,
+                                      std::string(CommentSize, 'c'));
+    clients[0]->request(Message::newCommentsBatch(comments), nullptr);
+    ClientLoop loop;
+    loop.add(*clients[0]);
+    drain(loop, clients);
+    loop.remove(*clients[0]);
+
+    for (uint32_t page_size : PageSizes) {
+      for (bool writes : { false, true }) {
+        success = success && bench_polling(
+            variant.name, variant.server, clients, page_size, writes
+        );
+      }
+    }
+
+    for (auto& client : clients) {
+      client->post(Message::goodbye());
+      client->flush();
+    }
+  }
+
+  for (const Variant& variant : variants) {
+    stop_server(variant.server);
+  }
+  return success ? 0 : 1;
+}
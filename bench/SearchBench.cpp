@@ -0,0 +1,135 @@
+/**
+ * @file SearchBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Search index cost at growing store sizes
+ *
+ * Usage: SearchBench
+ *
+ * Fills stores with comments of words drawn from a skewed vocabulary, where
+ * one marker word occurs in a fixed number of comments regardless of store
+ * size. Reports indexing time and posting list size per comment, and time
+ * of queries returning a page of results: marker word, single common word,
+ * two common words, and a page deep into results. Time of marker query
+ * stays flat as store grows. Build with `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Storage/CommentStore.hpp"
+#include "Storage/SearchIndex.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t StoreSizes[] = { 10'000, 100'000, 1'000'000 };
+static constexpr size_t VocabularySize = 20'000;
+static constexpr size_t WordsPerComment = 12;
+static constexpr size_t MarkerCount = 16;
+static constexpr size_t PageSize = 100;
+
+/**
+ * @brief Random word, so that different indices give different words
+ */
+static std::string make_word(size_t index) {
+  std::string word;
+  do {
+    word.push_back((char) ('a' + index % 26));
+    index /= 26;
+  } while (index > 0);
+  return "w" + word;
+}
+
+/**
+ * @brief Mean time of `op` over enough repetitions, in microseconds
+ */
+template <typename Op>
+static double time_us(Op&& op) {
+  constexpr auto MinTime = std::chrono::milliseconds(50);
+
+  size_t iterations = 0;
+  auto start = Clock::now();
+  do {
+    op();
+    ++iterations;
+  } while (Clock::now() - start < MinTime);
+
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+    .count() / (double) iterations;
+}
+
+int main(void) {
+  std::vector<std::string> vocabulary;
+  for (size_t i = 0; i < VocabularySize; ++i) {
+    vocabulary.push_back(make_word(i));
+  }
+
+  // Zipf-like: k-th word is about 1/k as frequent as the first one
+  std::vector<double> weights;
+  for (size_t i = 0; i < VocabularySize; ++i) {
+    weights.push_back(1.0 / (double) (i + 1));
+  }
+
+  printf("%9s %10s %10s %9s %9s %9s %9s\n",
+      "comments", "index ns", "posting B", "marker", "common", "and", "deep");
+  printf("%9s %10s %10s %9s %9s %9s %9s\n",
+      "", "/comment", "/comment", "us", "us", "us", "us");
+
+  for (size_t store_size : StoreSizes) {
+    std::mt19937_64 random(store_size);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+    storage::CommentStore store;
+    std::string comment;
+    for (size_t i = 0; i < store_size; ++i) {
+      comment.clear();
+      for (size_t w = 0; w < WordsPerComment; ++w) {
+        comment += vocabulary[pick(random)];
+        comment.push_back(' ');
+      }
+      if (i % (store_size / MarkerCount) == 0) {
+        comment += "Marker";
+      }
+      store.append(comment);
+    }
+
+    storage::SearchIndex index;
+    auto start = Clock::now();
+    index.update(store.snapshot());
+    const double index_ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    std::vector<uint32_t> results;
+    const double marker_us = time_us([&] {
+      index.search("marker", 0, PageSize, results);
+    });
+    const double common_us = time_us([&] {
+      index.search(vocabulary[0], 0, PageSize, results);
+    });
+    const double and_us = time_us([&] {
+      index.search(vocabulary[1] + " " + vocabulary[2], 0, PageSize, results);
+    });
+    const double deep_us = time_us([&] {
+      index.search(vocabulary[0], store_size - store_size / 10, PageSize,
+                   results);
+    });
+
+    printf("%9zu %10.1f %10.2f %9.2f %9.2f %9.2f %9.2f\n",
+        store_size,
+        index_ns / (double) store_size,
+        (double) index.getPostingBytes() / (double) store_size,
+        marker_us, common_us, and_us, deep_us
+    );
+  }
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file TieredStoreBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Memory and access cost of comment store with cold segments
+ *
+ * Usage: TieredStoreBench [cold_directory] [store_mib] [hot_mib]
+ *
+ * Fills a store with about `store_mib` MiB of comments, once in anonymous
+ * memory and once with cold segments in `cold_directory` and `hot_mib` MiB
+ * of hot budget. Reports append time, process RSS after filling, and time
+ * of reading comments from the oldest and the newest tenth of the store at
+ * random, followed by RSS after reads. Build with
+ * `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Storage/CommentStore.hpp"
+#include "Storage/TieredArena.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t CommentSize = 200;
+static constexpr size_t ReadCount = 200'000;
+
+/**
+ * @brief Make compiler assume value is used
+ */
+template <typename T>
+static inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Resident memory of process in MiB
+ */
+static double rss_mib(void) {
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == NULL) {
+    return 0;
+  }
+
+  size_t size = 0;
+  size_t resident = 0;
+  int read = fscanf(statm, "%zu %zu", &size, &resident);
+  fclose(statm);
+  if (read != 2) {
+    return 0;
+  }
+
+  return (double) (resident * (size_t) sysconf(_SC_PAGESIZE))
+    / (1024 * 1024);
+}
+
+/**
+ * @brief Mean time of reading random comments from [`begin`, `end`), in
+ * nanoseconds
+ */
+static double time_reads(
+    const storage::CommentStore::Snapshot& snapshot,
+    size_t begin,
+    size_t end
+) {
+  std::mt19937_64 random(begin);
+  std::uniform_int_distribution<size_t> pick(begin, end - 1);
+
+  uint64_t checksum = 0;
+  auto start = Clock::now();
+  for (size_t i = 0; i < ReadCount; ++i) {
+    std::string_view comment = snapshot[pick(random)];
+    checksum += (uint8_t) comment[comment.size() / 2];
+  }
+  keep(checksum);
+
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+    .count() / (double) ReadCount;
+}
+
+static void run(const char* name, storage::TieredArenaOptions options,
+                size_t store_mib) {
+  const size_t count = store_mib * 1024 * 1024 / CommentSize;
+
+  storage::CommentStore store(nullptr, options);
+  std::string comment(CommentSize, 'c');
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    comment[i % CommentSize] = (char) ('a' + i % 26);
+    store.append(comment);
+  }
+  const double append_ns =
+    std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+    / (double) count;
+  const double filled_rss = rss_mib();
+
+  auto snapshot = store.snapshot();
+  const double old_ns = time_reads(snapshot, 0, count / 10);
+  const double new_ns = time_reads(snapshot, count - count / 10, count);
+
+  printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+      name, append_ns, filled_rss,
+      (double) store.getHotBytes() / (1024 * 1024),
+      (double) store.getColdBytes() / (1024 * 1024),
+      old_ns, new_ns, rss_mib()
+  );
+}
+
+int main(int argc, char** argv) {
+  const char* cold_directory = argc > 1 ? argv[1] : "/tmp/tiered-store-bench";
+  const size_t store_mib = argc > 2 ? strtoul(argv[2], NULL, 10) : 1024;
+  const size_t hot_mib = argc > 3 ? strtoul(argv[3], NULL, 10) : 64;
+
+  printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+      "store", "append", "RSS", "hot", "cold", "old read", "new read",
+      "RSS");
+  printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+      "", "ns", "MiB", "MiB", "MiB", "ns", "ns", "MiB");
+
+  run("anonymous", {}, store_mib);
+
+  storage::TieredArenaOptions options;
+  options.cold_directory = cold_directory;
+  options.hot_bytes = hot_mib * 1024 * 1024;
+  run("tiered", options, store_mib);
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file TimeQueryBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Cost of finding first comment stored since given time
+ *
+ * Usage: TimeQueryBench
+ *
+ * Fills stores of growing size and reports time of `Snapshot::findTime()`
+ * for random times, compared to binary search over all comment records,
+ * which reads a record at every step. Both searches are checked to agree.
+ * Build with `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-20
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Storage/CommentStore.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t StoreSizes[] = { 10'000, 100'000, 1'000'000 };
+static constexpr size_t CommentSize = 64;
+static constexpr size_t QueryCount = 100'000;
+
+/**
+ * @brief Reference search, reading records of the whole store
+ */
+static size_t find_time_records(
+    const storage::CommentStore::Snapshot& snapshot,
+    uint64_t timestamp
+) {
+  size_t low = 0;
+  size_t high = snapshot.size();
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if (snapshot.record(middle).timestamp < timestamp) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/**
+ * @brief Mean time of `find` over all queries, in nanoseconds
+ */
+template <typename Find>
+static double time_queries(
+    const std::vector<uint64_t>& queries,
+    std::vector<size_t>& results,
+    Find&& find
+) {
+  results.clear();
+  auto start = Clock::now();
+  for (uint64_t query : queries) {
+    results.push_back(find(query));
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+    .count() / (double) queries.size();
+}
+
+int main(void) {
+  printf("%9s %12s %12s %10s\n", "comments", "sparse ns", "records ns",
+      "distinct");
+
+  for (size_t store_size : StoreSizes) {
+    storage::CommentStore store;
+    std::string comment(CommentSize, 'c');
+    for (size_t i = 0; i < store_size; ++i) {
+      comment[i % CommentSize] = (char) ('a' + i % 26);
+      store.append(comment);
+    }
+
+    auto snapshot = store.snapshot();
+    const uint64_t first = snapshot.record(0).timestamp;
+    const uint64_t last = snapshot.record(store_size - 1).timestamp;
+
+    size_t distinct = 1;
+    for (size_t i = 1; i < store_size; ++i) {
+      distinct += snapshot.record(i).timestamp != snapshot.record(i - 1).timestamp;
+    }
+
+    std::mt19937_64 random(store_size);
+    std::uniform_int_distribution<uint64_t> pick(first, last + 1);
+    std::vector<uint64_t> queries;
+    for (size_t i = 0; i < QueryCount; ++i) {
+      queries.push_back(pick(random));
+    }
+
+    std::vector<size_t> sparse_results;
+    std::vector<size_t> record_results;
+    const double sparse_ns = time_queries(queries, sparse_results,
+        [&snapshot](uint64_t query) { return snapshot.findTime(query); }
+    );
+    const double records_ns = time_queries(queries, record_results,
+        [&snapshot](uint64_t query) {
+          return find_time_records(snapshot, query);
+        }
+    );
+
+    if (sparse_results != record_results) {
+      fprintf(stderr, "Sparse time index disagrees with records\n");
+      return 1;
+    }
+
+    printf("%9zu %12.1f %12.1f %10zu\n",
+        store_size, sparse_ns, records_ns, distinct);
+  }
+
+  return 0;
+}
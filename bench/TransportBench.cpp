@@ -0,0 +1,238 @@
+/**
+ * @file TransportBench.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Latency of loopback TCP compared to shared memory transport
+ *
+ * Usage: TransportBench [port] [socket_path]
+ *
+ * Starts server in a child process, listening both on loopback TCP port
+ * and on Unix socket for shared memory clients. Then sends the same
+ * requests over both transports: one at a time, reporting round trip
+ * latency percentiles, and pipelined, reporting throughput. Client blocks
+ * in `poll()` while waiting, as a real client would. Build with
+ * `make bench BUILDTYPE=Release`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-16
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "BenchServer.hpp"
+#include "Client/Client.hpp"
+#include "Client/LatencyHistogram.hpp"
+#include "Message/Message.hpp"
+#include "Server/TcpServer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+using message::Message;
+using client::Client;
+using client::LatencyHistogram;
+using Clock = std::chrono::steady_clock;
+using bench::connect_with_retry;
+using bench::start_server;
+using bench::stop_server;
+
+static constexpr size_t CommentCount = 1024;
+static constexpr size_t CommentSize = 64;
+static constexpr size_t Requests = 20000;
+static constexpr size_t Warmup = 1000;
+static constexpr size_t PipelineDepth = 32;
+
+/**
+ * @brief Write queued requests and read responses, blocking until some
+ * progress is possible
+ */
+static void exchange(Client& client) {
+  client.flush();
+  if (client.poll() > 0 || client.isClosed()) {
+    return;
+  }
+
+  // Epoll event bits match poll() ones
+  short events = POLLIN;
+  if (client.wantsWrite()) {
+    events |= (short) client.getWriteEvents();
+  }
+  struct pollfd socket = {
+    .fd = client.getSocket(),
+    .events = events,
+    .revents = 0
+  };
+  ::poll(&socket, 1, 100);
+}
+
+static bool drain(Client& client) {
+  while (client.inFlight() > 0 && !client.isClosed()) {
+    exchange(client);
+  }
+  return !client.isClosed();
+}
+
+struct Workload {
+  const char* name;
+  Message request;
+};
+
+/**
+ * @brief Send requests one at a time and record round trip latencies
+ *
+ * @return No request failed
+ */
+static bool bench_latency(
+    const char* transport,
+    Client& client,
+    const Workload& workload
+) {
+  LatencyHistogram latency;
+  size_t errors = 0;
+
+  for (size_t i = 0; i < Warmup + Requests && !client.isClosed(); ++i) {
+    const auto start = Clock::now();
+    client.request(workload.request,
+        [&errors](std::optional<message::MessageView> response) {
+          errors += !response.has_value();
+        }
+    );
+    if (!drain(client)) {
+      break;
+    }
+
+    if (i >= Warmup) {
+      latency.record((uint64_t) std::chrono::duration_cast<
+          std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+  }
+  if (client.isClosed() || errors > 0) {
+    fprintf(stderr, "%s: %zu requests failed\n", transport, errors);
+    return false;
+  }
+
+  constexpr double NsPerUs = 1e3;
+  printf("%-6s %-28s %9.1f %9.1f %9.1f %9.1f\n",
+      transport,
+      workload.name,
+      (double) latency.percentile(50) / NsPerUs,
+      (double) latency.percentile(99) / NsPerUs,
+      (double) latency.percentile(99.9) / NsPerUs,
+      latency.mean() / NsPerUs
+  );
+  return true;
+}
+
+/**
+ * @brief Keep `PipelineDepth` requests in flight and report throughput
+ *
+ * @return No request failed
+ */
+static bool bench_throughput(
+    const char* transport,
+    Client& client,
+    const Workload& workload
+) {
+  size_t errors = 0;
+  auto on_response = [&errors](std::optional<message::MessageView> response) {
+    errors += !response.has_value();
+  };
+
+  const auto start = Clock::now();
+  size_t issued = 0;
+  while (issued < Requests && !client.isClosed()) {
+    while (client.inFlight() < PipelineDepth && issued < Requests) {
+      client.request(workload.request, on_response);
+      ++issued;
+    }
+    exchange(client);
+  }
+  if (!drain(client) || errors > 0) {
+    fprintf(stderr, "%s: %zu requests failed\n", transport, errors);
+    return false;
+  }
+
+  const double elapsed =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-6s %-28s %12.0f\n", transport, workload.name, Requests / elapsed);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 9102;
+  std::string shm_path = "/tmp/client-server-bench.sock";
+  if (argc > 1) {
+    port = (uint16_t) strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    shm_path = argv[2];
+  }
+
+  server::ServerConfig config;
+  config.shm_path = shm_path.c_str();
+  pid_t server = start_server(port, config);
+
+  auto tcp = connect_with_retry(port);
+  auto shm = connect_with_retry([&shm_path] {
+    return Client::connectShm(shm_path.c_str());
+  });
+  if (tcp == nullptr || shm == nullptr) {
+    fprintf(stderr, "Server is not reachable on port %hu and %s\n",
+        port, shm_path.c_str());
+    stop_server(server);
+    return 1;
+  }
+
+  std::vector<std::string> comments(CommentCount, std::string(CommentSize, 'c'));
+  tcp->request(Message::newCommentsBatch(comments), nullptr);
+  bool success = drain(*tcp);
+
+  const std::string comment(CommentSize, 'n');
+  const Workload workloads[] = {
+    { "NewComment/64B", Message::newComment(comment) },
+    { "GetComments/16x64B", Message::getComments(0, 16) },
+    { "GetComments/256x64B", Message::getComments(0, 256) },
+  };
+
+  struct Transport {
+    const char* name;
+    Client& client;
+  };
+  const Transport transports[] = {
+    { "tcp", *tcp },
+    { "shm", *shm },
+  };
+
+  printf("Round trip latency, one request at a time, %zu requests\n",
+      Requests);
+  printf("%-6s %-28s %9s %9s %9s %9s\n",
+      "", "request", "p50 us", "p99 us", "p99.9 us", "mean us");
+  for (const Workload& workload : workloads) {
+    for (const Transport& transport : transports) {
+      success = success
+        && bench_latency(transport.name, transport.client, workload);
+    }
+  }
+
+  printf("\nThroughput, %zu requests in flight\n", PipelineDepth);
+  printf("%-6s %-28s %12s\n", "", "request", "requests/s");
+  for (const Workload& workload : workloads) {
+    for (const Transport& transport : transports) {
+      success = success
+        && bench_throughput(transport.name, transport.client, workload);
+    }
+  }
+
+  for (const Transport& transport : transports) {
+    transport.client.post(Message::goodbye());
+    transport.client.flush();
+  }
+
+  stop_server(server);
+  return success ? 0 : 1;
+}
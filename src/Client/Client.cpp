@@ -0,0 +1,274 @@
+#include "Client.hpp"
+#include "Message/Compression.hpp"
+#include "Message/HelloMessage.hpp"
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+#include "Transport/ShmTransport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace client {
+
+std::unique_ptr<Client> Client::connect(
+    uint8_t ip_address[4],
+    uint16_t port,
+    uint32_t capabilities
+) {
+  constexpr size_t IpAddrMaxLength = 12 + 3;  // 12 digits and 3 dots
+  char addr_buffer[IpAddrMaxLength + 1] = "";
+
+  snprintf(addr_buffer, IpAddrMaxLength + 1,
+      "%hhu.%hhu.%hhu.%hhu",
+      ip_address[0], ip_address[1], ip_address[2], ip_address[3]
+  );
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  if (inet_aton(addr_buffer, &address.sin_addr) != 1) {
+    return nullptr;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  // Connect while blocking, so that failure is reported right away
+  if (::connect(fd, (const struct sockaddr*) &address, sizeof(address)) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  int enable = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  return create(std::make_unique<transport::SocketTransport>(fd), capabilities);
+}
+
+std::unique_ptr<Client> Client::connectShm(
+    const char* path,
+    uint32_t capabilities
+) {
+  auto shm = transport::ShmTransport::connect(path);
+  if (shm == nullptr) {
+    return nullptr;
+  }
+
+  return create(std::move(shm), capabilities);
+}
+
+std::unique_ptr<Client> Client::create(
+    std::unique_ptr<transport::Transport> transport,
+    uint32_t capabilities
+) {
+  auto client = std::unique_ptr<Client>(new Client(std::move(transport)));
+  if (capabilities != 0) {
+    // Requests queued before the answer are simply sent uncompressed
+    Client* self = client.get();
+    client->request(message::Message::hello(capabilities),
+        [self](std::optional<message::MessageView> response) {
+          if (!response.has_value()) {
+            return;
+          }
+          auto hello = message::HelloMessage::fromView(*response);
+          if (hello.has_value()) {
+            self->m_capabilities = hello->getCapabilities();
+          }
+        }
+    );
+  }
+
+  return client;
+}
+
+Client::Client(std::unique_ptr<transport::Transport> transport)
+  : m_transport(std::move(transport)),
+    m_read_buffer(InitialReadBufferSize) {
+}
+
+Client::~Client() {
+  fail();
+}
+
+void Client::request(const message::Message& request, Callback on_response) {
+  queueFrame(request.getBytes());
+  m_callbacks.push_back(std::move(on_response));
+}
+
+void Client::post(const message::Message& message) {
+  queueFrame(message.getBytes());
+}
+
+void Client::subscribe(uint32_t start_index, PushCallback on_push) {
+  m_on_push = std::move(on_push);
+  queueFrame(message::Message::subscribe(start_index).getBytes());
+}
+
+void Client::replicate(uint32_t start_index, PushCallback on_push) {
+  m_on_push = std::move(on_push);
+  queueFrame(message::Message::replicate(start_index).getBytes());
+}
+
+void Client::queueFrame(std::span<const std::byte> frame) {
+  if ((m_capabilities & message::Message::CapabilityCompression) &&
+      message::Compression::compressFrame(frame, m_compressed)) {
+    frame = m_compressed;
+  }
+
+  m_output.append(frame);
+  m_bytes_sent += frame.size();
+}
+
+void Client::flush(void) {
+  using FlushResult = server::OutputQueue::FlushResult;
+
+  m_wants_write = false;
+  if (m_closed) {
+    return;
+  }
+
+  switch (m_output.flush(*m_transport, 0)) {
+  case FlushResult::Drained:
+    break;
+  case FlushResult::WouldBlock:
+    m_wants_write = true;
+    break;
+  case FlushResult::Gated:
+  case FlushResult::Error:
+  default:
+    fail();
+    break;
+  }
+
+  // Responses announced while writing would get no readiness notification
+  m_input_pending = m_input_pending || m_transport->takeInputPending();
+}
+
+size_t Client::poll(void) {
+  size_t completed = 0;
+  m_input_pending = false;
+
+  while (!m_closed) {
+    auto available = std::span(m_read_buffer).subspan(
+        m_read_begin, m_read_end - m_read_begin
+    );
+
+    size_t msg_size = 0;
+    auto msg = message::MessageView::fromBytes(available, msg_size);
+    if (msg.has_value()) {
+      m_read_begin += msg_size;
+
+      if (msg->isCompressed()) {
+        msg = message::Compression::decompressFrame(*msg, m_inflated);
+        if (!msg.has_value()) {
+          fail();
+          break;
+        }
+      }
+
+      if (
+        msg->getType() == message::Message::Type::CommentsPush ||
+        msg->getType() == message::Message::Type::ReplicatedComments
+      ) {
+        if (m_on_push) {
+          m_on_push(*msg);
+        }
+        continue;
+      }
+
+      // Response without request means client and server lost sync
+      if (m_callbacks.empty()) {
+        fail();
+        break;
+      }
+
+      Callback on_response = std::move(m_callbacks.front());
+      m_callbacks.pop_front();
+      if (on_response) {
+        on_response(msg);
+      }
+      ++completed;
+      continue;
+    }
+
+    // Header is complete, but not valid
+    if (available.size() >= message::Message::MinSize && msg_size == 0) {
+      fail();
+      break;
+    }
+
+    if (!readMore(std::max(msg_size, message::Message::MinSize))) {
+      break;
+    }
+  }
+
+  return completed;
+}
+
+bool Client::readMore(size_t message_size) {
+  // Move incomplete message to buffer start if it cannot grow in place
+  if (m_read_begin == m_read_end) {
+    m_read_begin = m_read_end = 0;
+  } else if (m_read_begin + message_size > m_read_buffer.size()) {
+    std::copy(
+        m_read_buffer.begin() + m_read_begin,
+        m_read_buffer.begin() + m_read_end,
+        m_read_buffer.begin()
+    );
+    m_read_end -= m_read_begin;
+    m_read_begin = 0;
+  }
+
+  if (m_read_buffer.size() < message_size) {
+    m_read_buffer.resize(std::max(message_size, 2 * m_read_buffer.size()));
+  }
+
+  const size_t space = m_read_buffer.size() - m_read_end;
+
+  ssize_t res = 0;
+  do {
+    errno = 0;
+    res = m_transport->read(
+        std::span(m_read_buffer).subspan(m_read_end, space)
+    );
+  } while (res < 0 && errno == EINTR);
+
+  if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return false;
+  }
+  if (res <= 0) {
+    fail();
+    return false;
+  }
+
+  m_read_end += (size_t) res;
+  m_bytes_received += (size_t) res;
+  return true;
+}
+
+void Client::fail(void) {
+  m_closed = true;
+  m_wants_write = false;
+
+  std::deque<Callback> callbacks;
+  callbacks.swap(m_callbacks);
+  for (Callback& on_response : callbacks) {
+    if (on_response) {
+      on_response(std::nullopt);
+    }
+  }
+}
+
+} // namespace client
@@ -0,0 +1,223 @@
+/**
+ * @file Client.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Non-blocking pipelining client connection
+ *
+ * Requests are queued together with a completion callback and written in
+ * batches. Server answers requests of one connection in order, so every
+ * received response completes the oldest outstanding request. Comments
+ * pushed to subscriber are not responses and go to separate callback.
+ *
+ * @version 0.0.1
+ * @date 2024-11-11
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __CLIENT_CLIENT_HPP
+#define __CLIENT_CLIENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+#include "Server/OutputQueue.hpp"
+#include "Transport/Transport.hpp"
+
+namespace client {
+
+class Client final {
+public:
+  /**
+   * @brief Called with response to request. View is valid only during call.
+   * Called with `std::nullopt` if connection was closed before response
+   */
+  using Callback = std::function<void(std::optional<message::MessageView>)>;
+
+  /**
+   * @brief Called with every CommentsPush or ReplicatedComments. View is
+   * valid only during call
+   */
+  using PushCallback = std::function<void(message::MessageView)>;
+
+  /**
+   * @brief Connect to server
+   *
+   * @param[in] ip_address    Server address
+   * @param[in] port          Server port
+   * @param[in] capabilities  Set of `Message::Capability` flags to offer in
+   *                          Hello. No Hello is sent if zero
+   *
+   * @return Connected client, or `nullptr` if connection failed
+   */
+  static std::unique_ptr<Client> connect(
+      uint8_t ip_address[4],
+      uint16_t port,
+      uint32_t capabilities = 0
+  );
+
+  /**
+   * @brief Connect to server on the same host through shared memory
+   *
+   * @param[in] path          Unix socket of server, see `ServerConfig`
+   * @param[in] capabilities  See `connect()`
+   *
+   * @return Connected client, or `nullptr` if connection failed
+   */
+  static std::unique_ptr<Client> connectShm(
+      const char* path,
+      uint32_t capabilities = 0
+  );
+
+  // Non-Copyable
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  // Non-Movable
+  Client(Client&&) = delete;
+  Client& operator=(Client&&) = delete;
+
+  /**
+   * @brief Fail outstanding requests and close connection
+   */
+  ~Client();
+
+  /**
+   * @brief Descriptor to wait on for responses
+   */
+  int getSocket(void) const noexcept { return m_transport->getFd(); }
+
+  /**
+   * @brief Events of `getSocket()` to wait for while `wantsWrite()`
+   */
+  uint32_t getWriteEvents(void) const noexcept {
+    return m_transport->getWriteEvents();
+  }
+
+  /**
+   * @brief Queue request. Request is written by next `flush()`
+   *
+   * @param[in] request       Request message
+   * @param[in] on_response   Completion callback, may be empty
+   */
+  void request(const message::Message& request, Callback on_response);
+
+  /**
+   * @brief Queue message which server does not answer, e.g. Goodbye
+   */
+  void post(const message::Message& message);
+
+  /**
+   * @brief Subscribe to comments from `start_index` on, see
+   * `Message::subscribe()`. Replaces previous push callback
+   */
+  void subscribe(uint32_t start_index, PushCallback on_push);
+
+  /**
+   * @brief Stream comments from `start_index` on as a follower, see
+   * `Message::replicate()`. Replaces previous push callback
+   */
+  void replicate(uint32_t start_index, PushCallback on_push);
+
+  /**
+   * @brief Write as much of queued requests as transport accepts
+   */
+  void flush(void);
+
+  /**
+   * @brief Read available responses and pushes, completing requests
+   *
+   * @return Number of completed requests
+   */
+  size_t poll(void);
+
+  /**
+   * @brief Number of requests waiting for response
+   */
+  size_t inFlight(void) const noexcept { return m_callbacks.size(); }
+
+  bool wantsWrite(void) const noexcept { return m_wants_write; }
+
+  /**
+   * @brief `flush()` consumed notification of input, so `poll()` must be
+   * called without waiting for readiness of `getSocket()`
+   */
+  bool hasPendingInput(void) const noexcept { return m_input_pending; }
+
+  bool isClosed(void) const noexcept { return m_closed; }
+
+  /**
+   * @brief Capabilities server agreed to, zero until Hello is answered
+   */
+  uint32_t getCapabilities(void) const noexcept { return m_capabilities; }
+
+  /**
+   * @brief Total bytes queued for sending, as they appear on the wire
+   */
+  size_t getBytesSent(void) const noexcept { return m_bytes_sent; }
+
+  /**
+   * @brief Total bytes received, as they appear on the wire
+   */
+  size_t getBytesReceived(void) const noexcept { return m_bytes_received; }
+
+private:
+  static constexpr size_t InitialReadBufferSize = 64 * 1024;
+
+  explicit Client(std::unique_ptr<transport::Transport> transport);
+
+  /**
+   * @brief Wrap connected transport and offer capabilities in Hello
+   */
+  static std::unique_ptr<Client> create(
+      std::unique_ptr<transport::Transport> transport,
+      uint32_t capabilities
+  );
+
+  /**
+   * @brief Read as much as fits into buffer, making room for at least
+   * `message_size` bytes of current message
+   *
+   * @return Some bytes were read
+   */
+  bool readMore(size_t message_size);
+
+  /**
+   * @brief Queue serialized message, compressing it if agreed on
+   */
+  void queueFrame(std::span<const std::byte> frame);
+
+  void fail(void);
+
+  std::unique_ptr<transport::Transport> m_transport;
+
+  std::vector<std::byte> m_read_buffer;
+  size_t m_read_begin = 0;
+  size_t m_read_end = 0;
+
+  // Last received compressed message, restored
+  std::vector<std::byte> m_inflated{};
+  std::vector<std::byte> m_compressed{};
+  uint32_t m_capabilities = 0;
+
+  size_t m_bytes_sent = 0;
+  size_t m_bytes_received = 0;
+
+  server::OutputQueue m_output{};
+  std::deque<Callback> m_callbacks{};
+  PushCallback m_on_push{};
+  bool m_wants_write = false;
+  bool m_input_pending = false;
+  bool m_closed = false;
+};
+
+} // namespace client
+
+#endif /* Client.hpp */
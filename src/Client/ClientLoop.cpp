@@ -0,0 +1,115 @@
+#include "ClientLoop.hpp"
+
+#include <cassert>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace client {
+
+ClientLoop::ClientLoop()
+  : m_epoll(epoll_create1(EPOLL_CLOEXEC)) {
+  assert(m_epoll >= 0);
+}
+
+ClientLoop::~ClientLoop() {
+  close(m_epoll);
+}
+
+void ClientLoop::add(Client& client) {
+  const int fd = client.getSocket();
+
+  struct epoll_event event = {};
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.fd = fd;
+  int res = epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event);
+  assert(res == 0);
+
+  m_clients.emplace(fd, Entry{ .client = &client, .events = event.events });
+}
+
+void ClientLoop::remove(Client& client) {
+  const int fd = client.getSocket();
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, NULL);
+  m_clients.erase(fd);
+}
+
+size_t ClientLoop::runOnce(int timeout_ms) {
+  size_t completed = 0;
+  bool polled = false;
+
+  // Requests queued since last turn go out before waiting. Reading may
+  // consume notification of free space in turn, so next turn does not wait
+  for (auto& [fd, entry] : m_clients) {
+    entry.client->flush();
+    if (entry.client->hasPendingInput()) {
+      completed += entry.client->poll();
+      polled = true;
+    }
+    updateEvents(entry);
+  }
+
+  struct epoll_event events[MaxEvents];
+  errno = 0;
+  int count = epoll_wait(
+      m_epoll, events, MaxEvents, polled ? 0 : timeout_ms
+  );
+  if (count == -1 && errno == EINTR) {
+    return completed;
+  }
+  assert(count >= 0);
+
+  for (int i = 0; i < count; ++i) {
+    auto it = m_clients.find(events[i].data.fd);
+    if (it == m_clients.end()) {
+      continue;
+    }
+
+    Client& client = *it->second.client;
+    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+      completed += client.poll();
+    }
+    if (client.wantsWrite() && (events[i].events & client.getWriteEvents())) {
+      client.flush();
+    }
+    if (client.hasPendingInput()) {
+      completed += client.poll();
+    }
+    updateEvents(it->second);
+  }
+
+  return completed;
+}
+
+void ClientLoop::updateEvents(Entry& entry) {
+  const int fd = entry.client->getSocket();
+
+  // Closed socket would report EPOLLHUP forever, so stop watching it
+  if (entry.client->isClosed()) {
+    if (entry.events != 0) {
+      epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, NULL);
+      entry.events = 0;
+    }
+    return;
+  }
+
+  uint32_t events = EPOLLIN | EPOLLRDHUP;
+  if (entry.client->wantsWrite()) {
+    events |= entry.client->getWriteEvents();
+  }
+
+  if (events == entry.events) {
+    return;
+  }
+
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+
+  int res = epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &event);
+  assert(res == 0);
+  entry.events = events;
+}
+
+} // namespace client
@@ -0,0 +1,69 @@
+/**
+ * @file ClientLoop.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Event loop driving many client connections from one thread
+ *
+ * @version 0.0.1
+ * @date 2024-11-11
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __CLIENT_CLIENT_LOOP_HPP
+#define __CLIENT_CLIENT_LOOP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "Client/Client.hpp"
+
+namespace client {
+
+class ClientLoop final {
+public:
+  ClientLoop();
+
+  // Non-Copyable
+  ClientLoop(const ClientLoop&) = delete;
+  ClientLoop& operator=(const ClientLoop&) = delete;
+
+  // Non-Movable
+  ClientLoop(ClientLoop&&) = delete;
+  ClientLoop& operator=(ClientLoop&&) = delete;
+
+  ~ClientLoop();
+
+  /**
+   * @brief Start watching client, which must outlive the loop or be removed
+   */
+  void add(Client& client);
+
+  void remove(Client& client);
+
+  /**
+   * @brief Flush queued requests, wait for events and dispatch responses
+   *
+   * @param[in] timeout_ms  Maximum wait time, -1 to wait indefinitely
+   *
+   * @return Number of completed requests
+   */
+  size_t runOnce(int timeout_ms);
+
+private:
+  static constexpr int MaxEvents = 256;
+
+  struct Entry {
+    Client* client;
+    uint32_t events;
+  };
+
+  void updateEvents(Entry& entry);
+
+  int m_epoll;
+  std::unordered_map<int, Entry> m_clients{};
+};
+
+} // namespace client
+
+#endif /* ClientLoop.hpp */
@@ -0,0 +1,39 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace client {
+
+void LatencyHistogram::merge(const LatencyHistogram& other) noexcept {
+  for (size_t i = 0; i < BucketCount; ++i) {
+    m_buckets[i] += other.m_buckets[i];
+  }
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const noexcept {
+  if (m_count == 0) {
+    return 0;
+  }
+
+  percent = std::clamp(percent, 0.0, 100.0);
+  uint64_t rank = (uint64_t) std::ceil(percent / 100 * (double) m_count);
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BucketCount; ++i) {
+    seen += m_buckets[i];
+    if (seen >= rank) {
+      // Upper bound of bucket, but never above actually recorded maximum
+      uint64_t upper = i + 1 < BucketCount ? lowerBound(i + 1) - 1 : m_max;
+      return std::min(upper, m_max);
+    }
+  }
+
+  return m_max;
+}
+
+} // namespace client
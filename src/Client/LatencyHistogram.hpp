@@ -0,0 +1,92 @@
+/**
+ * @file LatencyHistogram.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Fixed-size log-linear histogram of latencies
+ *
+ * Every power-of-two range is split into `SubBuckets` equal buckets, so
+ * reported percentiles are within ~3% of recorded values for any magnitude,
+ * while recording is a couple of bit operations and an increment.
+ *
+ * @version 0.0.1
+ * @date 2024-11-11
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __CLIENT_LATENCY_HISTOGRAM_HPP
+#define __CLIENT_LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace client {
+
+class LatencyHistogram final {
+public:
+  LatencyHistogram() = default;
+
+  void record(uint64_t value) noexcept {
+    ++m_buckets[bucketOf(value)];
+    ++m_count;
+    m_sum += value;
+    if (value > m_max) {
+      m_max = value;
+    }
+  }
+
+  /**
+   * @brief Add all values recorded by other histogram
+   */
+  void merge(const LatencyHistogram& other) noexcept;
+
+  uint64_t count(void) const noexcept { return m_count; }
+
+  uint64_t max(void) const noexcept { return m_max; }
+
+  double mean(void) const noexcept {
+    return m_count == 0 ? 0 : (double) m_sum / (double) m_count;
+  }
+
+  /**
+   * @brief Smallest recorded value which is not less than `percent`% of
+   * recorded values, rounded up to bucket bound
+   *
+   * @param[in] percent   Percentile in range [0, 100]
+   */
+  uint64_t percentile(double percent) const noexcept;
+
+private:
+  static constexpr size_t SubBucketBits = 5;
+  static constexpr size_t SubBuckets = size_t(1) << SubBucketBits;
+  static constexpr size_t BucketCount = 64 * SubBuckets;
+
+  static size_t bucketOf(uint64_t value) noexcept {
+    if (value < SubBuckets) {
+      return value;
+    }
+
+    // Keep SubBucketBits + 1 leading bits of value
+    const size_t shift = std::bit_width(value) - SubBucketBits - 1;
+    return (shift + 1) * SubBuckets + ((value >> shift) - SubBuckets);
+  }
+
+  static uint64_t lowerBound(size_t bucket) noexcept {
+    if (bucket < SubBuckets) {
+      return bucket;
+    }
+
+    const size_t shift = bucket / SubBuckets - 1;
+    return (uint64_t) (bucket % SubBuckets + SubBuckets) << shift;
+  }
+
+  std::array<uint64_t, BucketCount> m_buckets{};
+  uint64_t m_count = 0;
+  uint64_t m_sum = 0;
+  uint64_t m_max = 0;
+};
+
+} // namespace client
+
+#endif /* LatencyHistogram.hpp */
@@ -1,7 +1,135 @@
-#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-int main()
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "Server/TcpServer.hpp"
+
+static void print_usage(const char* program) {
+  fprintf(stderr,
+      "Usage: %s [-a address] [-p port] [-r reactors] [-l log_directory]"
+      " [-s shm_socket] [-b epoll|io_uring] [-c cold_directory]"
+      " [-m hot_mib] [-k response_cache_mib] [-f leader_address:port]\n",
+      program
+  );
+}
+
+static bool parse_address(const char* text, uint8_t ip_address[4]) {
+  struct in_addr address = {};
+  if (inet_aton(text, &address) != 1) {
+    return false;
+  }
+
+  uint32_t host = ntohl(address.s_addr);
+  for (int i = 0; i < 4; ++i) {
+    ip_address[i] = (uint8_t) (host >> (24 - 8 * i));
+  }
+  return true;
+}
+
+static bool parse_leader(const char* text, server::ServerConfig& config) {
+  const char* colon = strchr(text, ':');
+  if (colon == NULL || (size_t) (colon - text) >= INET_ADDRSTRLEN) {
+    return false;
+  }
+
+  char address[INET_ADDRSTRLEN] = "";
+  memcpy(address, text, (size_t) (colon - text));
+  config.leader_port = (uint16_t) strtoul(colon + 1, NULL, 10);
+
+  return parse_address(address, config.leader_address)
+    && config.leader_port != 0;
+}
+
+int main(int argc, char** argv)
 {
-  std::cout << "Hello, client-server\n";
-  return 0;
+  uint8_t ip_address[4] = { 0, 0, 0, 0 };
+  uint16_t port = 9100;
+  server::ServerConfig config;
+
+  int opt = 0;
+  while ((opt = getopt(argc, argv, "a:p:r:l:s:b:c:m:k:f:")) != -1) {
+    switch (opt) {
+    case 'a':
+      if (!parse_address(optarg, ip_address)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'f':
+      if (!parse_leader(optarg, config)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'p':
+      port = (uint16_t) strtoul(optarg, NULL, 10);
+      break;
+    case 'r':
+      config.reactor_count = strtoul(optarg, NULL, 10);
+      break;
+    case 'l':
+      config.log_directory = optarg;
+      break;
+    case 's':
+      config.shm_path = optarg;
+      break;
+    case 'c':
+      config.arena_options.cold_directory = optarg;
+      break;
+    case 'm':
+      config.arena_options.hot_bytes =
+        strtoul(optarg, NULL, 10) * 1024 * 1024;
+      break;
+    case 'k':
+      config.response_cache_bytes = strtoul(optarg, NULL, 10) * 1024 * 1024;
+      break;
+    case 'b':
+      if (strcmp(optarg, "epoll") == 0) {
+        config.io_backend = server::IoBackend::Epoll;
+      } else if (strcmp(optarg, "io_uring") == 0) {
+        config.io_backend = server::IoBackend::IoUring;
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+      break;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (config.reactor_count == 0) {
+    config.reactor_count = 1;
+  }
+
+  config.io_backend = server::select_io_backend(config.io_backend);
+
+  printf("Listening on %hhu.%hhu.%hhu.%hhu:%hu with %zu reactor(s) using %s\n",
+      ip_address[0], ip_address[1], ip_address[2], ip_address[3],
+      port, config.reactor_count,
+      config.io_backend == server::IoBackend::IoUring ? "io_uring" : "epoll"
+  );
+  if (config.shm_path != nullptr) {
+    printf("Accepting shared memory clients on %s\n", config.shm_path);
+  }
+  if (config.arena_options.cold_directory != nullptr) {
+    printf("Keeping %zu MiB of comments resident, older ones in %s\n",
+        config.arena_options.hot_bytes / (1024 * 1024),
+        config.arena_options.cold_directory
+    );
+  }
+  if (config.leader_port != 0) {
+    printf("Following leader at %hhu.%hhu.%hhu.%hhu:%hu\n",
+        config.leader_address[0], config.leader_address[1],
+        config.leader_address[2], config.leader_address[3],
+        config.leader_port
+    );
+  }
+  fflush(stdout);
+
+  return server::listen_tcp(ip_address, port, config) ? 0 : 1;
 }
@@ -0,0 +1,133 @@
+#include "CommentSplitter.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+namespace message {
+
+void split_comments_scalar(std::span<const char> chars, CommentList& comments) {
+  const size_t size = chars.size();
+
+  size_t offset = 0;
+  size_t length = 0;
+
+  while (offset + length < size) {
+    if (chars[offset + length] == '\0') {
+      comments.push_back(chars.subspan(offset, length));
+      offset += length + 1;
+      length = 0;
+    } else {
+      ++length;
+    }
+  }
+}
+
+#ifdef __x86_64__
+
+/**
+ * @brief Emit comment for every set bit of `mask`, each bit marking NUL at
+ * `position + bit index`
+ */
+static inline void emit_comments(
+    const char* chars,
+    size_t position,
+    uint32_t mask,
+    size_t& start,
+    CommentList& comments
+) {
+  while (mask != 0) {
+    const size_t end = position + (size_t) std::countr_zero(mask);
+    comments.emplace_back(chars + start, end - start);
+    start = end + 1;
+    mask &= mask - 1;
+  }
+}
+
+/**
+ * @brief Emit comments terminated in `[position, size)` one byte at a time
+ */
+static inline void emit_tail(
+    const char* chars,
+    size_t position,
+    size_t size,
+    size_t& start,
+    CommentList& comments
+) {
+  for (; position < size; ++position) {
+    if (chars[position] == '\0') {
+      comments.emplace_back(chars + start, position - start);
+      start = position + 1;
+    }
+  }
+}
+
+void split_comments_sse2(std::span<const char> chars, CommentList& comments) {
+  constexpr size_t Width = sizeof(__m128i);
+
+  const char* data = chars.data();
+  const size_t size = chars.size();
+  const __m128i zero = _mm_setzero_si128();
+
+  size_t start = 0;
+  size_t position = 0;
+  for (; position + Width <= size; position += Width) {
+    __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+    uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+    emit_comments(data, position, mask, start, comments);
+  }
+
+  emit_tail(data, position, size, start, comments);
+}
+
+__attribute__((target("avx2")))
+void split_comments_avx2(std::span<const char> chars, CommentList& comments) {
+  constexpr size_t Width = sizeof(__m256i);
+
+  const char* data = chars.data();
+  const size_t size = chars.size();
+  const __m256i zero = _mm256_setzero_si256();
+
+  size_t start = 0;
+  size_t position = 0;
+  for (; position + Width <= size; position += Width) {
+    __m256i block =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+    uint32_t mask =
+      (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero));
+    emit_comments(data, position, mask, start, comments);
+  }
+
+  emit_tail(data, position, size, start, comments);
+}
+
+bool has_avx2(void) {
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+using SplitFunction = void (*)(std::span<const char>, CommentList&);
+
+static SplitFunction select_split_function(void) {
+#ifdef __x86_64__
+  if (has_avx2()) {
+    return split_comments_avx2;
+  }
+  return split_comments_sse2;
+#else
+  return split_comments_scalar;
+#endif
+}
+
+void split_comments(std::span<const char> chars, CommentList& comments) {
+  static const SplitFunction split = select_split_function();
+  split(chars, comments);
+}
+
+} // namespace message
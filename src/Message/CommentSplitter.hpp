@@ -0,0 +1,58 @@
+/**
+ * @file CommentSplitter.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Splitting of NUL-separated comment lists
+ *
+ * `split_comments()` picks the widest vector implementation supported by
+ * the CPU on first use. Every implementation produces exactly the same
+ * result as `split_comments_scalar()`, which serves as reference.
+ *
+ * @version 0.0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_COMMENT_SPLITTER_HPP
+#define __MESSAGE_COMMENT_SPLITTER_HPP
+
+#include <span>
+#include <vector>
+
+namespace message {
+
+using CommentList = std::vector<std::span<const char>>;
+
+/**
+ * @brief Append every NUL-terminated comment of `chars` to `comments`.
+ * Bytes after the last NUL are ignored
+ */
+void split_comments(std::span<const char> chars, CommentList& comments);
+
+/**
+ * @brief Byte-at-a-time reference implementation of `split_comments()`
+ */
+void split_comments_scalar(std::span<const char> chars, CommentList& comments);
+
+#ifdef __x86_64__
+
+/**
+ * @brief `split_comments()` comparing 16 bytes at a time
+ */
+void split_comments_sse2(std::span<const char> chars, CommentList& comments);
+
+/**
+ * @brief `split_comments()` comparing 32 bytes at a time. Requires AVX2
+ */
+void split_comments_avx2(std::span<const char> chars, CommentList& comments);
+
+/**
+ * @brief CPU supports `split_comments_avx2()`
+ */
+bool has_avx2(void);
+
+#endif
+
+} // namespace message
+
+#endif /* CommentSplitter.hpp */
@@ -0,0 +1,79 @@
+/**
+ * @file CommentsBatchOkMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Acknowledgement of stored comment batch
+ *
+ * @version 0.0.1
+ * @date 2024-11-10
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_COMMENTS_BATCH_OK_MESSAGE_HPP
+#define __MESSAGE_COMMENTS_BATCH_OK_MESSAGE_HPP
+
+#include <cstddef>
+#include <optional>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class CommentsBatchOkMessage final {
+public:
+  static std::optional<CommentsBatchOkMessage> fromMessage(Message&& message) {
+    if (message.getType() == Message::Type::CommentsBatchOk) {
+      return CommentsBatchOkMessage(std::move(message));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<CommentsBatchOkMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::CommentsBatchOk) {
+      return CommentsBatchOkMessage(view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  CommentsBatchOkMessage(const CommentsBatchOkMessage&) = delete;
+  CommentsBatchOkMessage& operator=(const CommentsBatchOkMessage&) = delete;
+
+  // Movable
+  CommentsBatchOkMessage(CommentsBatchOkMessage&&) noexcept = default;
+  CommentsBatchOkMessage& operator=(CommentsBatchOkMessage&&) noexcept
+    = default;
+
+  /**
+   * @brief Index assigned to the first comment of batch
+   */
+  size_t getFirstIndex(void) const {
+    return m_view.getUint32(offsetof(Payload, first_index));
+  }
+
+  size_t getCount(void) const {
+    return m_view.getUint32(offsetof(Payload, count));
+  }
+
+private:
+  using Payload = Message::CommentsBatchOkPayload;
+
+  explicit CommentsBatchOkMessage(Message&& message)
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit CommentsBatchOkMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+};
+
+} // namespace message
+
+#endif /* CommentsBatchOkMessage.hpp */
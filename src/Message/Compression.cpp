@@ -0,0 +1,370 @@
+#include "Compression.hpp"
+#include "Message/Message.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include <netinet/in.h>
+
+namespace message {
+
+static constexpr size_t MinMatch = 4;
+static constexpr size_t MaxOffset = 65535;
+static constexpr size_t HashBits = 14;
+
+// Matches never start this close to the end of input, so that match
+// extension does not need a bounds check per byte in the common case
+static constexpr size_t LastLiterals = 8;
+
+// Decoder copies in blocks of this size when there is room past the end
+// of the copied range, later sequences overwrite the excess
+static constexpr size_t WildCopy = 16;
+
+static constexpr uint8_t NibbleMax = 15;
+
+static inline uint32_t read32(const std::byte* bytes) {
+  uint32_t value = 0;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static inline uint64_t read64(const std::byte* bytes) {
+  uint64_t value = 0;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static inline size_t hash32(uint32_t value) {
+  // Fibonacci hashing of four bytes
+  return (value * 2654435761u) >> (32 - HashBits);
+}
+
+/**
+ * @brief Number of equal leading bytes in two words, which must differ
+ */
+static inline size_t common_bytes(uint64_t lhs, uint64_t rhs) {
+  const uint64_t diff = lhs ^ rhs;
+  if constexpr (std::endian::native == std::endian::little) {
+    return (size_t) std::countr_zero(diff) / 8;
+  } else {
+    return (size_t) std::countl_zero(diff) / 8;
+  }
+}
+
+/**
+ * @brief Length of common prefix of `[first, limit)` and `second`
+ */
+static inline size_t common_length(
+    const std::byte* first,
+    const std::byte* second,
+    const std::byte* limit
+) {
+  const std::byte* start = first;
+  while (first + sizeof(uint64_t) <= limit) {
+    const uint64_t lhs = read64(first);
+    const uint64_t rhs = read64(second);
+    if (lhs != rhs) {
+      return (size_t) (first - start) + common_bytes(lhs, rhs);
+    }
+    first += sizeof(uint64_t);
+    second += sizeof(uint64_t);
+  }
+  while (first < limit && *first == *second) {
+    ++first;
+    ++second;
+  }
+  return (size_t) (first - start);
+}
+
+static std::byte* write_length(size_t length, std::byte* output) {
+  while (length >= 255) {
+    *output++ = std::byte{255};
+    length -= 255;
+  }
+  *output++ = std::byte(length);
+  return output;
+}
+
+static std::byte* write_sequence(
+    std::span<const std::byte> literals,
+    size_t offset,
+    size_t match_length,
+    std::byte* output
+) {
+  const size_t literal_length = literals.size();
+  const size_t match_extra = match_length == 0 ? 0 : match_length - MinMatch;
+
+  uint8_t token =
+    (uint8_t) (std::min<size_t>(literal_length, NibbleMax) << 4)
+    | (uint8_t) std::min<size_t>(match_extra, NibbleMax);
+  *output++ = std::byte(token);
+
+  if (literal_length >= NibbleMax) {
+    output = write_length(literal_length - NibbleMax, output);
+  }
+  output = std::ranges::copy(literals, output).out;
+
+  // Last sequence carries literals only
+  if (match_length == 0) {
+    return output;
+  }
+
+  *output++ = std::byte(offset & 0xFF);
+  *output++ = std::byte(offset >> 8);
+  if (match_extra >= NibbleMax) {
+    output = write_length(match_extra - NibbleMax, output);
+  }
+  return output;
+}
+
+size_t lz_compress_bound(size_t size) {
+  // Token, extended literal length and literals of incompressible input
+  return size + size / 255 + 16;
+}
+
+void lz_compress(std::span<const std::byte> input, std::vector<std::byte>& output) {
+  // Table holds `base + position`. Entries below `base` are left from
+  // previous inputs, so table is cleared only when `base` wraps around
+  thread_local std::array<uint32_t, size_t(1) << HashBits> table = {};
+  thread_local uint32_t base = 1;
+
+  const std::byte* data = input.data();
+  const size_t size = input.size();
+
+  if (size >= UINT32_MAX - base) {
+    table.fill(0);
+    base = 1;
+  }
+
+  const size_t output_start = output.size();
+  output.resize(output_start + lz_compress_bound(size));
+  std::byte* out = output.data() + output_start;
+
+  size_t anchor = 0;
+  size_t position = 0;
+
+  while (size >= LastLiterals && position + LastLiterals <= size) {
+    const uint32_t sequence = read32(data + position);
+    const size_t hash = hash32(sequence);
+    const uint32_t entry = table[hash];
+    table[hash] = base + (uint32_t) position;
+
+    const size_t candidate = entry - base;
+    bool found =
+      entry >= base &&
+      candidate < position &&
+      position - candidate <= MaxOffset &&
+      read32(data + candidate) == sequence;
+
+    if (!found) {
+      // Skip faster through data which does not compress
+      position += 1 + ((position - anchor) >> 6);
+      continue;
+    }
+
+    const size_t length = MinMatch + common_length(
+        data + position + MinMatch,
+        data + candidate + MinMatch,
+        data + size - LastLiterals
+    );
+
+    out = write_sequence(
+        input.subspan(anchor, position - anchor),
+        position - candidate,
+        length,
+        out
+    );
+
+    position += length;
+    anchor = position;
+
+    // Make the end of match findable, repeated text often continues there
+    if (position + LastLiterals <= size) {
+      table[hash32(read32(data + position - 2))] =
+        base + (uint32_t) (position - 2);
+    }
+  }
+
+  out = write_sequence(input.subspan(anchor), 0, 0, out);
+  output.resize((size_t) (out - output.data()));
+
+  base += (uint32_t) size;
+}
+
+/**
+ * @brief Read extended length starting at `position`
+ *
+ * @return Length is complete within input
+ */
+static bool read_length(
+    std::span<const std::byte> input,
+    size_t& position,
+    size_t& length
+) {
+  for (;;) {
+    if (position >= input.size()) {
+      return false;
+    }
+    uint8_t byte = (uint8_t) input[position++];
+    length += byte;
+    if (byte != 255) {
+      return true;
+    }
+  }
+}
+
+/**
+ * @brief Copy `[source, source + length)` in blocks of `Block` bytes,
+ * writing up to `Block - 1` bytes past `target + length`
+ */
+template <size_t Block>
+static inline void wild_copy(
+    std::byte* target,
+    const std::byte* source,
+    size_t length
+) {
+  std::byte* const end = target + length;
+  do {
+    std::memcpy(target, source, Block);
+    target += Block;
+    source += Block;
+  } while (target < end);
+}
+
+bool lz_decompress(std::span<const std::byte> input, std::span<std::byte> output) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < input.size()) {
+    const uint8_t token = (uint8_t) input[in++];
+
+    size_t literal_length = token >> 4;
+    if (literal_length == NibbleMax && !read_length(input, in, literal_length)) {
+      return false;
+    }
+    if (literal_length > input.size() - in ||
+        literal_length > output.size() - out) {
+      return false;
+    }
+    if (literal_length + WildCopy <= input.size() - in &&
+        literal_length + WildCopy <= output.size() - out) {
+      wild_copy<WildCopy>(
+          output.data() + out, input.data() + in, literal_length
+      );
+    } else {
+      std::copy_n(input.data() + in, literal_length, output.data() + out);
+    }
+    in += literal_length;
+    out += literal_length;
+
+    if (in == input.size()) {
+      break;
+    }
+
+    if (input.size() - in < 2) {
+      return false;
+    }
+    const size_t offset =
+      (size_t) input[in] | ((size_t) input[in + 1] << 8);
+    in += 2;
+    if (offset == 0 || offset > out) {
+      return false;
+    }
+
+    size_t match_length = token & NibbleMax;
+    if (match_length == NibbleMax && !read_length(input, in, match_length)) {
+      return false;
+    }
+    match_length += MinMatch;
+    if (match_length > output.size() - out) {
+      return false;
+    }
+
+    std::byte* target = output.data() + out;
+    const std::byte* source = target - offset;
+    if (offset >= sizeof(uint64_t) &&
+        match_length + sizeof(uint64_t) <= output.size() - out) {
+      // Blocks never overlap their own source
+      wild_copy<sizeof(uint64_t)>(target, source, match_length);
+    } else if (offset >= match_length) {
+      std::memcpy(target, source, match_length);
+    } else {
+      // Overlapping match repeats last `offset` bytes
+      for (size_t i = 0; i < match_length; ++i) {
+        target[i] = source[i];
+      }
+    }
+    out += match_length;
+  }
+
+  return out == output.size();
+}
+
+bool Compression::compressFrame(
+    std::span<const std::byte> frame,
+    std::vector<std::byte>& output
+) {
+  const auto payload = frame.subspan(Message::MinSize);
+  if (payload.size() < CompressionThreshold) {
+    return false;
+  }
+
+  Message::MessageHeader header;
+  std::memcpy(&header, frame.data(), sizeof(header));
+
+  output.clear();
+  output.reserve(sizeof(header) + sizeof(uint32_t)
+                 + lz_compress_bound(payload.size()));
+  output.resize(sizeof(header) + sizeof(uint32_t));
+  lz_compress(payload, output);
+
+  const size_t compressed_size = output.size() - sizeof(header);
+  if (compressed_size >= payload.size()) {
+    return false;
+  }
+
+  header.type = Message::Type((uint8_t) header.type | Message::CompressedFlag);
+  header.payload_size = htonl((uint32_t) compressed_size);
+  std::memcpy(output.data(), &header, sizeof(header));
+
+  uint32_t raw_size = htonl((uint32_t) payload.size());
+  std::memcpy(output.data() + sizeof(header), &raw_size, sizeof(raw_size));
+
+  return true;
+}
+
+std::optional<MessageView> Compression::decompressFrame(
+    MessageView view,
+    std::vector<std::byte>& buffer
+) {
+  const size_t raw_size = view.getUint32(0);
+  if (raw_size == 0 || raw_size > MaxDecompressedSize) {
+    return std::nullopt;
+  }
+
+  Message::MessageHeader header;
+  std::memcpy(&header, view.getBytes().data(), sizeof(header));
+  header.type = view.getType();
+  header.payload_size = htonl((uint32_t) raw_size);
+
+  buffer.resize(sizeof(header) + raw_size);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+
+  const auto compressed = view.getPayload().subspan(sizeof(uint32_t));
+  if (!lz_decompress(compressed, std::span(buffer).subspan(sizeof(header)))) {
+    return std::nullopt;
+  }
+
+  // Uncompressed message must be valid by itself
+  size_t message_size = 0;
+  auto result = MessageView::fromBytes(buffer, message_size);
+  if (!result.has_value() || result->isCompressed()) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+} // namespace message
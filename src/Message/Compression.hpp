@@ -0,0 +1,94 @@
+/**
+ * @file Compression.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief LZ77 block codec and compressed message frames
+ *
+ * Block format follows LZ4: every sequence starts with a token holding
+ * literal length (high nibble) and match length minus 4 (low nibble), each
+ * extended by bytes of 255 when the nibble is 15. Literals follow, then a
+ * little-endian 16-bit match offset. The last sequence has literals only.
+ *
+ * Compressed frame keeps the usual header, with `Message::CompressedFlag`
+ * set in type byte. Its payload is the uncompressed payload size
+ * (`uint32_t`, network order) followed by the compressed payload.
+ *
+ * @version 0.0.1
+ * @date 2024-11-14
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_COMPRESSION_HPP
+#define __MESSAGE_COMPRESSION_HPP
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+/**
+ * @brief Payloads smaller than this are never compressed
+ */
+constexpr size_t CompressionThreshold = 1024;
+
+/**
+ * @brief Compressed frames claiming larger payload are rejected
+ */
+constexpr size_t MaxDecompressedSize = 64 * 1024 * 1024;
+
+/**
+ * @brief Largest possible compressed size of `size` bytes
+ */
+size_t lz_compress_bound(size_t size);
+
+/**
+ * @brief Append compressed `input` to `output`
+ */
+void lz_compress(std::span<const std::byte> input, std::vector<std::byte>& output);
+
+/**
+ * @brief Decompress block which must expand to exactly `output.size()` bytes
+ *
+ * @return Block is valid
+ */
+bool lz_decompress(std::span<const std::byte> input, std::span<std::byte> output);
+
+class Compression final {
+public:
+  Compression() = delete;
+
+  /**
+   * @brief Build compressed frame from serialized message
+   *
+   * @param[in]  frame    Complete uncompressed message
+   * @param[out] output   Compressed frame, valid only if `true` is returned
+   *
+   * @return Payload is large enough and compression actually saves space
+   */
+  static bool compressFrame(
+      std::span<const std::byte> frame,
+      std::vector<std::byte>& output
+  );
+
+  /**
+   * @brief Restore and validate uncompressed message
+   *
+   * @param[in]  view     Compressed message, see `MessageView::isCompressed()`
+   * @param[out] buffer   Storage for uncompressed message
+   *
+   * @return View of message in `buffer`, or `std::nullopt` if frame is
+   * corrupt
+   */
+  static std::optional<MessageView> decompressFrame(
+      MessageView view,
+      std::vector<std::byte>& buffer
+  );
+};
+
+} // namespace message
+
+#endif /* Compression.hpp */
@@ -12,10 +12,11 @@
 #ifndef __MESSAGE_GET_COMMENTS_MESSAGE_HPP
 #define __MESSAGE_GET_COMMENTS_MESSAGE_HPP
 
-#include <netinet/in.h>
+#include <cstddef>
 #include <optional>
 
 #include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
 
 namespace message {
 
@@ -28,6 +29,16 @@ public:
     return std::nullopt;
   }
 
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<GetCommentsMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::CommentsRequest) {
+      return GetCommentsMessage(view);
+    }
+    return std::nullopt;
+  }
+
   // Non-Copyable
   GetCommentsMessage(const GetCommentsMessage&) = delete;
   GetCommentsMessage& operator=(const GetCommentsMessage&) = delete;
@@ -37,18 +48,52 @@ public:
   GetCommentsMessage& operator=(GetCommentsMessage&&) noexcept = default;
   
   size_t getStartIndex(void) const {
-    const auto* payload = 
-      reinterpret_cast<const Message::CommentsRequestPayload*> (
-          m_message.m_payload->payload
-      );
-    return ntohl(payload->start_index);
+    return m_view.getUint32(offsetof(Payload, start_index));
+  }
+
+  /**
+   * @brief Maximum number of comments to send, zero if not limited
+   */
+  size_t getMaxCount(void) const {
+    return hasLimits() ? m_view.getUint32(offsetof(Payload, max_count)) : 0;
+  }
+
+  /**
+   * @brief Maximum total size of sent comments, zero if not limited
+   */
+  size_t getMaxBytes(void) const {
+    return hasLimits() ? m_view.getUint32(offsetof(Payload, max_bytes)) : 0;
+  }
+
+  /**
+   * @brief Requested response layout. Unknown encodings are reported as is
+   */
+  Message::ResponseEncoding getEncoding(void) const {
+    if (m_view.getPayload().size() < sizeof(Payload)) {
+      return Message::ResponseEncoding::Plain;
+    }
+    return Message::ResponseEncoding(
+        m_view.getUint32(offsetof(Payload, encoding))
+    );
   }
 
 private:
+  using Payload = Message::CommentsRequestPayload;
+
   explicit GetCommentsMessage(Message&& message)
-    : m_message(std::move(message)) {
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit GetCommentsMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  bool hasLimits(void) const {
+    return m_view.getPayload().size() > Message::LegacyCommentsRequestSize;
   }
-  Message m_message;
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
 };
 
 } // namespace message
@@ -0,0 +1,92 @@
+/**
+ * @file GetCommentsSinceMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Request of comments stored since given time
+ *
+ * @version 0.0.1
+ * @date 2024-11-20
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_GET_COMMENTS_SINCE_MESSAGE_HPP
+#define __MESSAGE_GET_COMMENTS_SINCE_MESSAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class GetCommentsSinceMessage final {
+public:
+  static std::optional<GetCommentsSinceMessage> fromMessage(
+      Message&& message
+  ) {
+    if (message.getType() == Message::Type::CommentsSinceRequest) {
+      return GetCommentsSinceMessage(std::move(message));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<GetCommentsSinceMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::CommentsSinceRequest) {
+      return GetCommentsSinceMessage(view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  GetCommentsSinceMessage(const GetCommentsSinceMessage&) = delete;
+  GetCommentsSinceMessage& operator=(const GetCommentsSinceMessage&) = delete;
+
+  // Movable
+  GetCommentsSinceMessage(GetCommentsSinceMessage&&) noexcept = default;
+  GetCommentsSinceMessage& operator=(GetCommentsSinceMessage&&) noexcept
+    = default;
+
+  /**
+   * @brief Earliest time of sent comments, in microseconds since Unix epoch
+   */
+  uint64_t getSince(void) const {
+    return m_view.getUint64(offsetof(Payload, since));
+  }
+
+  /**
+   * @brief Maximum number of comments to send, zero if not limited
+   */
+  size_t getMaxCount(void) const {
+    return m_view.getUint32(offsetof(Payload, max_count));
+  }
+
+  /**
+   * @brief Maximum total size of sent comments, zero if not limited
+   */
+  size_t getMaxBytes(void) const {
+    return m_view.getUint32(offsetof(Payload, max_bytes));
+  }
+
+private:
+  using Payload = Message::CommentsSincePayload;
+
+  explicit GetCommentsSinceMessage(Message&& message)
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit GetCommentsSinceMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+};
+
+} // namespace message
+
+#endif /* GetCommentsSinceMessage.hpp */
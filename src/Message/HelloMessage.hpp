@@ -0,0 +1,88 @@
+/**
+ * @file HelloMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Greeting carrying protocol capabilities and author of comments
+ *
+ * @version 0.0.1
+ * @date 2024-11-14
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_HELLO_MESSAGE_HPP
+#define __MESSAGE_HELLO_MESSAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class HelloMessage final {
+public:
+  static std::optional<HelloMessage> fromMessage(Message&& message) {
+    if (message.getType() == Message::Type::Hello) {
+      return HelloMessage(std::move(message));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<HelloMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::Hello) {
+      return HelloMessage(view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  HelloMessage(const HelloMessage&) = delete;
+  HelloMessage& operator=(const HelloMessage&) = delete;
+
+  // Movable
+  HelloMessage(HelloMessage&&) noexcept = default;
+  HelloMessage& operator=(HelloMessage&&) noexcept = default;
+
+  /**
+   * @brief Set of `Message::Capability` flags, zero for Hello without payload
+   */
+  uint32_t getCapabilities(void) const {
+    if (m_view.getPayload().empty()) {
+      return 0;
+    }
+    return m_view.getUint32(offsetof(Payload, capabilities));
+  }
+
+  /**
+   * @brief Author of comments sent over connection, zero if anonymous
+   */
+  uint32_t getAuthor(void) const {
+    if (m_view.getPayload().size() < sizeof(Payload)) {
+      return 0;
+    }
+    return m_view.getUint32(offsetof(Payload, author));
+  }
+
+private:
+  using Payload = Message::HelloPayload;
+
+  explicit HelloMessage(Message&& message)
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit HelloMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+};
+
+} // namespace message
+
+#endif /* HelloMessage.hpp */
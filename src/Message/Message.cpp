@@ -1,5 +1,10 @@
 #include "Message.hpp"
+#include "Message/MessagePool.hpp"
+#include "Message/Compression.hpp"
+#include "Message/MessageView.hpp"
 #include <cassert>
+#include <cstring>
+#include <endian.h>
 #include <netinet/in.h>
 #include <new>
 #include <algorithm>
@@ -7,8 +12,6 @@
 
 namespace message {
 
-static constexpr char Magic[3] = { 'M', 'S', 'G' };
-
 Message::Message(Message&& other) noexcept
   : m_header(other.m_header),
     m_payload(other.m_payload)
@@ -20,8 +23,7 @@ Message::Message(Message&& other) noexcept
 
 Message& Message::operator=(Message&& other) noexcept {
   if (m_payload != nullptr) {
-      auto* bytes = reinterpret_cast<std::byte*>(m_payload);
-      delete[] bytes;
+    releaseDynamic(m_payload);
   }
 
   m_header = other.m_header;
@@ -34,13 +36,28 @@ Message& Message::operator=(Message&& other) noexcept {
   return *this;
 }
 
-Message Message::hello(void) {
-  MessageHeader header;
-  std::copy_n(Magic, sizeof(Magic), header.magic);
-  header.type = Type::Hello;
-  header.payload_size = 0;
+Message Message::hello(uint32_t capabilities, uint32_t author) {
+  if (capabilities == 0 && author == 0) {
+    MessageHeader header;
+    std::copy_n(Magic, sizeof(Magic), header.magic);
+    header.type = Type::Hello;
+    header.payload_size = 0;
 
-  return Message(header);
+    return Message(header);
+  }
+
+  // Anonymous Hello keeps the shorter layout understood by older servers
+  const size_t payload_size =
+    author == 0 ? LegacyHelloSize : sizeof(HelloPayload);
+  const size_t alloc_size = sizeof(DynamicMessage) + payload_size;
+  DynamicMessage* message = allocateDynamic(Type::Hello, alloc_size);
+
+  HelloPayload payload;
+  payload.capabilities = htonl(capabilities);
+  payload.author = htonl(author);
+  std::memcpy(message->payload, &payload, payload_size);
+
+  return Message(message);
 }
 
 Message Message::goodbye(void) {
@@ -61,10 +78,19 @@ Message Message::commentOk(void) {
   return Message(header);
 }
 
+Message Message::getStats(void) {
+  MessageHeader header;
+  std::copy_n(Magic, sizeof(Magic), header.magic);
+  header.type = Type::GetStats;
+  header.payload_size = 0;
+
+  return Message(header);
+}
+
 Message::DynamicMessage* Message::allocateDynamic(Type type, size_t alloc_size) {
   assert(alloc_size > sizeof(MessageHeader));
-  std::byte* bytes =
-    new(std::align_val_t(alignof(DynamicMessage))) std::byte[alloc_size];
+  static_assert(alignof(DynamicMessage) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+  std::byte* bytes = MessagePool::allocate(alloc_size);
 
   DynamicMessage* message = reinterpret_cast<DynamicMessage*>(bytes);
   MessageHeader& header = message->header;
@@ -76,6 +102,12 @@ Message::DynamicMessage* Message::allocateDynamic(Type type, size_t alloc_size)
   return message;
 }
 
+void Message::releaseDynamic(DynamicMessage* message) noexcept {
+  const size_t alloc_size =
+    sizeof(MessageHeader) + ntohl(message->header.payload_size);
+  MessagePool::deallocate(reinterpret_cast<std::byte*>(message), alloc_size);
+}
+
 Message Message::newComment(std::string comment) {
   const size_t alloc_size = sizeof(DynamicMessage) + comment.length();
 
@@ -86,42 +118,215 @@ Message Message::newComment(std::string comment) {
   return Message(message);
 }
 
-Message Message::getComments(uint32_t start_index) {
+Message Message::stats(std::string_view text) {
+  const size_t alloc_size = sizeof(DynamicMessage) + text.length();
+
+  DynamicMessage* message = allocateDynamic(Type::Stats, alloc_size);
+  char* chars = reinterpret_cast<char*>(message->payload);
+  std::copy_n(text.begin(), text.length(), chars);
+
+  return Message(message);
+}
+
+Message Message::newCommentsBatch(std::span<const std::string> comments) {
+  size_t total_length = 0;
+  for (const std::string& comment : comments) {
+    total_length += comment.length() + 1;
+  }
+
+  const size_t alloc_size = sizeof(DynamicMessage) + total_length;
+
+  DynamicMessage* message = allocateDynamic(Type::NewCommentsBatch, alloc_size);
+  char* chars = reinterpret_cast<char*>(message->payload);
+  for (const std::string& comment : comments) {
+    std::copy_n(comment.begin(), comment.length(), chars);
+    chars[comment.length()] = '\0';
+    chars += comment.length() + 1;
+  }
+
+  return Message(message);
+}
+
+Message Message::commentsBatchOk(uint32_t first_index, uint32_t count) {
   const size_t alloc_size =
-    sizeof(DynamicMessage) + sizeof(CommentsRequestPayload);
+    sizeof(DynamicMessage) + sizeof(CommentsBatchOkPayload);
+
+  DynamicMessage* message = allocateDynamic(Type::CommentsBatchOk, alloc_size);
+
+  CommentsBatchOkPayload& payload =
+    *reinterpret_cast<CommentsBatchOkPayload*>(message->payload);
+  payload.first_index = htonl(first_index);
+  payload.count = htonl(count);
+
+  return Message(message);
+}
+
+Message Message::subscribe(uint32_t start_index) {
+  const size_t alloc_size = sizeof(DynamicMessage) + sizeof(SubscribePayload);
+  DynamicMessage* message = allocateDynamic(Type::Subscribe, alloc_size);
+
+  SubscribePayload payload;
+  payload.start_index = htonl(start_index);
+  std::memcpy(message->payload, &payload, sizeof(payload));
+
+  return Message(message);
+}
+
+Message Message::replicate(uint32_t start_index) {
+  const size_t alloc_size = sizeof(DynamicMessage) + sizeof(SubscribePayload);
+  DynamicMessage* message = allocateDynamic(Type::Replicate, alloc_size);
+
+  SubscribePayload payload;
+  payload.start_index = htonl(start_index);
+  std::memcpy(message->payload, &payload, sizeof(payload));
+
+  return Message(message);
+}
+
+Message Message::getComments(
+    uint32_t start_index,
+    uint32_t max_count,
+    uint32_t max_bytes,
+    ResponseEncoding encoding
+) {
+  // Plain requests keep the shorter layout understood by older servers
+  const size_t payload_size = encoding == ResponseEncoding::Plain
+    ? PlainCommentsRequestSize
+    : sizeof(CommentsRequestPayload);
+  const size_t alloc_size = sizeof(DynamicMessage) + payload_size;
 
   DynamicMessage* message = allocateDynamic(Type::CommentsRequest, alloc_size);
 
-  CommentsRequestPayload& payload =
-    *reinterpret_cast<CommentsRequestPayload*>(message->payload);
+  CommentsRequestPayload payload;
   payload.start_index = htonl(start_index);
+  payload.max_count = htonl(max_count);
+  payload.max_bytes = htonl(max_bytes);
+  payload.encoding = htonl((uint32_t) encoding);
+  std::memcpy(message->payload, &payload, payload_size);
+
+  return Message(message);
+}
+
+Message Message::getCommentsSince(
+    uint64_t since,
+    uint32_t max_count,
+    uint32_t max_bytes
+) {
+  const size_t alloc_size =
+    sizeof(DynamicMessage) + sizeof(CommentsSincePayload);
+  DynamicMessage* message =
+    allocateDynamic(Type::CommentsSinceRequest, alloc_size);
+
+  CommentsSincePayload payload;
+  payload.since = htobe64(since);
+  payload.max_count = htonl(max_count);
+  payload.max_bytes = htonl(max_bytes);
+  std::memcpy(message->payload, &payload, sizeof(payload));
 
   return Message(message);
 }
 
+/**
+ * @brief Type of CommentsResponse with given encoding
+ */
+static Message::Type response_type(Message::ResponseEncoding encoding) {
+  using Encoding = Message::ResponseEncoding;
+
+  switch (encoding) {
+  case Encoding::Indexed:
+    return Message::Type::IndexedCommentsResponse;
+  case Encoding::Annotated:
+    return Message::Type::AnnotatedCommentsResponse;
+  case Encoding::Plain:
+  default:
+    return Message::Type::CommentsResponse;
+  }
+}
+
+size_t Message::commentTableSize(
+    size_t send_count,
+    ResponseEncoding encoding
+) noexcept {
+  switch (encoding) {
+  case ResponseEncoding::Indexed:
+    return send_count * sizeof(uint32_t);
+  case ResponseEncoding::Annotated:
+    return send_count * sizeof(CommentMetadata);
+  case ResponseEncoding::Plain:
+  default:
+    return 0;
+  }
+}
+
+void Message::writeCommentTable(
+    const storage::CommentStore::Snapshot& comments,
+    size_t start_index,
+    size_t send_count,
+    ResponseEncoding encoding,
+    std::span<std::byte> table
+) {
+  assert(table.size() == commentTableSize(send_count, encoding));
+  if (encoding != ResponseEncoding::Indexed &&
+      encoding != ResponseEncoding::Annotated) {
+    return;
+  }
+
+  // Table is filled in place, response payload is not necessarily aligned
+  std::byte* position = table.data();
+  uint32_t offset = 0;
+  for (size_t i = start_index; i < start_index + send_count; ++i) {
+    const storage::CommentRecord& record = comments.record(i);
+
+    if (encoding == ResponseEncoding::Indexed) {
+      const uint32_t net_offset = htonl(offset);
+      std::memcpy(position, &net_offset, sizeof(net_offset));
+      position += sizeof(net_offset);
+    } else {
+      CommentMetadata metadata;
+      metadata.timestamp = htobe64(record.timestamp);
+      metadata.author = htonl(record.author);
+      metadata.offset = htonl(offset);
+      std::memcpy(position, &metadata, sizeof(metadata));
+      position += sizeof(metadata);
+    }
+
+    offset += record.size + 1;
+  }
+}
+
 Message Message::sendComments(
-    const std::vector<std::string> comments,
+    const storage::CommentStore::Snapshot& comments,
     size_t start_index,
-    size_t send_count
+    size_t send_count,
+    ResponseEncoding encoding
 ) {
   assert(send_count == 0 || start_index < comments.size());
   assert(send_count == 0 || start_index + send_count <= comments.size());
 
+  const size_t table_size = commentTableSize(send_count, encoding);
+
   size_t total_length = 0;
   for (size_t i = start_index; i < start_index + send_count; ++i) {
     total_length += comments[i].length() + 1;
   }
 
-  const size_t alloc_size =
-    sizeof(DynamicMessage) + sizeof(CommentsResponsePayload) + total_length;
+  const size_t alloc_size = sizeof(DynamicMessage)
+    + sizeof(CommentsResponsePayload) + table_size + total_length;
 
-  DynamicMessage* message = allocateDynamic(Type::CommentsResponse, alloc_size);
+  DynamicMessage* message =
+    allocateDynamic(response_type(encoding), alloc_size);
   CommentsResponsePayload& payload =
     *reinterpret_cast<CommentsResponsePayload*>(message->payload);
   payload.total_comments = htonl(comments.size());
   payload.sent_comments = htonl(send_count);
+  payload.next_index = htonl(start_index + send_count);
 
-  char* chars = payload.comments;
+  writeCommentTable(
+      comments, start_index, send_count, encoding,
+      std::as_writable_bytes(std::span(payload.comments, table_size))
+  );
+
+  char* chars = payload.comments + table_size;
   for (size_t i = start_index; i < start_index + send_count; ++i) {
     std::copy_n(comments[i].begin(), comments[i].length(), chars);
     chars[comments[i].length()] = '\0';
@@ -131,6 +336,116 @@ Message Message::sendComments(
   return Message(message);
 }
 
+Message::CommentsResponsePrefix Message::sendCommentsPrefix(
+    size_t total_count,
+    size_t send_count,
+    size_t next_index,
+    size_t comments_size,
+    ResponseEncoding encoding
+) {
+  const size_t table_size = commentTableSize(send_count, encoding);
+
+  MessageHeader header;
+  std::copy_n(Magic, sizeof(Magic), header.magic);
+  header.type = response_type(encoding);
+  header.payload_size =
+    htonl(sizeof(CommentsResponsePayload) + table_size + comments_size);
+
+  CommentsResponsePayload payload;
+  payload.total_comments = htonl(total_count);
+  payload.sent_comments = htonl(send_count);
+  payload.next_index = htonl(next_index);
+
+  CommentsResponsePrefix prefix;
+  std::memcpy(prefix.data(), &header, sizeof(header));
+  std::memcpy(
+      prefix.data() + sizeof(header),
+      &payload,
+      sizeof(CommentsResponsePayload)
+  );
+
+  return prefix;
+}
+
+Message::CommentsResponsePrefix Message::pushCommentsPrefix(
+    size_t total_count,
+    size_t send_count,
+    size_t next_index,
+    size_t comments_size
+) {
+  CommentsResponsePrefix prefix = sendCommentsPrefix(
+      total_count, send_count, next_index, comments_size
+  );
+  prefix[offsetof(MessageHeader, type)] = std::byte(Type::CommentsPush);
+
+  return prefix;
+}
+
+Message::CommentsResponsePrefix Message::replicatedCommentsPrefix(
+    size_t total_count,
+    size_t send_count,
+    size_t next_index,
+    size_t comments_size
+) {
+  CommentsResponsePrefix prefix = sendCommentsPrefix(
+      total_count, send_count, next_index, comments_size,
+      ResponseEncoding::Annotated
+  );
+  prefix[offsetof(MessageHeader, type)] =
+    std::byte(Type::ReplicatedComments);
+
+  return prefix;
+}
+
+Message Message::searchComments(
+    std::string_view query,
+    uint32_t start_index,
+    uint32_t max_count
+) {
+  const size_t alloc_size =
+    sizeof(DynamicMessage) + sizeof(SearchRequestPayload) + query.length();
+  DynamicMessage* message = allocateDynamic(Type::SearchComments, alloc_size);
+
+  SearchRequestPayload payload;
+  payload.start_index = htonl(start_index);
+  payload.max_count = htonl(max_count);
+  std::memcpy(message->payload, &payload, sizeof(payload));
+
+  char* chars =
+    reinterpret_cast<char*>(message->payload + sizeof(SearchRequestPayload));
+  std::copy_n(query.begin(), query.length(), chars);
+
+  return Message(message);
+}
+
+Message::SearchResultsPrefix Message::searchResultsPrefix(
+    size_t send_count,
+    size_t next_index,
+    size_t comments_size
+) {
+  MessageHeader header;
+  std::copy_n(Magic, sizeof(Magic), header.magic);
+  header.type = Type::SearchResults;
+  header.payload_size = htonl(
+      sizeof(SearchResultsPayload) + send_count * sizeof(uint32_t)
+      + comments_size
+  );
+
+  SearchResultsPayload payload;
+  payload.sent_comments = htonl(send_count);
+  payload.next_index = htonl(next_index);
+
+  SearchResultsPrefix prefix;
+  std::memcpy(prefix.data(), &header, sizeof(header));
+  std::memcpy(
+      prefix.data() + sizeof(header),
+      &payload,
+      sizeof(SearchResultsPayload)
+  );
+
+  return prefix;
+}
+
 std::span<const std::byte> Message::getBytes(void) const {
   if (m_payload == nullptr) {
     return std::span(
@@ -141,92 +456,45 @@ std::span<const std::byte> Message::getBytes(void) const {
 
   return std::span(
       reinterpret_cast<const std::byte*> (m_payload),
-      sizeof(MessageHeader) + m_header.payload_size
+      sizeof(MessageHeader) + ntohl(m_header.payload_size)
   );
 }
 
+MessageView Message::view(void) const {
+  return MessageView(getType(), getBytes());
+}
+
 std::optional<Message> Message::fromBytes(
     std::span<const std::byte> bytes,
     size_t& message_size
 ) {
-  if (bytes.size() < MinSize) {
+  auto view = MessageView::fromBytes(bytes, message_size);
+  if (!view.has_value()) {
     return std::nullopt;
   }
 
-  const MessageHeader& header =
-    *reinterpret_cast<const MessageHeader*> (bytes.data());
-
-  bool has_magic = std::equal(Magic, Magic + sizeof(Magic), header.magic);
-  if (!has_magic) {
-    return std::nullopt;
-  }
-
-  size_t payload_size = ntohl(header.payload_size);
-
-  if (payload_size == 0) {
-    bool has_valid_type =
-      header.type == Type::Hello ||
-      header.type == Type::Goodbye ||
-      header.type == Type::CommentOk;
-    bool has_valid_size = (bytes.size() == sizeof(MessageHeader));
-    
-    if (has_valid_type && has_valid_size) {
-      message_size = sizeof(MessageHeader);
-      return Message(header);
-    } else {
+  std::vector<std::byte> inflated;
+  if (view->isCompressed()) {
+    view = Compression::decompressFrame(*view, inflated);
+    if (!view.has_value()) {
       return std::nullopt;
     }
   }
-  
-  if (header.type == Type::CommentsRequest) {
-    size_t full_size = sizeof(MessageHeader) + sizeof(CommentsRequestPayload);
-
-    if (payload_size != sizeof(CommentsRequestPayload)) {
-      return std::nullopt;
-    }
-    if (bytes.size() > full_size) {
-      return std::nullopt;
-    }
-
-    message_size = full_size;
-    if (bytes.size() < full_size) {
-      return std::nullopt;
-    }
 
-    DynamicMessage* message = allocateDynamic(Type::CommentsRequest, full_size);
-    std::copy(
-        bytes.begin(), bytes.end(),
-        reinterpret_cast<std::byte*> (message)
-    );
-
-    return Message(message);
+  auto frame = view->getBytes();
+  if (frame.size() == sizeof(MessageHeader)) {
+    MessageHeader header;
+    std::memcpy(&header, frame.data(), sizeof(header));
+    return Message(header);
   }
 
-  if (
-    header.type == Type::CommentsResponse ||
-    header.type == Type::NewComment
-  ) {
-    size_t full_size = sizeof(MessageHeader) + payload_size;
-    if (bytes.size() > full_size) {
-      return std::nullopt;
-    }
-
-    message_size = full_size;
-    if (bytes.size() < full_size) {
-      return std::nullopt;
-    }
-
-    DynamicMessage* message = allocateDynamic(Type::CommentsRequest, full_size);
-    std::copy(
-        bytes.begin(), bytes.end(),
-        reinterpret_cast<std::byte*> (message)
-    );
-
-    return Message(message);
-  }
+  DynamicMessage* message = allocateDynamic(view->getType(), frame.size());
+  std::copy(
+      frame.begin(), frame.end(),
+      reinterpret_cast<std::byte*> (message)
+  );
 
-  return std::nullopt;
+  return Message(message);
 }
 
-
 } // namespace message
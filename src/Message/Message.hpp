@@ -12,44 +12,216 @@
 #ifndef __MESSAGE_MESSAGE_HPP
 #define __MESSAGE_MESSAGE_HPP
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <span>
 #include <string>
-#include <vector>
+#include <string_view>
+
+#include "Storage/CommentStore.hpp"
 
 namespace message {
 
 class NewCommentMessage;
 class GetCommentsMessage;
+class GetCommentsSinceMessage;
 class SendCommentsMessage;
+class NewCommentsBatchMessage;
+class CommentsBatchOkMessage;
+class HelloMessage;
+class SubscribeMessage;
+class StatsMessage;
+class SearchCommentsMessage;
+class SearchResultsMessage;
+class MessageView;
+class Compression;
 
 class Message final {
   friend class NewCommentMessage;
   friend class GetCommentsMessage;
+  friend class GetCommentsSinceMessage;
   friend class SendCommentsMessage;
+  friend class NewCommentsBatchMessage;
+  friend class CommentsBatchOkMessage;
+  friend class HelloMessage;
+  friend class SubscribeMessage;
+  friend class StatsMessage;
+  friend class SearchCommentsMessage;
+  friend class SearchResultsMessage;
+  friend class MessageView;
+  friend class Compression;
 
 public:
   enum class Type : uint8_t {
-    Hello,            // No payload
+    Hello,            // No payload or HelloPayload
     Goodbye,          // No payload
     NewComment,       // Dynamic payload (chars)
     CommentsRequest,  // Dynamic payload (CommentsRequestPayload)
     CommentOk,        // No payload
-    CommentsResponse  // Dynamic payload (CommentsResponsePayload)
+    CommentsResponse, // Dynamic payload (CommentsResponsePayload)
+    NewCommentsBatch, // Dynamic payload (NUL-terminated strings)
+    CommentsBatchOk,  // Dynamic payload (CommentsBatchOkPayload)
+    IndexedCommentsResponse, // Dynamic payload (CommentsResponsePayload)
+    Subscribe,        // Dynamic payload (SubscribePayload)
+    CommentsPush,     // Dynamic payload (CommentsResponsePayload)
+    GetStats,         // No payload
+    Stats,            // Dynamic payload (chars)
+    SearchComments,   // Dynamic payload (SearchRequestPayload)
+    SearchResults,    // Dynamic payload (SearchResultsPayload)
+    CommentsSinceRequest,       // Dynamic payload (CommentsSincePayload)
+    AnnotatedCommentsResponse,  // Dynamic payload (CommentsResponsePayload)
+    Replicate,                  // Dynamic payload (SubscribePayload)
+    ReplicatedComments          // Dynamic payload (CommentsResponsePayload)
+  };
+
+  /**
+   * @brief Layout of comments in response.
+   *
+   * Indexed response is sent as IndexedCommentsResponse. It has offset of
+   * every comment, relative to the first comment, stored as `uint32_t`
+   * before comment bytes, so that any comment is reachable without scanning.
+   *
+   * Annotated response is sent as AnnotatedCommentsResponse. It has
+   * `CommentMetadata` of every comment before comment bytes instead.
+   */
+  enum class ResponseEncoding : uint32_t {
+    Plain,
+    Indexed,
+    Annotated
+  };
+
+  /**
+   * @brief Optional protocol features, announced by client in Hello.
+   *
+   * Server answers with Hello carrying features both sides support, which
+   * are in effect for the rest of connection.
+   */
+  enum Capability : uint32_t {
+    // Large payloads may be sent compressed, see Compression.hpp
+    CapabilityCompression = 1u << 0
   };
 
+  /**
+   * @brief Set in type byte of compressed message
+   */
+  static constexpr uint8_t CompressedFlag = 0x80;
+
 private:
+  static constexpr char Magic[3] = { 'M', 'S', 'G' };
+
   struct alignas(uint32_t) MessageHeader {
     char magic[3];
     Type type;
     uint32_t payload_size;
   };
 
+  struct HelloPayload {
+    uint32_t capabilities;
+
+    // Optional, zero if omitted
+    uint32_t author;
+  };
+  static constexpr size_t LegacyHelloSize = offsetof(HelloPayload, author);
+
+  struct CommentsRequestPayload {
+    uint32_t start_index;
+
+    // Optional, may be omitted by older clients. Zero means no limit
+    uint32_t max_count;
+    uint32_t max_bytes;
+
+    // Optional, ResponseEncoding::Plain if omitted
+    uint32_t encoding;
+  };
+  static constexpr size_t LegacyCommentsRequestSize =
+    offsetof(CommentsRequestPayload, max_count);
+  static constexpr size_t PlainCommentsRequestSize =
+    offsetof(CommentsRequestPayload, encoding);
+
+  struct CommentsResponsePayload {
+    uint32_t total_comments;
+    uint32_t sent_comments;
+    uint32_t next_index;  // Index to request next page from
+
+    char comments[];  // NUL-separated strings, preceded by offsets if indexed
+  };
+
+  struct CommentsSincePayload {
+    uint64_t since;  // Microseconds since Unix epoch
+
+    // Zero means no limit
+    uint32_t max_count;
+    uint32_t max_bytes;
+  };
+
+  struct SubscribePayload {
+    uint32_t start_index;
+  };
+
+  struct SearchRequestPayload {
+    uint32_t start_index;  // Smallest index of reported comment
+    uint32_t max_count;    // Zero means server limit
+
+    char query[];  // Words, not terminated
+  };
+
+  struct SearchResultsPayload {
+    uint32_t sent_comments;
+    uint32_t next_index;  // Start index to request next page from
+
+    // Index of every sent comment, followed by NUL-separated comments
+    char results[];
+  };
+
+  struct CommentsBatchOkPayload {
+    uint32_t first_index;  // Index assigned to first comment of batch
+    uint32_t count;
+  };
+
 public:
+  /**
+   * @brief Entry of AnnotatedCommentsResponse table, in network order
+   */
+  struct CommentMetadata {
+    uint64_t timestamp;  // Microseconds since Unix epoch
+    uint32_t author;     // Zero if comment is anonymous
+    uint32_t offset;     // Relative to the first comment
+  };
+
   static constexpr size_t MinSize = sizeof(MessageHeader);
 
+  /**
+   * @brief Headers declaring larger payload are invalid, so that peer
+   * cannot make reader allocate buffer of any size
+   */
+  static constexpr size_t MaxPayloadSize = 64 * 1024 * 1024;
+
+  /**
+   * @brief NewCommentsBatch with more comments is invalid, so that batch of
+   * empty comments cannot make server store millions of records at once
+   */
+  static constexpr size_t MaxBatchCount = 64 * 1024;
+
+  static constexpr size_t CommentsResponsePrefixSize =
+    sizeof(MessageHeader) + sizeof(CommentsResponsePayload);
+
+  /**
+   * @brief Serialized CommentsResponse without comment bytes
+   */
+  using CommentsResponsePrefix =
+    std::array<std::byte, CommentsResponsePrefixSize>;
+
+  static constexpr size_t SearchResultsPrefixSize =
+    sizeof(MessageHeader) + sizeof(SearchResultsPayload);
+
+  /**
+   * @brief Serialized SearchResults without indices and comment bytes
+   */
+  using SearchResultsPrefix =
+    std::array<std::byte, SearchResultsPrefixSize>;
+
   // Non-Copyable
   Message(const Message&) = delete;
   Message& operator=(const Message&) = delete;
@@ -58,20 +230,181 @@ public:
   Message(Message&&) noexcept;
   Message& operator=(Message&&) noexcept;
 
-  static Message hello(void);
+  /**
+   * @brief Greeting announcing supported capabilities, and author of
+   * comments sent by client over this connection, zero if anonymous. Hello
+   * without capabilities and author has no payload, as sent by older peers
+   */
+  static Message hello(uint32_t capabilities = 0, uint32_t author = 0);
 
   static Message goodbye(void);
 
   static Message newComment(std::string comment);
   
-  static Message getComments(uint32_t start_index);
+  /**
+   * @brief Request comments starting from `start_index`.
+   *
+   * Server sends at most `max_count` comments of at most `max_bytes` total
+   * size (including separators), but at least one comment if available.
+   * Zero limit means no limit.
+   */
+  static Message getComments(
+      uint32_t start_index,
+      uint32_t max_count = 0,
+      uint32_t max_bytes = 0,
+      ResponseEncoding encoding = ResponseEncoding::Plain
+  );
+
+  /**
+   * @brief Request comments stored at `since` (microseconds since Unix
+   * epoch) or later, limited as in `getComments()`.
+   *
+   * Server answers with AnnotatedCommentsResponse, whose `next_index`
+   * continues the listing with `getComments()`.
+   */
+  static Message getCommentsSince(
+      uint64_t since,
+      uint32_t max_count = 0,
+      uint32_t max_bytes = 0
+  );
 
   static Message commentOk(void);
 
+  /**
+   * @brief Send several comments in one message.
+   *
+   * Server stores all comments of batch at once, under consecutive indices.
+   */
+  static Message newCommentsBatch(std::span<const std::string> comments);
+
+  /**
+   * @brief Acknowledge batch stored at indices
+   * [`first_index`, `first_index + count`)
+   */
+  static Message commentsBatchOk(uint32_t first_index, uint32_t count);
+
+  /**
+   * @brief Ask server to push comments from `start_index` on.
+   *
+   * Server answers with CommentsPush of comments already stored, possibly
+   * none, and then sends CommentsPush, not tied to any request, whenever
+   * new comments are stored. Pushes have plain layout and carry index of
+   * next pushed comment in `next_index`. Subscribing again moves the start.
+   */
+  static Message subscribe(uint32_t start_index);
+
+  /**
+   * @brief Ask server to stream its comments from `start_index` on to a
+   * follower.
+   *
+   * Works as `subscribe()`, but pushes are ReplicatedComments with
+   * annotated layout, so that follower stores comments with timestamps and
+   * authors they were given by this server.
+   */
+  static Message replicate(uint32_t start_index);
+
+  /**
+   * @brief Ask server for its metrics, answered with Stats
+   */
+  static Message getStats(void);
+
+  /**
+   * @brief Metrics in Prometheus text format, must not be empty
+   */
+  static Message stats(std::string_view text);
+
+  /**
+   * @brief Find comments containing every word of `query`.
+   *
+   * Server answers with SearchResults holding at most `max_count` matching
+   * comments with indices from `start_index` on, in increasing index
+   * order, together with their indices. Words are compared
+   * case-insensitively.
+   */
+  static Message searchComments(
+      std::string_view query,
+      uint32_t start_index = 0,
+      uint32_t max_count = 0
+  );
+
+  /**
+   * @brief Build header and fixed payload part of SearchResults.
+   *
+   * Message is complete once `send_count` indices (`uint32_t`, network
+   * order) and then `comments_size` bytes of NUL-terminated comments are
+   * sent after the prefix.
+   */
+  static SearchResultsPrefix searchResultsPrefix(
+      size_t send_count,
+      size_t next_index,
+      size_t comments_size
+  );
+
   static Message sendComments(
-      const std::vector<std::string> comments,
+      const storage::CommentStore::Snapshot& comments,
+      size_t start_index,
+      size_t send_count,
+      ResponseEncoding encoding = ResponseEncoding::Plain
+  );
+
+  /**
+   * @brief Build header and fixed payload part of CommentsResponse.
+   *
+   * Message is complete once `comments_size` bytes of NUL-terminated
+   * comments are sent after the prefix, preceded by table of
+   * `commentTableSize()` bytes unless response is plain. Allows sending
+   * comments directly from storage without assembling the whole message
+   * in memory.
+   */
+  static CommentsResponsePrefix sendCommentsPrefix(
+      size_t total_count,
+      size_t send_count,
+      size_t next_index,
+      size_t comments_size,
+      ResponseEncoding encoding = ResponseEncoding::Plain
+  );
+
+  /**
+   * @brief Size of table preceding `send_count` comments of response
+   */
+  static size_t commentTableSize(
+      size_t send_count,
+      ResponseEncoding encoding
+  ) noexcept;
+
+  /**
+   * @brief Fill table preceding comments [`start_index`,
+   * `start_index + send_count`) of response, which must have
+   * `commentTableSize()` bytes
+   */
+  static void writeCommentTable(
+      const storage::CommentStore::Snapshot& comments,
       size_t start_index,
-      size_t send_count
+      size_t send_count,
+      ResponseEncoding encoding,
+      std::span<std::byte> table
+  );
+
+  /**
+   * @brief Build header and fixed payload part of CommentsPush, see
+   * `sendCommentsPrefix()`
+   */
+  static CommentsResponsePrefix pushCommentsPrefix(
+      size_t total_count,
+      size_t send_count,
+      size_t next_index,
+      size_t comments_size
+  );
+
+  /**
+   * @brief Build header and fixed payload part of ReplicatedComments,
+   * which is followed by annotated table, see `sendCommentsPrefix()`
+   */
+  static CommentsResponsePrefix replicatedCommentsPrefix(
+      size_t total_count,
+      size_t send_count,
+      size_t next_index,
+      size_t comments_size
   );
 
   static std::optional<Message> fromBytes(
@@ -81,29 +414,24 @@ public:
 
   std::span<const std::byte> getBytes(void) const;
 
+  /**
+   * @brief Non-owning view of message, valid while message is alive.
+   *
+   * Views of messages without payload are invalidated when message moves.
+   */
+  MessageView view(void) const;
+
   Message() = delete;
 
   Type getType(void) const noexcept { return m_header.type; }
 
   ~Message() {
     if (m_payload != nullptr) {
-      auto* bytes = reinterpret_cast<std::byte*>(m_payload);
-      delete[] bytes;
+      releaseDynamic(m_payload);
     }
   }
 
 private:
-  struct CommentsRequestPayload {
-    uint32_t start_index;
-  };
-
-  struct CommentsResponsePayload {
-    uint32_t total_comments;
-    uint32_t sent_comments;
-
-    char comments[];  // NUL-separated strings
-  };
-
   struct DynamicMessage {
     MessageHeader header;
     std::byte payload[];
@@ -139,6 +467,7 @@ private:
   );
 
   static DynamicMessage* allocateDynamic(Type type, size_t alloc_size);
+  static void releaseDynamic(DynamicMessage* message) noexcept;
 
   MessageHeader m_header;
   DynamicMessage* m_payload = NULL;
@@ -0,0 +1,101 @@
+#include "MessagePool.hpp"
+
+#include <bit>
+#include <new>
+
+namespace message {
+
+static constexpr size_t ClassCount =
+  std::bit_width(MessagePool::MaxClassSize)
+  - std::bit_width(MessagePool::MinClassSize) + 1;
+
+// Every class caches at most this many bytes per thread, but no less than
+// MinCachedBuffers buffers
+static constexpr size_t MaxCachedBytes = 256 * 1024;
+static constexpr size_t MinCachedBuffers = 4;
+
+static constexpr size_t class_index(size_t size) {
+  if (size <= MessagePool::MinClassSize) {
+    return 0;
+  }
+  return std::bit_width(size - 1)
+         - std::bit_width(MessagePool::MinClassSize - 1);
+}
+
+static constexpr size_t class_size(size_t index) {
+  return MessagePool::MinClassSize << index;
+}
+
+static constexpr size_t class_capacity(size_t index) {
+  size_t capacity = MaxCachedBytes / class_size(index);
+  return capacity < MinCachedBuffers ? MinCachedBuffers : capacity;
+}
+
+static_assert(class_size(ClassCount - 1) == MessagePool::MaxClassSize);
+static_assert(class_index(MessagePool::MaxClassSize) == ClassCount - 1);
+
+namespace {
+
+struct FreeBuffer {
+  FreeBuffer* next;
+};
+
+struct ThreadCache {
+  FreeBuffer* heads[ClassCount] = {};
+  size_t counts[ClassCount] = {};
+
+  ThreadCache() = default;
+
+  // Non-Copyable
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+
+  ~ThreadCache() {
+    for (size_t i = 0; i < ClassCount; ++i) {
+      while (heads[i] != nullptr) {
+        FreeBuffer* buffer = heads[i];
+        heads[i] = buffer->next;
+        ::operator delete(buffer, class_size(i));
+      }
+    }
+  }
+};
+
+} // anonymous namespace
+
+static thread_local ThreadCache s_cache;
+
+std::byte* MessagePool::allocate(size_t size) {
+  if (size > MaxClassSize) {
+    return static_cast<std::byte*>(::operator new(size));
+  }
+
+  const size_t index = class_index(size);
+  FreeBuffer* buffer = s_cache.heads[index];
+  if (buffer == nullptr) {
+    return static_cast<std::byte*>(::operator new(class_size(index)));
+  }
+
+  s_cache.heads[index] = buffer->next;
+  --s_cache.counts[index];
+  return reinterpret_cast<std::byte*>(buffer);
+}
+
+void MessagePool::deallocate(std::byte* bytes, size_t size) noexcept {
+  if (size > MaxClassSize) {
+    ::operator delete(bytes, size);
+    return;
+  }
+
+  const size_t index = class_index(size);
+  if (s_cache.counts[index] >= class_capacity(index)) {
+    ::operator delete(bytes, class_size(index));
+    return;
+  }
+
+  FreeBuffer* buffer = new(bytes) FreeBuffer{ s_cache.heads[index] };
+  s_cache.heads[index] = buffer;
+  ++s_cache.counts[index];
+}
+
+} // namespace message
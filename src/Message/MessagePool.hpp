@@ -0,0 +1,47 @@
+/**
+ * @file MessagePool.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Thread-local slab allocator for dynamic message buffers
+ *
+ * Buffers are rounded up to power-of-two size classes and recycled through
+ * per-thread free lists, so steady message traffic does not reach malloc.
+ * Buffer may be released by any thread, it then joins that thread's cache.
+ *
+ * @version 0.0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_MESSAGE_POOL_HPP
+#define __MESSAGE_MESSAGE_POOL_HPP
+
+#include <cstddef>
+
+namespace message {
+
+class MessagePool final {
+public:
+  MessagePool() = delete;
+
+  // Smallest and largest pooled buffers, others go straight to allocator
+  static constexpr size_t MinClassSize = 32;
+  static constexpr size_t MaxClassSize = 64 * 1024;
+
+  /**
+   * @brief Allocate buffer of at least `size` bytes
+   */
+  static std::byte* allocate(size_t size);
+
+  /**
+   * @brief Return buffer to pool
+   *
+   * @param[in] bytes   Buffer returned by `allocate()`
+   * @param[in] size    Size passed to `allocate()`
+   */
+  static void deallocate(std::byte* bytes, size_t size) noexcept;
+};
+
+} // namespace message
+
+#endif /* MessagePool.hpp */
@@ -0,0 +1,153 @@
+#include "MessageView.hpp"
+#include "Message/Message.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <netinet/in.h>
+
+namespace message {
+
+std::optional<MessageView> MessageView::fromBytes(
+    std::span<const std::byte> bytes,
+    size_t& message_size
+) {
+  using MessageHeader = Message::MessageHeader;
+
+  if (bytes.size() < Message::MinSize) {
+    return std::nullopt;
+  }
+
+  MessageHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+
+  bool has_magic =
+    std::equal(Message::Magic, Message::Magic + sizeof(Message::Magic),
+               header.magic);
+  if (!has_magic) {
+    return std::nullopt;
+  }
+
+  size_t payload_size = ntohl(header.payload_size);
+
+  // Rejected from header alone, before reader grows buffer for it
+  if (payload_size > Message::MaxPayloadSize) {
+    return std::nullopt;
+  }
+
+  const bool compressed = (uint8_t) header.type & Message::CompressedFlag;
+  if (compressed) {
+    header.type = Type((uint8_t) header.type & ~Message::CompressedFlag);
+
+    // Only messages with variable-size payload may grow large
+    bool has_valid_type =
+      header.type == Type::NewComment ||
+      header.type == Type::NewCommentsBatch ||
+      header.type == Type::CommentsResponse ||
+      header.type == Type::IndexedCommentsResponse ||
+      header.type == Type::AnnotatedCommentsResponse ||
+      header.type == Type::CommentsPush ||
+      header.type == Type::ReplicatedComments ||
+      header.type == Type::SearchResults;
+    if (!has_valid_type || payload_size < sizeof(uint32_t)) {
+      return std::nullopt;
+    }
+
+    size_t full_size = sizeof(MessageHeader) + payload_size;
+    message_size = full_size;
+    if (bytes.size() < full_size) {
+      return std::nullopt;
+    }
+
+    return MessageView(header.type, bytes.first(full_size), true);
+  }
+
+  if (payload_size == 0) {
+    bool has_valid_type =
+      header.type == Type::Hello ||
+      header.type == Type::Goodbye ||
+      header.type == Type::CommentOk ||
+      header.type == Type::GetStats;
+    if (!has_valid_type) {
+      return std::nullopt;
+    }
+
+    message_size = sizeof(MessageHeader);
+    return MessageView(header.type, bytes.first(sizeof(MessageHeader)));
+  }
+
+  if (header.type == Type::Hello) {
+    if (
+      payload_size != sizeof(Message::HelloPayload) &&
+      payload_size != Message::LegacyHelloSize
+    ) {
+      return std::nullopt;
+    }
+  } else if (header.type == Type::CommentsRequest) {
+    if (
+      payload_size != sizeof(Message::CommentsRequestPayload) &&
+      payload_size != Message::PlainCommentsRequestSize &&
+      payload_size != Message::LegacyCommentsRequestSize
+    ) {
+      return std::nullopt;
+    }
+  } else if (header.type == Type::CommentsSinceRequest) {
+    if (payload_size != sizeof(Message::CommentsSincePayload)) {
+      return std::nullopt;
+    }
+  } else if (
+    header.type == Type::Subscribe ||
+    header.type == Type::Replicate
+  ) {
+    if (payload_size != sizeof(Message::SubscribePayload)) {
+      return std::nullopt;
+    }
+  } else if (
+    header.type == Type::CommentsResponse ||
+    header.type == Type::IndexedCommentsResponse ||
+    header.type == Type::AnnotatedCommentsResponse ||
+    header.type == Type::CommentsPush ||
+    header.type == Type::ReplicatedComments
+  ) {
+    if (payload_size < sizeof(Message::CommentsResponsePayload)) {
+      return std::nullopt;
+    }
+  } else if (header.type == Type::SearchComments) {
+    if (payload_size < sizeof(Message::SearchRequestPayload)) {
+      return std::nullopt;
+    }
+  } else if (header.type == Type::SearchResults) {
+    if (payload_size < sizeof(Message::SearchResultsPayload)) {
+      return std::nullopt;
+    }
+  } else if (header.type == Type::CommentsBatchOk) {
+    if (payload_size != sizeof(Message::CommentsBatchOkPayload)) {
+      return std::nullopt;
+    }
+  } else if (
+    header.type != Type::NewComment &&
+    header.type != Type::NewCommentsBatch &&
+    header.type != Type::Stats
+  ) {
+    return std::nullopt;
+  }
+
+  size_t full_size = sizeof(MessageHeader) + payload_size;
+  message_size = full_size;
+  if (bytes.size() < full_size) {
+    return std::nullopt;
+  }
+
+  // Comments are only counted once batch is complete
+  if (header.type == Type::NewCommentsBatch) {
+    const auto payload = bytes.subspan(sizeof(MessageHeader), payload_size);
+    if ((size_t) std::ranges::count(payload, std::byte{'\0'}) >
+        Message::MaxBatchCount) {
+      message_size = 0;
+      return std::nullopt;
+    }
+  }
+
+  return MessageView(header.type, bytes.first(full_size));
+}
+
+} // namespace message
@@ -0,0 +1,110 @@
+/**
+ * @file MessageView.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Non-owning view of serialized message
+ *
+ * View is validated in place and points straight into the buffer it was
+ * parsed from, so it is only valid while that buffer is not modified.
+ *
+ * @version 0.0.1
+ * @date 2024-11-13
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_MESSAGE_VIEW_HPP
+#define __MESSAGE_MESSAGE_VIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <netinet/in.h>
+#include <optional>
+#include <span>
+
+#include "Message/Message.hpp"
+
+namespace message {
+
+class MessageView final {
+  friend class Message;
+
+public:
+  using Type = Message::Type;
+
+  /**
+   * @brief Validate message at the beginning of `bytes` without copying it.
+   *
+   * Bytes after the end of the first message are ignored, so a buffer of
+   * several messages is parsed by advancing it by `message_size`.
+   *
+   * @param[in]  bytes          Serialized message
+   * @param[out] message_size   Size of full message, set once header is
+   *                            valid, even if `bytes` holds only part of it.
+   *                            Zero if message is invalid, callers pass
+   *                            zero
+   *
+   * @return View of message, or `std::nullopt` if message is invalid or
+   * incomplete
+   */
+  static std::optional<MessageView> fromBytes(
+      std::span<const std::byte> bytes,
+      size_t& message_size
+  );
+
+  Type getType(void) const noexcept { return m_type; }
+
+  /**
+   * @brief Payload is compressed and must be restored with
+   * `Compression::decompressFrame()` before use. Type of such view is already the type
+   * of uncompressed message
+   */
+  bool isCompressed(void) const noexcept { return m_compressed; }
+
+  /**
+   * @brief Full serialized message, including header
+   */
+  std::span<const std::byte> getBytes(void) const noexcept { return m_bytes; }
+
+  std::span<const std::byte> getPayload(void) const noexcept {
+    return m_bytes.subspan(Message::MinSize);
+  }
+
+  /**
+   * @brief Read network-order integer at given payload offset.
+   *
+   * Payload in receive buffer is not necessarily aligned, so fields are
+   * never accessed through payload struct pointers.
+   */
+  uint32_t getUint32(size_t payload_offset) const noexcept {
+    uint32_t value = 0;
+    std::memcpy(&value, getPayload().data() + payload_offset, sizeof(value));
+    return ntohl(value);
+  }
+
+  /**
+   * @brief Read big-endian 64-bit integer at given payload offset
+   */
+  uint64_t getUint64(size_t payload_offset) const noexcept {
+    uint64_t value = 0;
+    std::memcpy(&value, getPayload().data() + payload_offset, sizeof(value));
+    return be64toh(value);
+  }
+
+private:
+  MessageView(
+      Type type,
+      std::span<const std::byte> bytes,
+      bool compressed = false
+  ) : m_type(type), m_bytes(bytes), m_compressed(compressed) {
+  }
+
+  Type m_type;
+  std::span<const std::byte> m_bytes;
+  bool m_compressed;
+};
+
+} // namespace message
+
+#endif /* MessageView.hpp */
@@ -12,11 +12,11 @@
 #ifndef __MESSAGE_NEW_COMMENT_MESSAGE_HPP
 #define __MESSAGE_NEW_COMMENT_MESSAGE_HPP
 
-#include <netinet/in.h>
 #include <optional>
 #include <span>
 
 #include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
 
 namespace message {
 
@@ -29,6 +29,16 @@ public:
     return std::nullopt;
   }
 
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<NewCommentMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::NewComment) {
+      return NewCommentMessage(view);
+    }
+    return std::nullopt;
+  }
+
   // Non-Copyable
   NewCommentMessage(const NewCommentMessage&) = delete;
   NewCommentMessage& operator=(const NewCommentMessage&) = delete;
@@ -38,19 +48,23 @@ public:
   NewCommentMessage& operator=(NewCommentMessage&&) noexcept = default;
 
   std::span<const char> getComment(void) const {
-    const char* payload = 
-      reinterpret_cast<const char*> (
-          m_message.m_payload->payload
-      );
-    size_t size = ntohl(m_message.m_header.payload_size);
-    return std::span(payload, size);
+    auto payload = m_view.getPayload();
+    return std::span(
+        reinterpret_cast<const char*>(payload.data()),
+        payload.size()
+    );
   }
 private:
   explicit NewCommentMessage(Message&& message)
-    : m_message(std::move(message)) {
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit NewCommentMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
   }
 
-  Message m_message;
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
 };
 
 } // namespace message
@@ -0,0 +1,32 @@
+#include "NewCommentsBatchMessage.hpp"
+#include "Message/Message.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace message {
+
+NewCommentsBatchMessage::NewCommentsBatchMessage(
+    std::optional<Message>&& message,
+    MessageView view
+) : m_message(std::move(message)), m_view(view), m_comments(0) {
+  auto payload = m_view.getPayload();
+
+  const char* chars = reinterpret_cast<const char*>(payload.data());
+  const char* end = chars + payload.size();
+
+  m_comments.reserve((size_t) std::count(chars, end, '\0'));
+
+  // Payload is known to end with NUL, so every search succeeds
+  while (chars < end) {
+    const char* terminator = static_cast<const char*>(
+        std::memchr(chars, '\0', (size_t) (end - chars))
+    );
+    m_comments.emplace_back(chars, (size_t) (terminator - chars));
+    chars = terminator + 1;
+  }
+}
+
+NewCommentsBatchMessage::~NewCommentsBatchMessage() = default;
+
+} // namespace message
@@ -0,0 +1,96 @@
+/**
+ * @file NewCommentsBatchMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Several comments sent by client in a single message
+ *
+ * @version 0.0.1
+ * @date 2024-11-10
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_NEW_COMMENTS_BATCH_MESSAGE_HPP
+#define __MESSAGE_NEW_COMMENTS_BATCH_MESSAGE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class NewCommentsBatchMessage final {
+public:
+  /**
+   * @return Batch message, or `std::nullopt` if message is not a batch or
+   * its last comment is not NUL-terminated
+   */
+  static std::optional<NewCommentsBatchMessage> fromMessage(
+      Message&& message
+  ) {
+    if (message.getType() != Message::Type::NewCommentsBatch) {
+      return std::nullopt;
+    }
+
+    MessageView view = message.view();
+    if (!isTerminated(view)) {
+      return std::nullopt;
+    }
+    return NewCommentsBatchMessage(std::move(message), view);
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<NewCommentsBatchMessage> fromView(MessageView view) {
+    if (view.getType() != Message::Type::NewCommentsBatch) {
+      return std::nullopt;
+    }
+
+    if (!isTerminated(view)) {
+      return std::nullopt;
+    }
+    return NewCommentsBatchMessage(std::nullopt, view);
+  }
+
+  // Non-Copyable
+  NewCommentsBatchMessage(const NewCommentsBatchMessage&) = delete;
+  NewCommentsBatchMessage& operator=(const NewCommentsBatchMessage&) = delete;
+
+  // Movable
+  NewCommentsBatchMessage(NewCommentsBatchMessage&&) noexcept = default;
+  NewCommentsBatchMessage& operator=(NewCommentsBatchMessage&&) noexcept
+    = default;
+
+  ~NewCommentsBatchMessage();
+
+  size_t getCount(void) const {
+    return m_comments.size();
+  }
+
+  /**
+   * @brief All comments of batch. Every comment is followed by NUL character
+   */
+  const std::vector<std::string_view>& getComments(void) const {
+    return m_comments;
+  }
+
+private:
+  NewCommentsBatchMessage(std::optional<Message>&& message, MessageView view);
+
+  static bool isTerminated(MessageView view) {
+    auto payload = view.getPayload();
+    return !payload.empty() && payload.back() == std::byte{'\0'};
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+  std::vector<std::string_view> m_comments;
+};
+
+} // namespace message
+
+#endif /* NewCommentsBatchMessage.hpp */
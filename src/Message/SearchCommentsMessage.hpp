@@ -0,0 +1,87 @@
+/**
+ * @file SearchCommentsMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Request for comments containing given words
+ *
+ * @version 0.0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_SEARCH_COMMENTS_MESSAGE_HPP
+#define __MESSAGE_SEARCH_COMMENTS_MESSAGE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class SearchCommentsMessage final {
+public:
+  static std::optional<SearchCommentsMessage> fromMessage(Message&& message) {
+    if (message.getType() == Message::Type::SearchComments) {
+      return SearchCommentsMessage(std::move(message));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<SearchCommentsMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::SearchComments) {
+      return SearchCommentsMessage(view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  SearchCommentsMessage(const SearchCommentsMessage&) = delete;
+  SearchCommentsMessage& operator=(const SearchCommentsMessage&) = delete;
+
+  // Movable
+  SearchCommentsMessage(SearchCommentsMessage&&) noexcept = default;
+  SearchCommentsMessage& operator=(SearchCommentsMessage&&) noexcept = default;
+
+  size_t getStartIndex(void) const {
+    return m_view.getUint32(offsetof(Payload, start_index));
+  }
+
+  /**
+   * @brief Maximum number of comments to send, zero if not limited
+   */
+  size_t getMaxCount(void) const {
+    return m_view.getUint32(offsetof(Payload, max_count));
+  }
+
+  std::string_view getQuery(void) const {
+    auto query = m_view.getPayload().subspan(offsetof(Payload, query));
+    return std::string_view(
+        reinterpret_cast<const char*>(query.data()),
+        query.size()
+    );
+  }
+
+private:
+  using Payload = Message::SearchRequestPayload;
+
+  explicit SearchCommentsMessage(Message&& message)
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit SearchCommentsMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+};
+
+} // namespace message
+
+#endif /* SearchCommentsMessage.hpp */
@@ -0,0 +1,29 @@
+#include "SearchResultsMessage.hpp"
+#include "Message/CommentSplitter.hpp"
+
+namespace message {
+
+SearchResultsMessage::SearchResultsMessage(
+    std::optional<Message>&& message,
+    MessageView view
+) : m_message(std::move(message)), m_view(view), m_comments(0) {
+  auto payload = m_view.getPayload();
+  const size_t count = getSentCount(m_view);
+  const size_t comments_begin =
+    offsetof(Payload, results) + count * sizeof(uint32_t);
+
+  const char* chars =
+    reinterpret_cast<const char*>(payload.data() + comments_begin);
+  split_comments(
+      std::span(chars, payload.size() - comments_begin), m_comments
+  );
+
+  // Comments without index are ignored
+  if (m_comments.size() > count) {
+    m_comments.resize(count);
+  }
+}
+
+SearchResultsMessage::~SearchResultsMessage() = default;
+
+} // namespace message
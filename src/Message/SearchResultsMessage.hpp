@@ -0,0 +1,114 @@
+/**
+ * @file SearchResultsMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Page of comments found by SearchComments
+ *
+ * @version 0.0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_SEARCH_RESULTS_MESSAGE_HPP
+#define __MESSAGE_SEARCH_RESULTS_MESSAGE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+/**
+ * @brief Received search results, split into comments on construction
+ */
+class SearchResultsMessage final {
+public:
+  /**
+   * @return Results, or `std::nullopt` if message is not SearchResults or
+   * its index table does not fit into payload
+   */
+  static std::optional<SearchResultsMessage> fromMessage(Message&& message) {
+    MessageView view = message.view();
+    if (isValid(view)) {
+      return SearchResultsMessage(std::move(message), view);
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<SearchResultsMessage> fromView(MessageView view) {
+    if (isValid(view)) {
+      return SearchResultsMessage(std::nullopt, view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  SearchResultsMessage(const SearchResultsMessage&) = delete;
+  SearchResultsMessage& operator=(const SearchResultsMessage&) = delete;
+
+  // Movable
+  SearchResultsMessage(SearchResultsMessage&&) noexcept = default;
+  SearchResultsMessage& operator=(SearchResultsMessage&&) noexcept = default;
+
+  ~SearchResultsMessage();
+
+  /**
+   * @brief Number of comments in page. Comments missing from malformed
+   * message are not counted
+   */
+  size_t getCount(void) const { return m_comments.size(); }
+
+  /**
+   * @brief Start index for requesting next page of results
+   */
+  size_t getNextIndex(void) const {
+    return m_view.getUint32(offsetof(Payload, next_index));
+  }
+
+  /**
+   * @brief Index of `result`-th comment of page in store
+   */
+  size_t getCommentIndex(size_t result) const {
+    return m_view.getUint32(
+        offsetof(Payload, results) + result * sizeof(uint32_t)
+    );
+  }
+
+  std::span<const char> operator[](size_t result) const {
+    return m_comments[result];
+  }
+
+private:
+  using Payload = Message::SearchResultsPayload;
+
+  SearchResultsMessage(std::optional<Message>&& message, MessageView view);
+
+  static size_t getSentCount(MessageView view) {
+    return view.getUint32(offsetof(Payload, sent_comments));
+  }
+
+  static bool isValid(MessageView view) {
+    if (view.getType() != Message::Type::SearchResults) {
+      return false;
+    }
+
+    const size_t table_end =
+      offsetof(Payload, results) + getSentCount(view) * sizeof(uint32_t);
+    return table_end <= view.getPayload().size();
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+  std::vector<std::span<const char>> m_comments;
+};
+
+} // namespace message
+
+#endif /* SearchResultsMessage.hpp */
@@ -1,32 +1,61 @@
 #include "SendCommentsMessage.hpp"
+#include "Message/CommentSplitter.hpp"
 #include "Message/Message.hpp"
-#include <netinet/in.h>
+#include <cassert>
+#include <cstddef>
 
 namespace message {
 
-SendCommentsMessage::SendCommentsMessage(Message&& message)
-  : m_message(std::move(message)), m_comments(0) {
-  const auto* payload = 
-    reinterpret_cast<const Message::CommentsResponsePayload*> (
-        m_message.m_payload->payload
-    );
-
-  size_t size = ntohl(m_message.m_header.payload_size) 
-                - sizeof(Message::CommentsResponsePayload);
-  const char* chars = payload->comments;
-
-  size_t offset = 0;
-  size_t length = 0;
-
-  while (offset + length < size) {
-    if (chars[offset + length] == '\0') {
-      m_comments.push_back(std::span(chars+offset, length));
-      offset += length + 1;
-      length = 0;
-    }
-    ++length;
+SendCommentsMessage::SendCommentsMessage(
+    std::optional<Message>&& message,
+    MessageView view
+) : m_message(std::move(message)), m_view(view), m_comments(0) {
+  if (hasTable()) {
+    return;
   }
+
+  auto payload = m_view.getPayload();
+
+  const char* chars =
+    reinterpret_cast<const char*>(payload.data() + offsetof(Payload, comments));
+  size_t size = payload.size() - offsetof(Payload, comments);
+
+  split_comments(std::span(chars, size), m_comments);
 }
 
+SendCommentsMessage::~SendCommentsMessage() = default;
+
+std::span<const char> SendCommentsMessage::tableComment(size_t index) const {
+  const size_t count = getCount();
+  assert(index < count);
+
+  auto payload = m_view.getPayload();
+  const size_t entry_size = getEntrySize(m_view);
+  const size_t comments_begin =
+    offsetof(Payload, comments) + count * entry_size;
+  const size_t comments_size = payload.size() - comments_begin;
+
+  // Offset is the last field of both index and metadata entries
+  const size_t table =
+    offsetof(Payload, comments) + entry_size - sizeof(uint32_t);
+  static_assert(
+      offsetof(Message::CommentMetadata, offset) + sizeof(uint32_t)
+      == sizeof(Message::CommentMetadata)
+  );
+
+  // Comment ends with NUL right before the next comment or payload end
+  size_t begin = m_view.getUint32(table + index * entry_size);
+  size_t end = index + 1 < count
+    ? m_view.getUint32(table + (index + 1) * entry_size)
+    : comments_size;
+
+  if (begin >= end || end > comments_size) {
+    return {};
+  }
+
+  const char* chars =
+    reinterpret_cast<const char*>(payload.data() + comments_begin);
+  return std::span(chars + begin, end - begin - 1);
+}
 
 } // namespace message
@@ -13,17 +13,42 @@
 #define __MESSAGE_SEND_COMMENTS_MESSAGE_HPP
 
 #include "Message/Message.hpp"
-#include <netinet/in.h>
+#include "Message/MessageView.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <vector>
 
 namespace message {
 
+/**
+ * @brief Received page of comments, either response or push.
+ *
+ * Plain response is split into comments on construction. Indexed and
+ * annotated responses are not scanned at all: every comment is located
+ * through table preceding comments when accessed.
+ */
 class SendCommentsMessage final {
 public:
+  /**
+   * @return Response, or `std::nullopt` if message is not a response or its
+   * table does not fit into payload
+   */
   static std::optional<SendCommentsMessage> fromMessage(Message&& message) {
-    if (message.getType() == Message::Type::CommentsRequest) {
-      return SendCommentsMessage(std::move(message));
+    MessageView view = message.view();
+    if (isValid(view)) {
+      return SendCommentsMessage(std::move(message), view);
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<SendCommentsMessage> fromView(MessageView view) {
+    if (isValid(view)) {
+      return SendCommentsMessage(std::nullopt, view);
     }
     return std::nullopt;
   }
@@ -36,26 +61,120 @@ public:
   SendCommentsMessage(SendCommentsMessage&&) noexcept = default;
   SendCommentsMessage& operator=(SendCommentsMessage&&) noexcept = default;
 
+  ~SendCommentsMessage();
+
   size_t getCount(void) const {
-    return m_comments.size();
+    return hasTable() ? getSentCount(m_view) : m_comments.size();
   }
 
   size_t getTotal(void) const {
-    const auto* payload = 
-      reinterpret_cast<const Message::CommentsResponsePayload*> (
-          m_message.m_payload->payload
-      );
-    return ntohl(payload->total_comments);
+    return m_view.getUint32(offsetof(Payload, total_comments));
+  }
+
+  /**
+   * @brief Start index for requesting next page of comments
+   */
+  size_t getNextIndex(void) const {
+    return m_view.getUint32(offsetof(Payload, next_index));
+  }
+
+  /**
+   * @brief Page was pushed to subscriber or follower rather than requested
+   */
+  bool isPush(void) const {
+    return m_view.getType() == Message::Type::CommentsPush ||
+           m_view.getType() == Message::Type::ReplicatedComments;
+  }
+
+  /**
+   * @brief Response is annotated and carries metadata of every comment
+   */
+  bool hasMetadata(void) const {
+    return m_view.getType() == Message::Type::AnnotatedCommentsResponse ||
+           m_view.getType() == Message::Type::ReplicatedComments;
+  }
+
+  /**
+   * @brief Time comment at given index in page was stored at, in
+   * microseconds since Unix epoch. Response must have metadata
+   */
+  uint64_t getTimestamp(size_t index) const {
+    return m_view.getUint64(metadataOffset(index)
+        + offsetof(Message::CommentMetadata, timestamp));
+  }
+
+  /**
+   * @brief Author of comment at given index in page, zero if anonymous.
+   * Response must have metadata
+   */
+  uint32_t getAuthor(size_t index) const {
+    return m_view.getUint32(metadataOffset(index)
+        + offsetof(Message::CommentMetadata, author));
   }
 
+  /**
+   * @brief Comment at given index in page. Comment of indexed or annotated
+   * response with malformed offsets is empty
+   */
   std::span<const char> operator[](size_t index) const {
-    return m_comments[index];
+    return hasTable() ? tableComment(index) : m_comments[index];
   }
 
 private:
-  explicit SendCommentsMessage(Message&& message);
+  using Payload = Message::CommentsResponsePayload;
+
+  SendCommentsMessage(std::optional<Message>&& message, MessageView view);
+
+  static size_t getSentCount(MessageView view) {
+    return view.getUint32(offsetof(Payload, sent_comments));
+  }
+
+  /**
+   * @brief Size of table entry of every comment, zero for plain layout
+   */
+  static size_t getEntrySize(MessageView view) {
+    if (view.getType() == Message::Type::IndexedCommentsResponse) {
+      return sizeof(uint32_t);
+    }
+    if (
+      view.getType() == Message::Type::AnnotatedCommentsResponse ||
+      view.getType() == Message::Type::ReplicatedComments
+    ) {
+      return sizeof(Message::CommentMetadata);
+    }
+    return 0;
+  }
+
+  static bool isValid(MessageView view) {
+    if (view.getType() == Message::Type::CommentsResponse ||
+        view.getType() == Message::Type::CommentsPush) {
+      return true;
+    }
+    if (view.getType() != Message::Type::IndexedCommentsResponse &&
+        view.getType() != Message::Type::AnnotatedCommentsResponse &&
+        view.getType() != Message::Type::ReplicatedComments) {
+      return false;
+    }
+
+    const size_t table_end =
+      offsetof(Payload, comments) + getSentCount(view) * getEntrySize(view);
+    return table_end <= view.getPayload().size();
+  }
+
+  bool hasTable(void) const {
+    return getEntrySize(m_view) != 0;
+  }
+
+  size_t metadataOffset(size_t index) const {
+    assert(hasMetadata() && index < getCount());
+    return offsetof(Payload, comments)
+      + index * sizeof(Message::CommentMetadata);
+  }
+
+  std::span<const char> tableComment(size_t index) const;
 
-  Message m_message;
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
   std::vector<std::span<const char>> m_comments;
 };
 
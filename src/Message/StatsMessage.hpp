@@ -0,0 +1,72 @@
+/**
+ * @file StatsMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Server metrics in Prometheus text format, answer to GetStats
+ *
+ * @version 0.0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_STATS_MESSAGE_HPP
+#define __MESSAGE_STATS_MESSAGE_HPP
+
+#include <optional>
+#include <string_view>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class StatsMessage final {
+public:
+  static std::optional<StatsMessage> fromMessage(Message&& message) {
+    if (message.getType() == Message::Type::Stats) {
+      return StatsMessage(std::move(message));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<StatsMessage> fromView(MessageView view) {
+    if (view.getType() == Message::Type::Stats) {
+      return StatsMessage(view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  StatsMessage(const StatsMessage&) = delete;
+  StatsMessage& operator=(const StatsMessage&) = delete;
+
+  // Movable
+  StatsMessage(StatsMessage&&) noexcept = default;
+  StatsMessage& operator=(StatsMessage&&) noexcept = default;
+
+  std::string_view getText(void) const {
+    auto payload = m_view.getPayload();
+    return std::string_view(
+        reinterpret_cast<const char*>(payload.data()),
+        payload.size()
+    );
+  }
+private:
+  explicit StatsMessage(Message&& message)
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit StatsMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+};
+
+} // namespace message
+
+#endif /* StatsMessage.hpp */
@@ -0,0 +1,87 @@
+/**
+ * @file SubscribeMessage.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Request to push new comments as they are stored, either to
+ * client or to follower server
+ *
+ * @version 0.0.1
+ * @date 2024-11-15
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __MESSAGE_SUBSCRIBE_MESSAGE_HPP
+#define __MESSAGE_SUBSCRIBE_MESSAGE_HPP
+
+#include <cstddef>
+#include <optional>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+namespace message {
+
+class SubscribeMessage final {
+public:
+  static std::optional<SubscribeMessage> fromMessage(Message&& message) {
+    if (isValid(message.getType())) {
+      return SubscribeMessage(std::move(message));
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Wrap message view, viewed bytes must outlive the result
+   */
+  static std::optional<SubscribeMessage> fromView(MessageView view) {
+    if (isValid(view.getType())) {
+      return SubscribeMessage(view);
+    }
+    return std::nullopt;
+  }
+
+  // Non-Copyable
+  SubscribeMessage(const SubscribeMessage&) = delete;
+  SubscribeMessage& operator=(const SubscribeMessage&) = delete;
+
+  // Movable
+  SubscribeMessage(SubscribeMessage&&) noexcept = default;
+  SubscribeMessage& operator=(SubscribeMessage&&) noexcept = default;
+
+  /**
+   * @brief Index of the first comment to push
+   */
+  size_t getStartIndex(void) const {
+    return m_view.getUint32(offsetof(Payload, start_index));
+  }
+
+  /**
+   * @brief Subscriber is a follower, see `Message::replicate()`
+   */
+  bool isReplication(void) const {
+    return m_view.getType() == Message::Type::Replicate;
+  }
+
+private:
+  using Payload = Message::SubscribePayload;
+
+  static bool isValid(Message::Type type) {
+    return type == Message::Type::Subscribe ||
+           type == Message::Type::Replicate;
+  }
+
+  explicit SubscribeMessage(Message&& message)
+    : m_message(std::move(message)), m_view(m_message->view()) {
+  }
+
+  explicit SubscribeMessage(MessageView view)
+    : m_message(std::nullopt), m_view(view) {
+  }
+
+  std::optional<Message> m_message;  // Owner of viewed bytes, if any
+  MessageView m_view;
+};
+
+} // namespace message
+
+#endif /* SubscribeMessage.hpp */
@@ -0,0 +1,42 @@
+#include "Histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace metrics {
+
+void Histogram::addTo(Snapshot& snapshot) const noexcept {
+  // Count is read first, so that snapshot never has more values counted
+  // than its buckets hold, when value is recorded meanwhile
+  snapshot.m_count += m_count.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < BucketCount; ++i) {
+    snapshot.m_buckets[i] += m_buckets[i].load(std::memory_order_relaxed);
+  }
+  snapshot.m_sum += m_sum.load(std::memory_order_relaxed);
+  snapshot.m_max =
+    std::max(snapshot.m_max, m_max.load(std::memory_order_relaxed));
+}
+
+uint64_t Histogram::Snapshot::percentile(double percent) const noexcept {
+  if (m_count == 0) {
+    return 0;
+  }
+
+  percent = std::clamp(percent, 0.0, 100.0);
+  uint64_t rank = (uint64_t) std::ceil(percent / 100 * (double) m_count);
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BucketCount; ++i) {
+    seen += m_buckets[i];
+    if (seen >= rank) {
+      // Upper bound of bucket, but never above actually recorded maximum
+      uint64_t upper = i + 1 < BucketCount ? lowerBound(i + 1) - 1 : m_max;
+      return std::min(upper, m_max);
+    }
+  }
+
+  return m_max;
+}
+
+} // namespace metrics
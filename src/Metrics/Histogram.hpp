@@ -0,0 +1,126 @@
+/**
+ * @file Histogram.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Log-linear histogram written by one thread and read by any
+ *
+ * Buckets have the same layout as `client::LatencyHistogram`, so values
+ * are reported within ~3% at any magnitude. Only the owning thread
+ * records, so buckets are updated with plain relaxed stores instead of
+ * atomic read-modify-write, while other threads take consistent enough
+ * snapshots at any time.
+ *
+ * @version 0.0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __METRICS_HISTOGRAM_HPP
+#define __METRICS_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace metrics {
+
+class Histogram final {
+private:
+  static constexpr size_t SubBucketBits = 5;
+  static constexpr size_t SubBuckets = size_t(1) << SubBucketBits;
+  static constexpr size_t BucketCount = 64 * SubBuckets;
+
+public:
+  /**
+   * @brief Plain copy of histogram, possibly merged from several ones
+   */
+  class Snapshot final {
+    friend class Histogram;
+
+  public:
+    Snapshot() = default;
+
+    uint64_t count(void) const noexcept { return m_count; }
+
+    uint64_t sum(void) const noexcept { return m_sum; }
+
+    uint64_t max(void) const noexcept { return m_max; }
+
+    /**
+     * @brief Smallest recorded value which is not less than `percent`% of
+     * recorded values, rounded up to bucket bound
+     *
+     * @param[in] percent   Percentile in range [0, 100]
+     */
+    uint64_t percentile(double percent) const noexcept;
+
+  private:
+    std::array<uint64_t, BucketCount> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+  };
+
+  Histogram() = default;
+
+  // Non-Copyable
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  // Non-Movable
+  Histogram(Histogram&&) = delete;
+  Histogram& operator=(Histogram&&) = delete;
+
+  /**
+   * @brief Record value. Must only be called by the owning thread
+   */
+  void record(uint64_t value) noexcept {
+    increment(m_buckets[bucketOf(value)], 1);
+    increment(m_count, 1);
+    increment(m_sum, value);
+    if (value > m_max.load(std::memory_order_relaxed)) {
+      m_max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Add all values recorded so far to `snapshot`
+   */
+  void addTo(Snapshot& snapshot) const noexcept;
+
+private:
+  static void increment(std::atomic<uint64_t>& value, uint64_t by) noexcept {
+    value.store(value.load(std::memory_order_relaxed) + by,
+                std::memory_order_relaxed);
+  }
+
+  static size_t bucketOf(uint64_t value) noexcept {
+    if (value < SubBuckets) {
+      return value;
+    }
+
+    // Keep SubBucketBits + 1 leading bits of value
+    const size_t shift = std::bit_width(value) - SubBucketBits - 1;
+    return (shift + 1) * SubBuckets + ((value >> shift) - SubBuckets);
+  }
+
+  static uint64_t lowerBound(size_t bucket) noexcept {
+    if (bucket < SubBuckets) {
+      return bucket;
+    }
+
+    const size_t shift = bucket / SubBuckets - 1;
+    return (uint64_t) (bucket % SubBuckets + SubBuckets) << shift;
+  }
+
+  std::array<std::atomic<uint64_t>, BucketCount> m_buckets{};
+  std::atomic<uint64_t> m_count = 0;
+  std::atomic<uint64_t> m_sum = 0;
+  std::atomic<uint64_t> m_max = 0;
+};
+
+} // namespace metrics
+
+#endif /* Histogram.hpp */
@@ -0,0 +1,250 @@
+#include "Metrics.hpp"
+#include "Metrics/Histogram.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace metrics {
+
+using Type = message::Message::Type;
+
+static constexpr const char* Prefix = "comment_server_";
+
+struct CounterInfo {
+  const char* name;
+  const char* help;
+};
+
+static constexpr CounterInfo Counters[] = {
+  { "accepted_connections_total", "Connections accepted" },
+  { "closed_connections_total", "Connections closed" },
+  { "malformed_frames_total", "Frames which failed to parse" },
+  { "response_bytes_total", "Bytes written to clients" },
+  { "stored_comments_total", "Comments appended to store" },
+  { "response_cache_hits_total", "Comment pages sent from response cache" },
+  { "response_cache_misses_total", "Comment pages built from store" },
+  { "rejected_writes_total", "Write requests refused after log failure" },
+};
+static constexpr size_t CounterCount = std::size(Counters);
+static_assert(CounterCount == size_t(Counter::RejectedWrites) + 1);
+
+struct DistributionInfo {
+  const char* name;
+  const char* help;
+  double scale;  // Reported unit per recorded unit
+};
+
+static constexpr DistributionInfo Distributions[] = {
+  { "append_latency_seconds", "Time to store comment or batch, sampled",
+    1e-9 },
+  { "output_queue_bytes", "Pending output of connection on flush", 1 },
+};
+static constexpr size_t DistributionCount = std::size(Distributions);
+static_assert(DistributionCount == size_t(Distribution::OutputQueueBytes) + 1);
+
+static constexpr double Quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+// Type byte of valid frame never has `CompressedFlag` set
+static constexpr size_t FrameTypeCount = message::Message::CompressedFlag;
+
+namespace {
+
+/**
+ * @brief Metrics of one thread. Only the owner writes, so updates are
+ * relaxed stores rather than atomic increments
+ */
+struct alignas(64) Shard {
+  std::array<std::atomic<uint64_t>, CounterCount> counters{};
+  std::array<std::atomic<uint64_t>, FrameTypeCount> frames{};
+  std::array<Histogram, DistributionCount> distributions{};
+};
+
+struct Registry {
+  std::mutex mutex{};
+  std::vector<std::unique_ptr<Shard>> shards{};
+};
+
+} // anonymous namespace
+
+static Registry& registry(void) {
+  // Never destroyed, so that threads outliving static destruction still
+  // find their shards
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+static thread_local Shard* s_shard = nullptr;
+
+static Shard& shard(void) {
+  if (s_shard == nullptr) [[unlikely]] {
+    Registry& shards = registry();
+    std::lock_guard lock(shards.mutex);
+    shards.shards.push_back(std::make_unique<Shard>());
+    s_shard = shards.shards.back().get();
+  }
+  return *s_shard;
+}
+
+static void increment(std::atomic<uint64_t>& value, uint64_t by) noexcept {
+  value.store(value.load(std::memory_order_relaxed) + by,
+              std::memory_order_relaxed);
+}
+
+void Metrics::add(Counter counter, uint64_t value) {
+  increment(shard().counters[size_t(counter)], value);
+}
+
+void Metrics::countFrame(Type type) {
+  increment(shard().frames[size_t(type) % FrameTypeCount], 1);
+}
+
+void Metrics::record(Distribution distribution, uint64_t value) {
+  shard().distributions[size_t(distribution)].record(value);
+}
+
+static thread_local uint32_t s_timers = 0;
+
+SampledTimer::SampledTimer(Distribution distribution)
+  : m_distribution(distribution),
+    m_sampled(++s_timers % Interval == 0),
+    m_start(m_sampled ? Clock::now() : Clock::time_point()) {
+}
+
+SampledTimer::~SampledTimer() {
+  if (m_sampled) {
+    const auto elapsed = Clock::now() - m_start;
+    Metrics::record(
+        m_distribution,
+        (uint64_t) std::chrono::nanoseconds(elapsed).count()
+    );
+  }
+}
+
+static const char* frame_type_name(Type type) {
+  switch (type) {
+  case Type::Hello:                   return "Hello";
+  case Type::Goodbye:                 return "Goodbye";
+  case Type::NewComment:              return "NewComment";
+  case Type::CommentsRequest:         return "CommentsRequest";
+  case Type::CommentOk:               return "CommentOk";
+  case Type::CommentsResponse:        return "CommentsResponse";
+  case Type::NewCommentsBatch:        return "NewCommentsBatch";
+  case Type::CommentsBatchOk:         return "CommentsBatchOk";
+  case Type::IndexedCommentsResponse: return "IndexedCommentsResponse";
+  case Type::Subscribe:               return "Subscribe";
+  case Type::CommentsPush:            return "CommentsPush";
+  case Type::GetStats:                return "GetStats";
+  case Type::Stats:                   return "Stats";
+  case Type::SearchComments:          return "SearchComments";
+  case Type::SearchResults:           return "SearchResults";
+  case Type::CommentsSinceRequest:    return "CommentsSinceRequest";
+  case Type::AnnotatedCommentsResponse:
+    return "AnnotatedCommentsResponse";
+  case Type::Replicate:               return "Replicate";
+  case Type::ReplicatedComments:      return "ReplicatedComments";
+  default:                            return nullptr;
+  }
+}
+
+__attribute__((format(printf, 2, 3)))
+static void append(std::string& text, const char* format, ...) {
+  char line[256] = "";
+
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  if (length > 0) {
+    text.append(line, std::min((size_t) length, sizeof(line) - 1));
+  }
+}
+
+static void append_header(
+    std::string& text,
+    const char* name,
+    const char* help,
+    const char* type
+) {
+  append(text, "# HELP %s%s %s\n", Prefix, name, help);
+  append(text, "# TYPE %s%s %s\n", Prefix, name, type);
+}
+
+std::string Metrics::format(std::span<const Gauge> gauges) {
+  std::array<uint64_t, CounterCount> counters{};
+  std::array<uint64_t, FrameTypeCount> frames{};
+  std::array<Histogram::Snapshot, DistributionCount> distributions{};
+
+  {
+    Registry& shards = registry();
+    std::lock_guard lock(shards.mutex);
+    for (const auto& shard : shards.shards) {
+      for (size_t i = 0; i < CounterCount; ++i) {
+        counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < FrameTypeCount; ++i) {
+        frames[i] += shard->frames[i].load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < DistributionCount; ++i) {
+        shard->distributions[i].addTo(distributions[i]);
+      }
+    }
+  }
+
+  std::string text;
+
+  for (size_t i = 0; i < CounterCount; ++i) {
+    append_header(text, Counters[i].name, Counters[i].help, "counter");
+    append(text, "%s%s %llu\n",
+        Prefix, Counters[i].name, (unsigned long long) counters[i]);
+  }
+
+  // Connections closed before accept counter was read are not counted yet
+  const uint64_t accepted = counters[size_t(Counter::AcceptedConnections)];
+  const uint64_t closed = counters[size_t(Counter::ClosedConnections)];
+  const uint64_t open = accepted > closed ? accepted - closed : 0;
+  append_header(text, "open_connections", "Connections being served", "gauge");
+  append(text, "%sopen_connections %llu\n",
+      Prefix, (unsigned long long) open);
+
+  append_header(text, "frames_total", "Frames received, by type", "counter");
+  for (size_t i = 0; i < FrameTypeCount; ++i) {
+    const char* name = frame_type_name(Type(i));
+    if (name != nullptr) {
+      append(text, "%sframes_total{type=\"%s\"} %llu\n",
+          Prefix, name, (unsigned long long) frames[i]);
+    }
+  }
+
+  for (size_t i = 0; i < DistributionCount; ++i) {
+    const DistributionInfo& info = Distributions[i];
+    const Histogram::Snapshot& snapshot = distributions[i];
+
+    append_header(text, info.name, info.help, "summary");
+    for (double quantile : Quantiles) {
+      append(text, "%s%s{quantile=\"%g\"} %.9g\n",
+          Prefix, info.name, quantile,
+          (double) snapshot.percentile(quantile * 100) * info.scale);
+    }
+    append(text, "%s%s_sum %.9g\n",
+        Prefix, info.name, (double) snapshot.sum() * info.scale);
+    append(text, "%s%s_count %llu\n",
+        Prefix, info.name, (unsigned long long) snapshot.count());
+  }
+
+  for (const Gauge& gauge : gauges) {
+    append_header(text, gauge.name, gauge.help, "gauge");
+    append(text, "%s%s %.9g\n", Prefix, gauge.name, gauge.value);
+  }
+
+  return text;
+}
+
+} // namespace metrics
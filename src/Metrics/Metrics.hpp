@@ -0,0 +1,107 @@
+/**
+ * @file Metrics.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Process-wide server metrics, sharded per thread
+ *
+ * Every thread updates its own shard, which it registers on first use,
+ * so recording is an uncontended store to a cache line no other thread
+ * writes. Shards of exited threads are kept, so totals never decrease.
+ * `format()` sums all shards into Prometheus text exposition format.
+ * Latencies are measured with `SampledTimer`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __METRICS_METRICS_HPP
+#define __METRICS_METRICS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "Message/Message.hpp"
+
+namespace metrics {
+
+enum class Counter {
+  AcceptedConnections,
+  ClosedConnections,
+  MalformedFrames,  // Invalid header, compressed payload or batch
+  ResponseBytes,    // Written to transports, including pushes
+  StoredComments,
+  ResponseCacheHits,    // GetComments answered with cached frame
+  ResponseCacheMisses,  // GetComments answered with frame built anew
+  RejectedWrites,       // Comments refused after log failure
+};
+
+enum class Distribution {
+  AppendLatency,    // Nanoseconds spent storing comment or batch
+  OutputQueueBytes, // Pending output of connection when it is flushed
+};
+
+/**
+ * @brief Current value of quantity owned by caller of `format()`
+ */
+struct Gauge {
+  const char* name;
+  const char* help;
+  double value;
+};
+
+class Metrics final {
+public:
+  Metrics() = delete;
+
+  static void add(Counter counter, uint64_t value = 1);
+
+  /**
+   * @brief Count received message of given type
+   */
+  static void countFrame(message::Message::Type type);
+
+  static void record(Distribution distribution, uint64_t value);
+
+  /**
+   * @brief Render metrics of all threads, followed by `gauges`
+   */
+  static std::string format(std::span<const Gauge> gauges = {});
+};
+
+/**
+ * @brief Record time from construction to destruction into distribution.
+ *
+ * Reading clock costs more than recording, so only every `Interval`-th
+ * timer of thread measures anything. Sampled times are still
+ * representative, since timed operations do not depend on each other.
+ */
+class SampledTimer final {
+public:
+  static constexpr uint32_t Interval = 16;
+
+  explicit SampledTimer(Distribution distribution);
+
+  // Non-Copyable
+  SampledTimer(const SampledTimer&) = delete;
+  SampledTimer& operator=(const SampledTimer&) = delete;
+
+  // Non-Movable
+  SampledTimer(SampledTimer&&) = delete;
+  SampledTimer& operator=(SampledTimer&&) = delete;
+
+  ~SampledTimer();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Distribution m_distribution;
+  bool m_sampled;
+  Clock::time_point m_start;
+};
+
+} // namespace metrics
+
+#endif /* Metrics.hpp */
@@ -0,0 +1,230 @@
+#include "Connection.hpp"
+#include "Message/Compression.hpp"
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+#include "Metrics/Metrics.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+
+namespace server {
+
+Connection::Connection(
+    std::unique_ptr<transport::Transport> transport,
+    const storage::CommentStore& comments
+) : m_transport(std::move(transport)),
+    m_comments(comments),
+    m_read_buffer(InitialReadBufferSize) {
+}
+
+std::optional<message::MessageView> Connection::receive(void) {
+  m_read_paused = false;
+  shrinkBuffers();
+  while (!m_disconnected && !m_closing) {
+    auto available = std::span(m_read_buffer).subspan(
+        m_read_begin, m_read_end - m_read_begin
+    );
+
+    size_t msg_size = 0;
+    auto msg = message::MessageView::fromBytes(available, msg_size);
+    if (msg.has_value()) {
+      m_read_begin += msg_size;
+      if (!msg->isCompressed()) {
+        return msg;
+      }
+
+      // Only clients which agreed on compression send compressed requests,
+      // and those are no larger than plain ones once inflated
+      if (!compresses() || msg->getUint32(0) > MaxRequestSize) {
+        metrics::Metrics::add(metrics::Counter::MalformedFrames);
+        m_disconnected = true;
+        break;
+      }
+
+      msg = message::Compression::decompressFrame(*msg, m_inflated);
+      if (!msg.has_value()) {
+        metrics::Metrics::add(metrics::Counter::MalformedFrames);
+        m_disconnected = true;
+        break;
+      }
+      return msg;
+    }
+
+    // Header is complete, but not valid, or declares larger request than
+    // clients ever send
+    const bool has_header = available.size() >= message::Message::MinSize;
+    if ((has_header && msg_size == 0) || msg_size > MaxRequestSize) {
+      metrics::Metrics::add(metrics::Counter::MalformedFrames);
+      m_disconnected = true;
+      break;
+    }
+
+    if (m_peer_closed) {
+      // Peer sent everything it wanted, reply and close
+      m_closing = true;
+      break;
+    }
+
+    // Last read did not fill the buffer, so transport is most likely empty.
+    // Wait for next readiness notification instead of trying again.
+    if (m_read_drained) {
+      m_read_drained = false;
+      break;
+    }
+
+    if (!wantsRead()) {
+      m_read_paused = !m_closing && !m_disconnected;
+      break;
+    }
+
+    readMore(std::max(msg_size, message::Message::MinSize));
+  }
+
+  return std::nullopt;
+}
+
+void Connection::readMore(size_t message_size) {
+  // Move incomplete message to buffer start if it cannot grow in place
+  if (m_read_begin == m_read_end) {
+    m_read_begin = m_read_end = 0;
+  } else if (m_read_begin + message_size > m_read_buffer.size()) {
+    std::copy(
+        m_read_buffer.begin() + m_read_begin,
+        m_read_buffer.begin() + m_read_end,
+        m_read_buffer.begin()
+    );
+    m_read_end -= m_read_begin;
+    m_read_begin = 0;
+  }
+
+  // Buffer grows with received bytes rather than with declared size, so
+  // that header alone never makes connection allocate whole frame
+  if (m_read_end == m_read_buffer.size() &&
+      m_read_buffer.size() < message_size) {
+    m_read_buffer.resize(std::min(message_size, 2 * m_read_buffer.size()));
+  }
+
+  const size_t space = m_read_buffer.size() - m_read_end;
+
+  ssize_t res = 0;
+  do {
+    errno = 0;
+    res = m_transport->read(
+        std::span(m_read_buffer).subspan(m_read_end, space)
+    );
+  } while (res < 0 && errno == EINTR);
+
+  if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    m_read_drained = true;
+    return;
+  }
+  if (res < 0) {
+    m_disconnected = true;
+    return;
+  }
+  if (res == 0) {
+    m_peer_closed = true;
+    return;
+  }
+
+  m_read_end += (size_t) res;
+  m_read_drained = (size_t) res < space;
+}
+
+void Connection::shrinkBuffers(void) {
+  if (m_inflated.capacity() > InitialReadBufferSize) {
+    m_inflated = {};
+  }
+
+  const size_t unparsed = m_read_end - m_read_begin;
+  if (m_read_buffer.size() <= InitialReadBufferSize ||
+      unparsed > InitialReadBufferSize) {
+    return;
+  }
+
+  std::vector<std::byte> buffer(InitialReadBufferSize);
+  std::copy(
+      m_read_buffer.begin() + m_read_begin,
+      m_read_buffer.begin() + m_read_end,
+      buffer.begin()
+  );
+  m_read_buffer = std::move(buffer);
+  m_read_begin = 0;
+  m_read_end = unparsed;
+}
+
+void Connection::send(const message::Message& message) {
+  m_output.append(message.getBytes());
+}
+
+void Connection::sendDurable(
+    const message::Message& message,
+    size_t durable_size
+) {
+  m_output.append(message.getBytes(), durable_size);
+}
+
+void Connection::queueFrame(std::vector<std::byte>&& frame, size_t gate) {
+  if (compresses()) {
+    std::vector<std::byte> compressed;
+    if (message::Compression::compressFrame(frame, compressed)) {
+      m_output.append(std::move(compressed), gate);
+      return;
+    }
+  }
+
+  m_output.append(std::move(frame), gate);
+}
+
+void Connection::flush(void) {
+  using FlushResult = OutputQueue::FlushResult;
+
+  m_wants_write = false;
+  m_waiting_durable = false;
+  if (m_disconnected) {
+    return;
+  }
+
+  const size_t pending = m_output.size();
+  if (pending == 0) {
+    return;
+  }
+  metrics::Metrics::record(metrics::Distribution::OutputQueueBytes, pending);
+
+  const FlushResult result =
+    m_output.flush(*m_transport, m_comments.durableSize());
+  metrics::Metrics::add(
+      metrics::Counter::ResponseBytes, pending - m_output.size()
+  );
+
+  // Requests announced while writing would get no readiness notification
+  if (m_transport->takeInputPending() && !m_closing) {
+    m_read_paused = true;
+  }
+
+  switch (result) {
+  case FlushResult::Drained:
+    break;
+  case FlushResult::WouldBlock:
+    m_wants_write = true;
+    break;
+  case FlushResult::Gated:
+    // Client must not wait for output which is never released
+    if (m_comments.isDurabilityLost()) {
+      m_disconnected = true;
+      break;
+    }
+    m_waiting_durable = true;
+    break;
+  case FlushResult::Error:
+  default:
+    m_disconnected = true;
+    break;
+  }
+}
+
+} // namespace server
@@ -0,0 +1,271 @@
+/**
+ * @file Connection.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Non-blocking client connection with read/write state machines
+ *
+ * @version 0.0.1
+ * @date 2024-11-05
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __SERVER_CONNECTION_HPP
+#define __SERVER_CONNECTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+#include "Server/OutputQueue.hpp"
+#include "Storage/CommentStore.hpp"
+#include "Transport/Transport.hpp"
+
+namespace server {
+
+class Connection final {
+public:
+  /**
+   * @brief Wrap connected transport
+   *
+   * @param[in] transport Non-blocking transport, owned by connection
+   * @param[in] comments  Store whose durability gates `sendDurable()`
+   */
+  Connection(
+      std::unique_ptr<transport::Transport> transport,
+      const storage::CommentStore& comments
+  );
+
+  // Non-Copyable
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  // Non-Movable
+  Connection(Connection&&) = delete;
+  Connection& operator=(Connection&&) = delete;
+
+  ~Connection() = default;
+
+  /**
+   * @brief Descriptor to watch with epoll
+   */
+  int getSocket(void) const noexcept { return m_transport->getFd(); }
+
+  /**
+   * @brief Epoll events to wait for while `wantsWrite()`
+   */
+  uint32_t getWriteEvents(void) const noexcept {
+    return m_transport->getWriteEvents();
+  }
+
+  /**
+   * @brief Read next complete message from transport without blocking
+   *
+   * @return View of received message in connection buffer, valid until next
+   * call to `receive()`. Returns `std::nullopt` if transport has no more data
+   * or connection is closed (see `isClosed()`)
+   */
+  std::optional<message::MessageView> receive(void);
+
+  /**
+   * @brief Queue message for sending. Message is written by next `flush()`,
+   * together with all other queued responses
+   */
+  void send(const message::Message& message);
+
+  /**
+   * @brief Queue message which may only be sent once the first
+   * `durable_size` comments of store are durable
+   */
+  void sendDurable(const message::Message& message, size_t durable_size);
+
+  /**
+   * @brief Queue copy of bytes for sending, see `sendDurable()` for `gate`
+   */
+  void queue(std::span<const std::byte> bytes, size_t gate = 0) {
+    m_output.append(bytes, gate);
+  }
+
+  /**
+   * @brief Queue complete serialized message, compressing it if
+   * compression was negotiated and pays off
+   */
+  void queueFrame(std::vector<std::byte>&& frame, size_t gate = 0);
+
+  /**
+   * @brief Queue bytes for sending without copying them.
+   *
+   * Bytes must outlive the connection or at least remain valid until sent.
+   */
+  void queueRef(std::span<const std::byte> bytes) {
+    m_output.appendRef(bytes);
+  }
+
+  /**
+   * @brief Queue complete serialized message, shared with other
+   * connections, without copying or compressing it
+   */
+  void queueShared(
+      std::shared_ptr<const std::vector<std::byte>> frame,
+      size_t gate = 0
+  ) {
+    m_output.appendShared(std::move(frame), gate);
+  }
+
+  /**
+   * @brief Capabilities agreed on in Hello handshake
+   */
+  uint32_t getCapabilities(void) const noexcept { return m_capabilities; }
+
+  void setCapabilities(uint32_t capabilities) noexcept {
+    m_capabilities = capabilities;
+  }
+
+  bool compresses(void) const noexcept {
+    return m_capabilities & message::Message::CapabilityCompression;
+  }
+
+  /**
+   * @brief Author of comments received over connection, announced in
+   * Hello. Zero if anonymous
+   */
+  uint32_t getAuthor(void) const noexcept { return m_author; }
+
+  void setAuthor(uint32_t author) noexcept { m_author = author; }
+
+  /**
+   * @brief Push comments from `start_index` on to this connection, with
+   * their metadata if connection is a follower
+   */
+  void subscribe(size_t start_index, bool replica = false) noexcept {
+    m_subscribed = true;
+    m_replica = replica;
+    m_push_index = start_index;
+  }
+
+  bool isSubscribed(void) const noexcept { return m_subscribed; }
+
+  bool isReplica(void) const noexcept { return m_replica; }
+
+  /**
+   * @brief Index of the next comment to push
+   */
+  size_t getPushIndex(void) const noexcept { return m_push_index; }
+
+  void setPushIndex(size_t index) noexcept { m_push_index = index; }
+
+  /**
+   * @brief Subscriber should be pushed comments below `store_size`.
+   *
+   * Slow subscriber is not pushed more until its pending output shrinks
+   * below `MaxPendingPush`. Comments stored meanwhile are coalesced into
+   * later pushes, and there is still room left for responses to requests.
+   */
+  bool wantsPush(size_t store_size) const noexcept {
+    return m_subscribed && m_push_index < store_size
+           && !m_closing && !m_disconnected
+           && m_output.size() < MaxPendingPush;
+  }
+
+  /**
+   * @brief Write as much of pending output as transport accepts
+   */
+  void flush(void);
+
+  bool hasPendingOutput(void) const noexcept {
+    return !m_output.empty();
+  }
+
+  /**
+   * @brief Connection accepts more requests.
+   *
+   * Client which pipelines requests without reading responses is not read
+   * from until its pending output shrinks below `MaxPendingOutput`.
+   */
+  bool wantsRead(void) const noexcept {
+    return !m_closing && !m_disconnected
+           && m_output.size() < MaxPendingOutput;
+  }
+
+  /**
+   * @brief Reading stopped because of pending output, not because transport
+   * ran out of data, or transport consumed notification of input while
+   * writing. Reading must be resumed once `wantsRead()` holds, as no
+   * readiness notification may follow.
+   */
+  bool isReadPaused(void) const noexcept { return m_read_paused; }
+
+  /**
+   * @brief Transport is full and connection waits to become writable
+   */
+  bool wantsWrite(void) const noexcept { return m_wants_write; }
+
+  /**
+   * @brief Output is held back until more comments become durable
+   */
+  bool isWaitingDurable(void) const noexcept { return m_waiting_durable; }
+
+  /**
+   * @brief Mark connection as closed once all pending output is written
+   */
+  void close(void) noexcept { m_closing = true; }
+
+  bool isClosed(void) const noexcept {
+    return m_disconnected || (m_closing && !hasPendingOutput());
+  }
+
+private:
+  static constexpr size_t InitialReadBufferSize = 16 * 1024;
+
+  // Requests carry comments, so they are far below frame size limit
+  static constexpr size_t MaxRequestSize = 16 * 1024 * 1024;
+  static constexpr size_t MaxPendingOutput = 1024 * 1024;
+  static constexpr size_t MaxPendingPush = MaxPendingOutput / 2;
+
+  /**
+   * @brief Read as much as fits into buffer, making room for at least
+   * `message_size` bytes of current message
+   */
+  void readMore(size_t message_size);
+
+  /**
+   * @brief Return buffers grown for large message to their initial size
+   * once that message was handled
+   */
+  void shrinkBuffers(void);
+
+  std::unique_ptr<transport::Transport> m_transport;
+  const storage::CommentStore& m_comments;
+
+  // Received bytes not yet parsed are [m_read_begin, m_read_end)
+  std::vector<std::byte> m_read_buffer;
+  size_t m_read_begin = 0;
+  size_t m_read_end = 0;
+  bool m_read_drained = false;
+  bool m_read_paused = false;
+  bool m_peer_closed = false;
+
+  // Last received compressed message, restored
+  std::vector<std::byte> m_inflated{};
+  uint32_t m_capabilities = 0;
+  uint32_t m_author = 0;
+
+  bool m_subscribed = false;
+  bool m_replica = false;
+  size_t m_push_index = 0;
+
+  OutputQueue m_output{};
+  bool m_wants_write = false;
+  bool m_waiting_durable = false;
+
+  bool m_closing = false;
+  bool m_disconnected = false;
+};
+
+} // namespace server
+
+#endif /* Connection.hpp */
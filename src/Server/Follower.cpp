@@ -0,0 +1,186 @@
+#include "Follower.hpp"
+#include "Client/Client.hpp"
+#include "Client/ClientLoop.hpp"
+#include "Message/Message.hpp"
+#include "Message/SendCommentsMessage.hpp"
+#include "Metrics/Metrics.hpp"
+
+#include <chrono>
+#include <string_view>
+#include <thread>
+
+namespace server {
+
+Follower::Follower(
+    const uint8_t leader_address[4],
+    uint16_t leader_port,
+    storage::CommentStore& comments,
+    storage::SearchIndex& search_index,
+    std::function<void(void)> on_append
+) : m_leader_address{
+      leader_address[0], leader_address[1],
+      leader_address[2], leader_address[3]
+    },
+    m_leader_port(leader_port),
+    m_comments(comments),
+    m_search_index(search_index),
+    m_on_append(std::move(on_append)) {
+}
+
+Follower::~Follower() = default;
+
+void Follower::run(void) {
+  while (!m_stopped.load(std::memory_order_relaxed)) {
+    auto leader = client::Client::connect(
+        m_leader_address, m_leader_port,
+        message::Message::CapabilityCompression
+    );
+    if (leader == nullptr) {
+      pause(ReconnectDelayMs);
+      continue;
+    }
+
+    // Leader resends the last comment, which confirms it has the same ones
+    const size_t size = m_comments.size();
+    m_verifying = size > 0;
+
+    bool lost_sync = false;
+    leader->replicate(
+        (uint32_t) (size > 0 ? size - 1 : 0),
+        [this, &lost_sync](message::MessageView push) {
+          lost_sync = lost_sync || !apply(push);
+        }
+    );
+
+    client::ClientLoop loop;
+    loop.add(*leader);
+    m_connected.store(true, std::memory_order_relaxed);
+
+    while (
+      !m_stopped.load(std::memory_order_relaxed) &&
+      !lost_sync && !leader->isClosed()
+    ) {
+      loop.runOnce(PollIntervalMs);
+    }
+
+    loop.remove(*leader);
+    m_connected.store(false, std::memory_order_relaxed);
+
+    // Leader which lost comments follower has would only resend garbage
+    if (lost_sync) {
+      pause(isDiverged() ? DivergedDelayMs : ReconnectDelayMs);
+    }
+  }
+}
+
+void Follower::pause(int delay_ms) {
+  for (int slept = 0; slept < delay_ms; slept += PollIntervalMs) {
+    if (m_stopped.load(std::memory_order_relaxed)) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(PollIntervalMs));
+  }
+}
+
+size_t Follower::getLagComments(void) const noexcept {
+  const size_t leader_size = m_leader_size.load(std::memory_order_relaxed);
+  const size_t size = m_comments.size();
+  return leader_size > size ? leader_size - size : 0;
+}
+
+bool Follower::apply(message::MessageView push) {
+  auto page = message::SendCommentsMessage::fromView(push);
+  if (!page.has_value() || !page->hasMetadata()) {
+    return false;
+  }
+
+  // Comments stored after log failure would be lost on restart
+  if (m_comments.isDurabilityLost()) {
+    return false;
+  }
+
+  const size_t count = page->getCount();
+  const size_t next_index = page->getNextIndex();
+  auto snapshot = m_comments.snapshot();
+  const size_t size = snapshot.size();
+  if (next_index < count) {
+    return false;
+  }
+
+  // Leader without comments follower has cannot be followed
+  if (page->getTotal() < size) {
+    m_diverged.store(true, std::memory_order_relaxed);
+    return false;
+  }
+
+  // The first comment only confirms that histories agree
+  size_t first = 0;
+  if (m_verifying) {
+    if (count == 0) {
+      return true;
+    }
+
+    const storage::CommentRecord& last = snapshot.record(size - 1);
+    const std::span<const char> text = (*page)[0];
+    const bool agrees =
+      next_index - count == size - 1 &&
+      page->getTimestamp(0) == last.timestamp &&
+      page->getAuthor(0) == last.author &&
+      text.data() != nullptr &&
+      std::string_view(text.data(), text.size()) == last.getText();
+
+    m_diverged.store(!agrees, std::memory_order_relaxed);
+    if (!agrees) {
+      return false;
+    }
+    m_verifying = false;
+    first = 1;
+  }
+
+  if (next_index - count + first != size) {
+    return false;
+  }
+
+  // Time index of store relies on ordered timestamps
+  uint64_t last_timestamp =
+    size > 0 ? snapshot.record(size - 1).timestamp : 0;
+
+  m_batch.clear();
+  for (size_t i = first; i < count; ++i) {
+    std::span<const char> text = (*page)[i];
+    const uint64_t timestamp = page->getTimestamp(i);
+    if (text.data() == nullptr || timestamp < last_timestamp) {
+      return false;
+    }
+
+    last_timestamp = timestamp;
+    m_batch.push_back(storage::StampedComment{
+        .text = std::string_view(text.data(), text.size()),
+        .timestamp = timestamp,
+        .author = page->getAuthor(i)
+    });
+  }
+
+  m_leader_size.store(page->getTotal(), std::memory_order_relaxed);
+  if (m_batch.empty()) {
+    return true;
+  }
+
+  m_comments.appendStamped(m_batch);
+  metrics::Metrics::add(metrics::Counter::StoredComments, m_batch.size());
+  m_search_index.update(m_comments.snapshot());
+  m_on_append();
+
+  using namespace std::chrono;
+  const uint64_t now = (uint64_t)
+    duration_cast<microseconds>(system_clock::now().time_since_epoch())
+    .count();
+  m_delay_us.store(
+      now > last_timestamp ? now - last_timestamp : 0,
+      std::memory_order_relaxed
+  );
+
+  return true;
+}
+
+} // namespace server
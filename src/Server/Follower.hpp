@@ -0,0 +1,144 @@
+/**
+ * @file Follower.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Replication of leader comment log into local store
+ *
+ * Follower connects to leader as a client and sends Replicate with size of
+ * its store, so that it resumes where it stopped, e.g. after restart with
+ * recovered log. Leader then pushes every durable comment with its
+ * timestamp and author, and follower appends them to store in the same
+ * order, so comment indices of leader and follower agree. Lost connection
+ * is reestablished until follower is stopped.
+ *
+ * Replication starts one comment early, and leader must resend the last
+ * comment follower has unchanged. Leader which lost comments, e.g. one
+ * restarted without log, has different history, and follower keeps its
+ * store as is and reports that it diverged until leader agrees again.
+ *
+ * @version 0.0.1
+ * @date 2024-11-23
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __SERVER_FOLLOWER_HPP
+#define __SERVER_FOLLOWER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Message/MessageView.hpp"
+#include "Storage/CommentStore.hpp"
+#include "Storage/SearchIndex.hpp"
+
+namespace server {
+
+class Follower final {
+public:
+  /**
+   * @brief Follower of leader listening on given address
+   *
+   * @param[in] leader_address  IPv4 address of leader
+   * @param[in] leader_port     TCP port of leader
+   * @param[in] comments        Store only follower appends to
+   * @param[in] search_index    Index kept up to date with store
+   * @param[in] on_append       Called from follower thread after comments
+   *                            are appended
+   */
+  Follower(
+      const uint8_t leader_address[4],
+      uint16_t leader_port,
+      storage::CommentStore& comments,
+      storage::SearchIndex& search_index,
+      std::function<void(void)> on_append
+  );
+
+  // Non-Copyable
+  Follower(const Follower&) = delete;
+  Follower& operator=(const Follower&) = delete;
+
+  // Non-Movable
+  Follower(Follower&&) = delete;
+  Follower& operator=(Follower&&) = delete;
+
+  ~Follower();
+
+  /**
+   * @brief Replicate leader until `stop()` is called
+   */
+  void run(void);
+
+  /**
+   * @brief Make `run()` return soon, may be called from any thread
+   */
+  void stop(void) noexcept {
+    m_stopped.store(true, std::memory_order_relaxed);
+  }
+
+  bool isConnected(void) const noexcept {
+    return m_connected.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief History of leader does not continue store of follower, so
+   * nothing is replicated
+   */
+  bool isDiverged(void) const noexcept {
+    return m_diverged.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Comments leader had when it last pushed, which follower has not
+   * stored yet
+   */
+  size_t getLagComments(void) const noexcept;
+
+  /**
+   * @brief Time from leader storing the latest replicated comment to
+   * follower storing it, in microseconds
+   */
+  uint64_t getDelayUs(void) const noexcept {
+    return m_delay_us.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr int PollIntervalMs = 100;
+  static constexpr int ReconnectDelayMs = 200;
+  static constexpr int DivergedDelayMs = 5000;
+
+  /**
+   * @brief Store comments of ReplicatedComments push
+   *
+   * @return Push continues store, otherwise follower lost sync with leader
+   */
+  bool apply(message::MessageView push);
+
+  /**
+   * @brief Sleep unless stopped meanwhile
+   */
+  void pause(int delay_ms);
+
+  uint8_t m_leader_address[4];
+  uint16_t m_leader_port;
+  storage::CommentStore& m_comments;
+  storage::SearchIndex& m_search_index;
+  std::function<void(void)> m_on_append;
+
+  std::vector<storage::StampedComment> m_batch{};
+
+  // Leader has not resent the last comment of store yet
+  bool m_verifying = false;
+
+  std::atomic<bool> m_stopped = false;
+  std::atomic<bool> m_connected = false;
+  std::atomic<bool> m_diverged = false;
+  std::atomic<size_t> m_leader_size = 0;
+  std::atomic<uint64_t> m_delay_us = 0;
+};
+
+} // namespace server
+
+#endif /* Follower.hpp */
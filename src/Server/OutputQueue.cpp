@@ -0,0 +1,169 @@
+#include "OutputQueue.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+#include <sys/uio.h>
+
+namespace server {
+
+static constexpr size_t MaxIovecs = std::min<size_t>(IOV_MAX, 256);
+
+void OutputQueue::append(std::span<const std::byte> bytes, size_t gate) {
+  if (bytes.empty()) {
+    return;
+  }
+
+  m_size += bytes.size();
+
+  // Merging may hold earlier bytes until the later gate opens, but gates
+  // of one connection open almost together, so this costs little
+  if (!m_chunks.empty()) {
+    Chunk& last = m_chunks.back();
+    if (
+      last.ref == nullptr &&
+      last.size + bytes.size() <= MaxCoalescedSize
+    ) {
+      last.owned.insert(last.owned.end(), bytes.begin(), bytes.end());
+      last.size += bytes.size();
+      last.gate = std::max(last.gate, gate);
+      return;
+    }
+  }
+
+  m_chunks.push_back(Chunk{
+      .owned = std::vector(bytes.begin(), bytes.end()),
+      .ref = nullptr,
+      .size = bytes.size(),
+      .gate = gate,
+      .shared = false
+  });
+}
+
+void OutputQueue::append(std::vector<std::byte>&& bytes, size_t gate) {
+  if (bytes.size() < MaxCoalescedSize / 2) {
+    append(std::span<const std::byte>(bytes), gate);
+    return;
+  }
+
+  m_size += bytes.size();
+
+  const size_t size = bytes.size();
+  m_chunks.push_back(Chunk{
+      .owned = std::move(bytes),
+      .ref = nullptr,
+      .size = size,
+      .gate = gate,
+      .shared = false
+  });
+}
+
+void OutputQueue::appendRef(std::span<const std::byte> bytes) {
+  if (bytes.empty()) {
+    return;
+  }
+
+  m_size += bytes.size();
+
+  if (!m_chunks.empty()) {
+    Chunk& last = m_chunks.back();
+    if (
+      last.ref != nullptr && !last.shared &&
+      last.ref + last.size == bytes.data()
+    ) {
+      last.size += bytes.size();
+      return;
+    }
+  }
+
+  m_chunks.push_back(Chunk{
+      .owned = {},
+      .ref = bytes.data(),
+      .size = bytes.size(),
+      .gate = 0,
+      .shared = false
+  });
+}
+
+void OutputQueue::appendShared(
+    std::shared_ptr<const std::vector<std::byte>> bytes,
+    size_t gate
+) {
+  if (bytes->empty()) {
+    return;
+  }
+
+  m_size += bytes->size();
+
+  m_chunks.push_back(Chunk{
+      .owned = {},
+      .ref = bytes->data(),
+      .size = bytes->size(),
+      .gate = gate,
+      .shared = true
+  });
+  m_shared.push_back(std::move(bytes));
+}
+
+OutputQueue::FlushResult OutputQueue::flush(
+    transport::Transport& transport,
+    size_t open_gate
+) {
+  struct iovec iovecs[MaxIovecs];
+
+  while (!m_chunks.empty()) {
+    size_t count = 0;
+    for (const Chunk& chunk : m_chunks) {
+      if (count == MaxIovecs || chunk.gate > open_gate) {
+        break;
+      }
+      size_t skip = count == 0 ? m_front_offset : 0;
+      iovecs[count].iov_base = const_cast<std::byte*>(chunk.data() + skip);
+      iovecs[count].iov_len = chunk.size - skip;
+      ++count;
+    }
+
+    if (count == 0) {
+      return FlushResult::Gated;
+    }
+
+    errno = 0;
+    ssize_t res = transport.write(std::span(iovecs, count));
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return FlushResult::WouldBlock;
+    }
+    if (res < 0) {
+      return FlushResult::Error;
+    }
+
+    consume((size_t) res);
+  }
+
+  return FlushResult::Drained;
+}
+
+void OutputQueue::consume(size_t size) {
+  m_size -= size;
+  while (size > 0) {
+    Chunk& front = m_chunks.front();
+    size_t left = front.size - m_front_offset;
+
+    if (size < left) {
+      m_front_offset += size;
+      return;
+    }
+
+    size -= left;
+    if (front.shared) {
+      m_shared.pop_front();
+    }
+    m_chunks.pop_front();
+    m_front_offset = 0;
+  }
+}
+
+} // namespace server
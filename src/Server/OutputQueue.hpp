@@ -0,0 +1,119 @@
+/**
+ * @file OutputQueue.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Scatter-gather queue of bytes pending to be sent to transport
+ *
+ * @version 0.0.1
+ * @date 2024-11-08
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __SERVER_OUTPUT_QUEUE_HPP
+#define __SERVER_OUTPUT_QUEUE_HPP
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "Transport/Transport.hpp"
+
+namespace server {
+
+class OutputQueue final {
+public:
+  OutputQueue() = default;
+
+  // Non-Copyable
+  OutputQueue(const OutputQueue&) = delete;
+  OutputQueue& operator=(const OutputQueue&) = delete;
+
+  // Movable
+  OutputQueue(OutputQueue&&) noexcept = default;
+  OutputQueue& operator=(OutputQueue&&) noexcept = default;
+
+  enum class FlushResult {
+    Drained,     // All bytes were sent
+    WouldBlock,  // Transport buffer is full
+    Gated,       // Next bytes wait for their gate to open
+    Error        // Transport reported an error
+  };
+
+  /**
+   * @brief Copy bytes to the end of queue.
+   *
+   * Small copies are coalesced into one buffer, so that a burst of short
+   * responses is sent as a single iovec.
+   *
+   * @param[in] bytes   Bytes to send
+   * @param[in] gate    Bytes (and everything after them) are held back
+   *                    until `flush()` is called with `open_gate >= gate`
+   */
+  void append(std::span<const std::byte> bytes, size_t gate = 0);
+
+  /**
+   * @brief Take ownership of bytes. Large buffer is queued without copying
+   */
+  void append(std::vector<std::byte>&& bytes, size_t gate = 0);
+
+  /**
+   * @brief Add bytes to the end of queue without copying.
+   *
+   * Referenced memory must stay valid until it is sent. Reference adjacent
+   * to the previous one is merged with it.
+   */
+  void appendRef(std::span<const std::byte> bytes);
+
+  /**
+   * @brief Add shared buffer to the end of queue without copying. Buffer
+   * is kept alive until it is sent
+   */
+  void appendShared(
+      std::shared_ptr<const std::vector<std::byte>> bytes,
+      size_t gate = 0
+  );
+
+  bool empty(void) const noexcept { return m_chunks.empty(); }
+
+  /**
+   * @brief Number of bytes not yet sent
+   */
+  size_t size(void) const noexcept { return m_size; }
+
+  /**
+   * @brief Send as much of queued bytes as transport accepts
+   *
+   * @param[in] transport   Transport to write to
+   * @param[in] open_gate   Highest gate which is currently open
+   */
+  FlushResult flush(transport::Transport& transport, size_t open_gate);
+
+private:
+  struct Chunk {
+    std::vector<std::byte> owned;
+    const std::byte* ref;
+    size_t size;
+    size_t gate;
+    bool shared;  // Bytes are held by `m_shared`
+
+    const std::byte* data(void) const noexcept {
+      return ref == nullptr ? owned.data() : ref;
+    }
+  };
+
+  // Owned chunks stop growing at this size
+  static constexpr size_t MaxCoalescedSize = 64 * 1024;
+
+  void consume(size_t size);
+
+  std::deque<Chunk> m_chunks{};
+  std::deque<std::shared_ptr<const std::vector<std::byte>>> m_shared{};
+  size_t m_front_offset = 0;
+  size_t m_size = 0;
+};
+
+} // namespace server
+
+#endif /* OutputQueue.hpp */
@@ -0,0 +1,81 @@
+#include "ResponseCache.hpp"
+
+#include <functional>
+
+namespace server {
+
+size_t ResponseCache::KeyHash::operator()(const Key& key) const noexcept {
+  uint64_t packed = (uint64_t) key.start_index << 32
+    | (uint64_t) key.max_count;
+  uint64_t rest = (uint64_t) key.max_bytes << 32
+    | (uint64_t) key.encoding << 1
+    | (uint64_t) key.compressed;
+
+  return std::hash<uint64_t>{}(packed * 0x9e3779b97f4a7c15ull ^ rest);
+}
+
+ResponseCache::Frame ResponseCache::find(
+    const Key& key,
+    size_t version,
+    bool& admit
+) {
+  admit = false;
+  if (m_max_bytes == 0) {
+    return nullptr;
+  }
+
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    m_entries.push_front(Entry{ .key = key, .version = version, .frame = {} });
+    m_index.emplace(key, m_entries.begin());
+    m_bytes += cost(m_entries.front());
+    evict();
+    return nullptr;
+  }
+
+  m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+  const Entry& entry = *it->second;
+  if (entry.frame != nullptr && entry.version == version) {
+    return entry.frame;
+  }
+
+  // Store grew since frame was built, or frame was never built
+  admit = true;
+  return nullptr;
+}
+
+void ResponseCache::insert(const Key& key, size_t version, Frame frame) {
+  if (!admits(frame->size())) {
+    return;
+  }
+
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    m_entries.push_front(Entry{ .key = key, .version = 0, .frame = {} });
+    it = m_index.emplace(key, m_entries.begin()).first;
+    m_bytes += cost(m_entries.front());
+  } else {
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+  }
+
+  Entry& entry = *it->second;
+  m_bytes -= cost(entry);
+  entry.version = version;
+  entry.frame = std::move(frame);
+  m_bytes += cost(entry);
+
+  evict();
+}
+
+void ResponseCache::evict(void) {
+  // Most recent entry is always kept, it fits by construction
+  while (m_bytes > m_max_bytes && m_entries.size() > 1) {
+    const Entry& victim = m_entries.back();
+    m_bytes -= cost(victim);
+    m_index.erase(victim.key);
+    m_entries.pop_back();
+  }
+}
+
+} // namespace server
@@ -0,0 +1,127 @@
+/**
+ * @file ResponseCache.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Byte-bounded LRU cache of serialized comment pages
+ *
+ * Cached frame is shared between cache and output queues of connections
+ * which send it, and lives until the last of them drops it, so eviction
+ * never invalidates queued bytes. Every frame remembers store size it was
+ * built for, and is only served while store has exactly that size, since
+ * response carries total number of comments. Key is admitted on its
+ * second request, so pages read once are still sent straight from store.
+ *
+ * @version 0.0.1
+ * @date 2024-11-22
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __SERVER_RESPONSE_CACHE_HPP
+#define __SERVER_RESPONSE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace server {
+
+class ResponseCache final {
+public:
+  using Frame = std::shared_ptr<const std::vector<std::byte>>;
+
+  /**
+   * @brief Request which response depends on, apart from store contents
+   */
+  struct Key {
+    uint32_t start_index;
+    uint32_t max_count;
+    uint32_t max_bytes;
+    uint32_t encoding;
+    bool compressed;  // Frame is compressed for connection
+
+    bool operator==(const Key&) const = default;
+  };
+
+  /**
+   * @brief Cache holding frames of at most `max_bytes` in total. Zero
+   * disables caching
+   */
+  explicit ResponseCache(size_t max_bytes)
+    : m_max_bytes(max_bytes) {
+  }
+
+  // Non-Copyable
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+
+  // Movable
+  ResponseCache(ResponseCache&&) = default;
+  ResponseCache& operator=(ResponseCache&&) = default;
+
+  ~ResponseCache() = default;
+
+  /**
+   * @brief Frame cached for `key` when store had `version` comments.
+   *
+   * @param[out] admit  Set if frame was not found, but should be built and
+   *                    `insert()`-ed, because key was requested before
+   *
+   * @return Cached frame or `nullptr`
+   */
+  Frame find(const Key& key, size_t version, bool& admit);
+
+  /**
+   * @brief Cache frame of `key` built when store had `version` comments.
+   * Frames rejected by `admits()` are not cached
+   */
+  void insert(const Key& key, size_t version, Frame frame);
+
+  /**
+   * @brief Frame of `frame_size` bytes may be cached. Frames above an
+   * eighth of cache size are not, so that one page never evicts most others
+   */
+  bool admits(size_t frame_size) const noexcept {
+    return m_max_bytes != 0 && frame_size <= m_max_bytes / 8;
+  }
+
+  /**
+   * @brief Bytes of cached frames
+   */
+  size_t getBytes(void) const noexcept { return m_bytes; }
+
+private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const noexcept;
+  };
+
+  struct Entry {
+    Key key;
+    size_t version;
+    Frame frame;  // Null if key was only seen
+  };
+
+  using EntryList = std::list<Entry>;
+
+  // Bookkeeping charged for every entry, so that keys seen once are
+  // bounded as well
+  static constexpr size_t EntryOverhead = 128;
+
+  static size_t cost(const Entry& entry) noexcept {
+    return EntryOverhead + (entry.frame ? entry.frame->size() : 0);
+  }
+
+  void evict(void);
+
+  size_t m_max_bytes;
+  size_t m_bytes = 0;
+
+  EntryList m_entries{};  // Most recently used first
+  std::unordered_map<Key, EntryList::iterator, KeyHash> m_index{};
+};
+
+} // namespace server
+
+#endif /* ResponseCache.hpp */
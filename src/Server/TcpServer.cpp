@@ -1,28 +1,179 @@
 #include "TcpServer.hpp"
+#include "Server/Connection.hpp"
+#include "Server/Follower.hpp"
+#include "Server/ResponseCache.hpp"
+#include "Message/Compression.hpp"
 #include "Message/GetCommentsMessage.hpp"
+#include "Message/GetCommentsSinceMessage.hpp"
+#include "Message/HelloMessage.hpp"
 #include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
 #include "Message/NewCommentMessage.hpp"
+#include "Message/NewCommentsBatchMessage.hpp"
+#include "Message/SearchCommentsMessage.hpp"
+#include "Message/SubscribeMessage.hpp"
+#include "Metrics/Metrics.hpp"
+#include "Storage/CommentLog.hpp"
+#include "Storage/CommentStore.hpp"
+#include "Storage/SearchIndex.hpp"
+#include "Transport/ShmTransport.hpp"
+#include "Transport/Transport.hpp"
+#include "Transport/Uring.hpp"
+#include "Transport/UringTransport.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <csignal>
 #include <cstddef>
 #include <cstdio>
 #include <cassert>
 
-#include <string>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <unistd.h>
 #include <vector>
 
 namespace server {
 
-static constexpr size_t BacklogSize = 16;
+static constexpr size_t BacklogSize = SOMAXCONN;
+static constexpr size_t MaxEvents = 256;
+
+// Upper bound on comment bytes in one CommentsResponse, regardless of
+// limits requested by client
+static constexpr size_t MaxResponseBytes = 1024 * 1024;
+
+// Upper bound on comments in one SearchResults
+static constexpr size_t MaxSearchResults = 1024;
+
+// Capabilities server agrees to when client announces them in Hello
+static constexpr uint32_t SupportedCapabilities =
+  message::Message::CapabilityCompression;
+
+struct ConnectionEntry {
+  std::unique_ptr<Connection> connection;
+  uint32_t events;  // Events connection is currently registered for
+
+  // Transport of connection if it is driven by io_uring, which replaces
+  // epoll registration
+  transport::UringTransport* uring;
+};
+
+using ConnectionMap = std::unordered_map<int, ConnectionEntry>;
+
+/**
+ * @brief Wakes up reactor with subscribers when other reactors store
+ * comments. Signal is sent at most once until reactor handles it, so
+ * appends between two reactor turns are pushed together.
+ */
+struct PushTarget {
+  int event = -1;
+  std::atomic<bool> signalled = false;
+  std::atomic<size_t> subscribers = 0;
+};
+
+struct Reactor {
+  int epoll;
+  int listener;
+  int shm_listener;  // Shared by all reactors, -1 if absent
+  int stop_event;
+  int durable_event;
+  storage::CommentStore& comments;
+  storage::SearchIndex& search_index;
+  bool index_pending;  // Comments stored in this turn are not indexed yet
+
+  // Replication of leader if server is a follower, otherwise null
+  const Follower* follower;
+
+  // Serialized pages of repeated GetComments requests
+  ResponseCache response_cache;
+
+  // Accepts and serves TCP clients instead of epoll if present. Declared
+  // before connections, whose transports must not outlive it
+  std::unique_ptr<transport::Uring> uring;
+  uint32_t uring_generation;  // Of next connection accepted with `uring`
+
+  ConnectionMap connections;
+
+  // Connections with responses waiting for comments to become durable
+  std::unordered_set<int> waiting_durable;
+
+  // Connections which stopped reading because of pending output, with
+  // requests possibly left unread in transport
+  std::unordered_set<int> paused_readers;
+  bool resume_pending;  // Some of them may read again right away
+
+  std::span<PushTarget> push_targets;  // Targets of all reactors
+  PushTarget& push_target;             // Target of this reactor
+  std::unordered_set<int> subscribers;
+
+  ~Reactor();
+};
+
+Reactor::~Reactor() = default;
 
 static int make_listen_socket(uint8_t ip_address[4], uint16_t port);
-static void serve_client(int socket, std::vector<std::string>& comments);
+static void run_reactor(
+    int listener,
+    int shm_listener,
+    int stop_event,
+    IoBackend io_backend,
+    storage::CommentStore& comments,
+    storage::SearchIndex& search_index,
+    storage::CommentLog* log,
+    const Follower* follower,
+    size_t response_cache_bytes,
+    std::span<PushTarget> push_targets,
+    size_t reactor_index
+);
+static void watch_fd(int epoll, int fd, uint32_t flags = 0);
+static void accept_clients(Reactor& reactor);
+static void accept_shm_clients(Reactor& reactor);
+static void add_connection(
+    Reactor& reactor,
+    std::unique_ptr<transport::Transport> transport
+);
+static void submit_accept(Reactor& reactor);
+static void add_uring_connection(Reactor& reactor, int client);
+static void complete_uring(Reactor& reactor);
+static void fail_over_to_epoll(Reactor& reactor);
+static void flush_durable(Reactor& reactor);
+static void flush_connection(
+    Connection& connection,
+    const storage::CommentStore& comments
+);
+static void receive_push_signal(Reactor& reactor);
+static void signal_push_targets(
+    std::span<PushTarget> targets,
+    const PushTarget* origin
+);
+static void signal_subscribers(Reactor& reactor);
+static void push_subscribers(Reactor& reactor);
+static void resume_readers(Reactor& reactor);
+static void index_comments(Reactor& reactor);
+static void finish_events(Reactor& reactor, ConnectionMap::iterator it);
+static void serve_client(Reactor& reactor, Connection& connection);
+static void push_comments(
+    Connection& connection,
+    const storage::CommentStore::Snapshot& snapshot
+);
+static void send_stats(Reactor& reactor, Connection& connection);
 
-static void interrupt_handler(int) { /* Enter handler but do nothing */ }
+static volatile sig_atomic_t s_interrupted = 0;
+
+static void interrupt_handler(int) { s_interrupted = 1; }
 static void setup_interrupt_handler() {
   int res = 0;
   struct sigaction action;
@@ -35,28 +186,310 @@ static void setup_interrupt_handler() {
   assert(res == 0);
 }
 
-void listen_tcp(uint8_t ip_address[4], uint16_t port) {
-  int listener = make_listen_socket(ip_address, port);
+IoBackend select_io_backend(IoBackend preferred) {
+  if (preferred == IoBackend::Epoll) {
+    return IoBackend::Epoll;
+  }
+  return transport::Uring::isSupported() ? IoBackend::IoUring
+                                         : IoBackend::Epoll;
+}
 
-  std::vector<std::string> comments;
-  setup_interrupt_handler();
+bool listen_tcp(
+    uint8_t ip_address[4],
+    uint16_t port,
+    const ServerConfig& config
+) {
+  const size_t reactor_count = config.reactor_count;
+  assert(reactor_count > 0);
 
-  for (;;) {
-    errno = 0;
-    int client = accept(listener, NULL, NULL);
-    if (client == -1 && errno == EINTR) {
-      break;
+  const IoBackend io_backend = config.io_backend == IoBackend::Auto
+    ? select_io_backend(IoBackend::Auto)
+    : config.io_backend;
+
+  // Log must outlive store, which may reference its mappings
+  std::unique_ptr<storage::CommentLog> log = nullptr;
+  if (!config.log_directory.empty()) {
+    log = std::make_unique<storage::CommentLog>(
+        config.log_directory, config.log_options
+    );
+  }
+
+  storage::CommentStore comments(log.get(), config.arena_options);
+  if (log != nullptr) {
+    bool recovered = log->recover(
+        [&comments](const storage::CommentRecord& comment) {
+          comments.adopt(comment);
+        }
+    );
+    if (!recovered) {
+      return false;
     }
-    assert(client >= 0);
 
-    serve_client(client, comments);
-    if (errno == EINTR) {
-      break;
+    // Recovered comments are cold, and are released as cold segments are
+    for (std::span<const char> mapping : log->getMappings()) {
+      comments.adoptMemory(mapping);
     }
   }
 
+  // Appends keep index up to date from now on
+  storage::SearchIndex search_index;
+  search_index.update(comments.snapshot());
+
+  // Recovered comments were only read to build indices
+  comments.releaseCold();
+
+  // Every reactor gets its own listener, kernel balances connections
+  // between them with SO_REUSEPORT
+  std::vector<int> listeners(reactor_count);
+  for (size_t i = 0; i < reactor_count; ++i) {
+    listeners[i] = make_listen_socket(ip_address, port);
+  }
+
+  int shm_listener = -1;
+  if (config.shm_path != nullptr) {
+    shm_listener = transport::ShmTransport::listen(config.shm_path);
+    assert(shm_listener >= 0);
+  }
+
+  int stop_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  assert(stop_event >= 0);
+
+  std::vector<PushTarget> push_targets(reactor_count);
+  for (PushTarget& target : push_targets) {
+    target.event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(target.event >= 0);
+  }
+
+  // Only the calling thread handles SIGINT, workers inherit blocked mask
+  sigset_t interrupt_mask;
+  sigset_t old_mask;
+  sigemptyset(&interrupt_mask);
+  sigaddset(&interrupt_mask, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &interrupt_mask, &old_mask);
+
+  // Replicated comments are pushed to subscribers of every reactor
+  std::unique_ptr<Follower> follower = nullptr;
+  std::thread replication;
+  if (config.leader_port != 0) {
+    follower = std::make_unique<Follower>(
+        config.leader_address, config.leader_port, comments, search_index,
+        [&push_targets](void) {
+          signal_push_targets(push_targets, nullptr);
+        }
+    );
+    replication = std::thread(&Follower::run, follower.get());
+  }
+
+  // Every reactor caches responses it sends on its own
+  const size_t response_cache_bytes =
+    config.response_cache_bytes / reactor_count;
+
+  std::vector<std::thread> workers;
+  workers.reserve(reactor_count - 1);
+  for (size_t i = 1; i < reactor_count; ++i) {
+    workers.emplace_back(
+        run_reactor, listeners[i], shm_listener, stop_event, io_backend,
+        std::ref(comments), std::ref(search_index), log.get(),
+        follower.get(), response_cache_bytes, std::span(push_targets), i
+    );
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+  s_interrupted = 0;
+  setup_interrupt_handler();
+
+  run_reactor(
+      listeners[0], shm_listener, stop_event, io_backend, comments,
+      search_index, log.get(), follower.get(), response_cache_bytes,
+      push_targets, 0
+  );
+
+  // Wake up all other reactors
+  uint64_t stop = 1;
+  ssize_t written = write(stop_event, &stop, sizeof(stop));
+  assert(written == sizeof(stop));
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  if (follower != nullptr) {
+    follower->stop();
+    replication.join();
+  }
+
+  close(stop_event);
+  for (const PushTarget& target : push_targets) {
+    close(target.event);
+  }
+  for (int listener : listeners) {
+    close(listener);
+  }
+  if (shm_listener >= 0) {
+    close(shm_listener);
+    unlink(config.shm_path);
+  }
+
   puts("");
   puts("Server stopped");
+  return true;
+}
+
+static void run_reactor(
+    int listener,
+    int shm_listener,
+    int stop_event,
+    IoBackend io_backend,
+    storage::CommentStore& comments,
+    storage::SearchIndex& search_index,
+    storage::CommentLog* log,
+    const Follower* follower,
+    size_t response_cache_bytes,
+    std::span<PushTarget> push_targets,
+    size_t reactor_index
+) {
+  Reactor reactor = {
+    .epoll = epoll_create1(EPOLL_CLOEXEC),
+    .listener = listener,
+    .shm_listener = shm_listener,
+    .stop_event = stop_event,
+    .durable_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+    .comments = comments,
+    .search_index = search_index,
+    .index_pending = false,
+    .follower = follower,
+    .response_cache = ResponseCache(response_cache_bytes),
+    .uring = nullptr,
+    .uring_generation = 0,
+    .connections = {},
+    .waiting_durable = {},
+    .paused_readers = {},
+    .resume_pending = false,
+    .push_targets = push_targets,
+    .push_target = push_targets[reactor_index],
+    .subscribers = {}
+  };
+  assert(reactor.epoll >= 0);
+  assert(reactor.durable_event >= 0);
+
+  // Reactor keeps serving with epoll if its instance cannot be created,
+  // e.g. when locked memory limit is reached
+  if (io_backend == IoBackend::IoUring) {
+    reactor.uring = transport::Uring::create();
+  }
+  if (reactor.uring != nullptr) {
+    watch_fd(reactor.epoll, reactor.uring->getFd());
+    submit_accept(reactor);
+  } else {
+    watch_fd(reactor.epoll, listener);
+  }
+  if (shm_listener >= 0) {
+    // Wake up only one of reactors per incoming connection
+    watch_fd(reactor.epoll, shm_listener, EPOLLEXCLUSIVE);
+  }
+  watch_fd(reactor.epoll, stop_event);
+  watch_fd(reactor.epoll, reactor.durable_event);
+  watch_fd(reactor.epoll, reactor.push_target.event);
+  if (log != nullptr) {
+    log->addListener(reactor.durable_event);
+  }
+
+  struct epoll_event events[MaxEvents];
+  bool stopped = false;
+  while (!stopped && !s_interrupted) {
+    // All requests queued in previous turn enter kernel together
+    bool completed = false;
+    if (reactor.uring != nullptr && !reactor.uring->submit()) {
+      fail_over_to_epoll(reactor);
+    }
+    if (reactor.uring != nullptr) {
+      completed = reactor.uring->hasCompletions();
+    }
+
+    errno = 0;
+    int count = epoll_wait(
+        reactor.epoll, events, MaxEvents,
+        reactor.resume_pending || completed ? 0 : -1
+    );
+    if (count == -1 && errno == EINTR) {
+      continue;
+    }
+    assert(count >= 0);
+
+    const size_t stored_before = comments.size();
+
+    for (int i = 0; i < count; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == stop_event) {
+        stopped = true;
+        continue;
+      }
+      if (fd == listener) {
+        accept_clients(reactor);
+        continue;
+      }
+      if (fd == shm_listener) {
+        accept_shm_clients(reactor);
+        continue;
+      }
+      if (fd == reactor.durable_event) {
+        flush_durable(reactor);
+        continue;
+      }
+      if (fd == reactor.push_target.event) {
+        receive_push_signal(reactor);
+        push_subscribers(reactor);
+        continue;
+      }
+      if (reactor.uring != nullptr && fd == reactor.uring->getFd()) {
+        completed = true;  // Handled after all events
+        continue;
+      }
+
+      auto it = reactor.connections.find(fd);
+      assert(it != reactor.connections.end());
+      Connection& connection = *it->second.connection;
+
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        serve_client(reactor, connection);
+      }
+
+      // Responses to all requests read in this turn go out together
+      flush_connection(connection, comments);
+
+      finish_events(reactor, it);
+    }
+
+    if (completed) {
+      complete_uring(reactor);
+    }
+
+    resume_readers(reactor);
+
+    // All comments stored in this turn are indexed and pushed together
+    index_comments(reactor);
+    if (comments.size() > stored_before) {
+      signal_subscribers(reactor);
+      push_subscribers(reactor);
+    }
+  }
+
+  if (log != nullptr) {
+    log->removeListener(reactor.durable_event);
+  }
+
+  reactor.connections.clear();
+  reactor.uring = nullptr;
+  close(reactor.durable_event);
+  close(reactor.epoll);
+}
+
+static void watch_fd(int epoll, int fd, uint32_t flags) {
+  struct epoll_event event = {};
+  event.events = EPOLLIN | flags;
+  event.data.fd = fd;
+  int res = epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+  assert(res == 0);
 }
 
 static int make_listen_socket(uint8_t ip_address[4], uint16_t port) {
@@ -64,19 +497,26 @@ static int make_listen_socket(uint8_t ip_address[4], uint16_t port) {
   static char addr_buffer[IpAddrMaxLength + 1] = "";
   int res = 0;
 
-  snprintf(addr_buffer, IpAddrMaxLength,
-      "%hhd.%hhd.%hhd.%hhd",
+  snprintf(addr_buffer, IpAddrMaxLength + 1,
+      "%hhu.%hhu.%hhu.%hhu",
       ip_address[0], ip_address[1], ip_address[2], ip_address[3]
   );
 
   struct sockaddr_in address;
   address.sin_family = AF_INET;
-  address.sin_port = port;
+  address.sin_port = htons(port);
   res = inet_aton(addr_buffer, &address.sin_addr);
   assert(res == 1);
 
-  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   assert(fd >= 0);
+
+  int enable = 1;
+  res = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  assert(res == 0);
+  res = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+  assert(res == 0);
+
   res = bind(fd, (const struct sockaddr*) &address, sizeof(address));
   assert(res == 0);
   res = listen(fd, BacklogSize);
@@ -85,125 +525,1015 @@ static int make_listen_socket(uint8_t ip_address[4], uint16_t port) {
   return fd;
 }
 
-static void add_comment(
-    int socket,
-    message::NewCommentMessage message,
-    std::vector<std::string> &comments
-);
-static void send_comments(
-    int socket,
-    message::GetCommentsMessage message,
-    std::vector<std::string> &comments
-);
+static void accept_clients(Reactor& reactor) {
+  for (;;) {
+    errno = 0;
+    int client =
+      accept4(reactor.listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client == -1) {
+      // EAGAIN: no more pending connections. Other errors (e.g. ECONNABORTED,
+      // EMFILE) only affect this client, so keep serving the rest.
+      return;
+    }
 
-static void serve_client(int socket, std::vector<std::string>& comments) {
-  std::vector<std::byte> buffer(message::Message::MinSize);
-  size_t offset = 0;
-  size_t read_size = message::Message::MinSize;
-  bool conn_closed = false;
+    int enable = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
 
-  while (!conn_closed) {
+    add_connection(
+        reactor, std::make_unique<transport::SocketTransport>(client)
+    );
+  }
+}
+
+static void accept_shm_clients(Reactor& reactor) {
+  for (;;) {
     errno = 0;
-    int res = recv(socket, buffer.data() + offset, read_size, MSG_WAITALL);
-    
-    if (res <= 0) {
+    int client = accept4(
+        reactor.shm_listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC
+    );
+    if (client == -1) {
+      return;
+    }
+
+    // Failure to set up shared memory only affects this client
+    auto shm = transport::ShmTransport::serve(client);
+    if (shm == nullptr) {
+      continue;
+    }
+
+    add_connection(reactor, std::move(shm));
+  }
+}
+
+static void add_connection(
+    Reactor& reactor,
+    std::unique_ptr<transport::Transport> transport
+) {
+  const int fd = transport->getFd();
+
+  struct epoll_event event = {};
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.fd = fd;
+  int res = epoll_ctl(reactor.epoll, EPOLL_CTL_ADD, fd, &event);
+  assert(res == 0);
+
+  metrics::Metrics::add(metrics::Counter::AcceptedConnections);
+  reactor.connections.emplace(
+      fd,
+      ConnectionEntry{
+        .connection = std::make_unique<Connection>(
+            std::move(transport), reactor.comments
+        ),
+        .events = event.events,
+        .uring = nullptr
+      }
+  );
+}
+
+static void submit_accept(Reactor& reactor) {
+  using transport::UringTag;
+
+  struct io_uring_sqe& sqe = reactor.uring->getSqe();
+  sqe.opcode = IORING_OP_ACCEPT;
+  sqe.fd = reactor.listener;
+  sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe.user_data = UringTag{ UringTag::Operation::Accept, reactor.listener, 0 }
+    .encode();
+}
+
+static void add_uring_connection(Reactor& reactor, int client) {
+  int enable = 1;
+  setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+  auto transport = std::make_unique<transport::UringTransport>(
+      *reactor.uring, client, reactor.uring_generation++
+  );
+  transport::UringTransport* uring = transport.get();
+
+  metrics::Metrics::add(metrics::Counter::AcceptedConnections);
+  reactor.connections.emplace(
+      client,
+      ConnectionEntry{
+        .connection = std::make_unique<Connection>(
+            std::move(transport), reactor.comments
+        ),
+        .events = 0,
+        .uring = uring
+      }
+  );
+  uring->setReceiving(true);
+}
+
+/**
+ * @brief Dispatch posted completions, then serve every connection which
+ * received data or finished sending
+ */
+static void complete_uring(Reactor& reactor) {
+  using transport::UringTag;
+  using Operation = UringTag::Operation;
+
+  std::vector<int> ready;
+  reactor.uring->reap([&reactor, &ready](const struct io_uring_cqe& cqe) {
+    const UringTag tag = UringTag::decode(cqe.user_data);
+
+    switch (tag.operation) {
+    case Operation::Accept:
+      // Failure to accept only affects that client
+      if (cqe.res >= 0) {
+        add_uring_connection(reactor, cqe.res);
+      }
+      if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        submit_accept(reactor);
+      }
+      return;
+    case Operation::Receive:
+    case Operation::Send: {
+      // Connection may be gone, and its descriptor reused by another one
+      auto it = reactor.connections.find(tag.fd);
+      if (it == reactor.connections.end() ||
+          it->second.uring == nullptr ||
+          it->second.uring->getGeneration() != tag.generation) {
+        transport::UringTransport::completeStale(*reactor.uring, cqe);
+        return;
+      }
+      if (it->second.uring->complete(cqe)) {
+        ready.push_back(tag.fd);
+      }
+      return;
+    }
+    case Operation::Cancel:
+    default:
+      return;
+    }
+  });
+
+  std::ranges::sort(ready);
+  const auto duplicates = std::ranges::unique(ready);
+  ready.erase(duplicates.begin(), duplicates.end());
+
+  for (int fd : ready) {
+    auto it = reactor.connections.find(fd);
+    assert(it != reactor.connections.end());
+    Connection& connection = *it->second.connection;
+
+    serve_client(reactor, connection);
+    flush_connection(connection, reactor.comments);
+    finish_events(reactor, it);
+  }
+}
+
+/**
+ * @brief Replace failed io_uring instance with epoll. Its connections
+ * cannot receive or send anymore and are dropped, while new clients are
+ * accepted with epoll like when instance could not be created
+ */
+static void fail_over_to_epoll(Reactor& reactor) {
+  fprintf(stderr, "Reactor switches from io_uring to epoll\n");
+
+  for (auto it = reactor.connections.begin();
+       it != reactor.connections.end();) {
+    if (it->second.uring == nullptr) {
+      ++it;
+      continue;
+    }
+
+    const int fd = it->first;
+    reactor.waiting_durable.erase(fd);
+    reactor.paused_readers.erase(fd);
+    if (reactor.subscribers.erase(fd) > 0) {
+      reactor.push_target.subscribers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    it = reactor.connections.erase(it);
+    metrics::Metrics::add(metrics::Counter::ClosedConnections);
+  }
+
+  // Closing the instance cancels accept and requests still in flight
+  epoll_ctl(reactor.epoll, EPOLL_CTL_DEL, reactor.uring->getFd(), NULL);
+  reactor.uring = nullptr;
+  watch_fd(reactor.epoll, reactor.listener);
+}
+
+static void flush_durable(Reactor& reactor) {
+  uint64_t value = 0;
+  ssize_t res = read(reactor.durable_event, &value, sizeof(value));
+  (void) res;  // Spurious wakeup only costs one pass over waiting clients
+
+  std::vector<int> waiting(
+      reactor.waiting_durable.begin(), reactor.waiting_durable.end()
+  );
+  for (int fd : waiting) {
+    auto it = reactor.connections.find(fd);
+    assert(it != reactor.connections.end());
+
+    flush_connection(*it->second.connection, reactor.comments);
+    finish_events(reactor, it);
+  }
+}
+
+static void flush_connection(
+    Connection& connection,
+    const storage::CommentStore& comments
+) {
+  connection.flush();
+
+  // Subscriber is pushed more as soon as its output drains
+  while (connection.wantsPush(comments.size())) {
+    push_comments(connection, comments.snapshot());
+    connection.flush();
+    if (connection.hasPendingOutput()) {
       break;
     }
+  }
+}
 
-    const size_t actual_size = (size_t) res;
-    offset += actual_size;
-    read_size -= actual_size;
+/**
+ * @brief Wake up reactors with subscribers, except `origin`, after
+ * comments were stored
+ */
+static void signal_push_targets(
+    std::span<PushTarget> targets,
+    const PushTarget* origin
+) {
+  // Pairs with fence in `subscribe()`: either subscriber count is seen
+  // here, or stored comments are seen by subscriber's first push
+  std::atomic_thread_fence(std::memory_order_seq_cst);
 
-    // Partial read, continue reading
-    if (read_size > 0) {
+  for (PushTarget& target : targets) {
+    if (&target == origin ||
+        target.subscribers.load(std::memory_order_relaxed) == 0) {
       continue;
     }
 
-    size_t msg_size = 0;
-    auto msg = message::Message::fromBytes(
-        std::span(buffer.data(), offset),
-        msg_size
-    );
-    assert(msg_size > 0);
+    if (!target.signalled.exchange(true, std::memory_order_acq_rel)) {
+      uint64_t signal = 1;
+      ssize_t written = write(target.event, &signal, sizeof(signal));
+      assert(written == sizeof(signal));
+    }
+  }
+}
 
-    // Message has more bytes, continue reading
-    if (msg_size > offset) {
-      read_size = msg_size - offset;
-      if (buffer.size() < msg_size) {
-        buffer.resize(msg_size);
-      }
+static void signal_subscribers(Reactor& reactor) {
+  signal_push_targets(reactor.push_targets, &reactor.push_target);
+}
+
+static void receive_push_signal(Reactor& reactor) {
+  uint64_t value = 0;
+  ssize_t res = read(reactor.push_target.event, &value, sizeof(value));
+  (void) res;  // Spurious wakeup only costs one pass over subscribers
+
+  // Appends after this point signal again
+  reactor.push_target.signalled.exchange(false, std::memory_order_acq_rel);
+}
+
+static void push_subscribers(Reactor& reactor) {
+  if (reactor.subscribers.empty()) {
+    return;
+  }
+
+  const size_t stored = reactor.comments.size();
+  std::vector<int> subscribers(
+      reactor.subscribers.begin(), reactor.subscribers.end()
+  );
+  for (int fd : subscribers) {
+    auto it = reactor.connections.find(fd);
+    assert(it != reactor.connections.end());
+
+    Connection& connection = *it->second.connection;
+    if (!connection.wantsPush(stored)) {
       continue;
     }
 
-    read_size = message::Message::MinSize;
-    offset = 0;
-    buffer.assign(read_size, std::byte{});
+    flush_connection(connection, reactor.comments);
+    finish_events(reactor, it);
+  }
+}
+
+/**
+ * @brief Serve paused connections which may read again. Shared memory
+ * transport does not report requests which are already in its ring, so
+ * reactor cannot wait for readiness of such connections.
+ */
+static void resume_readers(Reactor& reactor) {
+  // Connections which are still paused set it again
+  reactor.resume_pending = false;
+  if (reactor.paused_readers.empty()) {
+    return;
+  }
 
-    auto message(std::move(*msg));
+  std::vector<int> paused(
+      reactor.paused_readers.begin(), reactor.paused_readers.end()
+  );
+  for (int fd : paused) {
+    auto it = reactor.connections.find(fd);
+    assert(it != reactor.connections.end());
+
+    Connection& connection = *it->second.connection;
+    if (!connection.wantsRead()) {
+      continue;
+    }
+
+    // One pass per turn, so that other connections are not starved
+    serve_client(reactor, connection);
+    flush_connection(connection, reactor.comments);
+    finish_events(reactor, it);
+  }
+}
+
+/**
+ * @brief Index comments stored by reactor since last call, taking index
+ * lock once for all of them. Search misses comments until then
+ */
+static void index_comments(Reactor& reactor) {
+  if (!reactor.index_pending) {
+    return;
+  }
+
+  reactor.index_pending = false;
+  reactor.search_index.update(reactor.comments.snapshot());
+}
+
+static void finish_events(Reactor& reactor, ConnectionMap::iterator it) {
+  Connection& connection = *it->second.connection;
+  const int fd = connection.getSocket();
+
+  if (connection.isClosed()) {
+    if (it->second.uring == nullptr) {
+      epoll_ctl(reactor.epoll, EPOLL_CTL_DEL, fd, NULL);
+    }
+    reactor.waiting_durable.erase(fd);
+    reactor.paused_readers.erase(fd);
+    if (reactor.subscribers.erase(fd) > 0) {
+      reactor.push_target.subscribers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    reactor.connections.erase(it);
+    metrics::Metrics::add(metrics::Counter::ClosedConnections);
+    return;
+  }
+
+  if (connection.isWaitingDurable()) {
+    reactor.waiting_durable.insert(fd);
+  } else {
+    reactor.waiting_durable.erase(fd);
+  }
+
+  if (connection.isReadPaused()) {
+    reactor.paused_readers.insert(fd);
+    reactor.resume_pending = reactor.resume_pending || connection.wantsRead();
+  } else {
+    reactor.paused_readers.erase(fd);
+  }
+
+  if (it->second.uring != nullptr) {
+    it->second.uring->setReceiving(connection.wantsRead());
+    return;
+  }
+
+  uint32_t events = 0;
+  if (connection.wantsRead()) {
+    events |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (connection.wantsWrite()) {
+    events |= connection.getWriteEvents();
+  }
+
+  // Avoid a syscall per event when interest did not change
+  if (events == it->second.events) {
+    return;
+  }
+
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+
+  int res = epoll_ctl(reactor.epoll, EPOLL_CTL_MOD, fd, &event);
+  assert(res == 0);
+  it->second.events = events;
+}
+
+static void add_comment(
+    Reactor& reactor,
+    Connection& connection,
+    message::NewCommentMessage message
+);
+static void add_comments_batch(
+    Reactor& reactor,
+    Connection& connection,
+    message::NewCommentsBatchMessage message
+);
+static void send_comments(
+    Connection& connection,
+    message::GetCommentsMessage message,
+    storage::CommentStore& comments,
+    ResponseCache& cache
+);
+static void send_comments_since(
+    Connection& connection,
+    message::GetCommentsSinceMessage message,
+    storage::CommentStore& comments
+);
+static void subscribe(
+    Reactor& reactor,
+    Connection& connection,
+    const message::SubscribeMessage& message
+);
+static void search_comments(
+    Reactor& reactor,
+    Connection& connection,
+    message::SearchCommentsMessage message
+);
+
+static void serve_client(Reactor& reactor, Connection& connection) {
+  storage::CommentStore& comments = reactor.comments;
+
+  while (auto msg = connection.receive()) {
+    message::MessageView message = *msg;
 
     using Type = message::Message::Type;
-    
+    metrics::Metrics::countFrame(message.getType());
+
+    // Follower only stores comments of its leader
+    const bool is_write =
+      message.getType() == Type::NewComment ||
+      message.getType() == Type::NewCommentsBatch;
+    if (is_write && reactor.follower != nullptr) {
+      connection.close();
+      break;
+    }
+
+    // Comments stored after log failure could never be acknowledged, yet
+    // would be served to readers and lost on restart
+    if (is_write && comments.isDurabilityLost()) {
+      metrics::Metrics::add(metrics::Counter::RejectedWrites);
+      connection.close();
+      break;
+    }
+
     switch (message.getType()) {
     case Type::NewComment:
       add_comment(
-          socket,
-          *message::NewCommentMessage::fromMessage(std::move(message)),
-          comments
+          reactor, connection, *message::NewCommentMessage::fromView(message)
       );
       break;
+    case Type::NewCommentsBatch: {
+      auto batch = message::NewCommentsBatchMessage::fromView(message);
+      if (!batch.has_value()) {
+        metrics::Metrics::add(metrics::Counter::MalformedFrames);
+        connection.close();
+        break;
+      }
+      add_comments_batch(reactor, connection, std::move(*batch));
+      break;
+    }
     case Type::CommentsRequest:
       send_comments(
-          socket,
-          *message::GetCommentsMessage::fromMessage(std::move(message)),
+          connection,
+          *message::GetCommentsMessage::fromView(message),
+          comments,
+          reactor.response_cache
+      );
+      break;
+    case Type::CommentsSinceRequest:
+      send_comments_since(
+          connection,
+          *message::GetCommentsSinceMessage::fromView(message),
           comments
       );
       break;
+    case Type::Subscribe:
+    case Type::Replicate:
+      subscribe(
+          reactor,
+          connection,
+          *message::SubscribeMessage::fromView(message)
+      );
+      break;
+    case Type::Hello: {
+      uint32_t agreed = SupportedCapabilities
+        & message::HelloMessage::fromView(message)->getCapabilities();
+      connection.setCapabilities(agreed);
+      connection.setAuthor(
+          message::HelloMessage::fromView(message)->getAuthor()
+      );
+      connection.send(message::Message::hello(agreed));
+      break;
+    }
     case Type::Goodbye:
-      conn_closed = true;
+      connection.close();
+      break;
+    case Type::GetStats:
+      send_stats(reactor, connection);
+      break;
+    case Type::SearchComments:
+      search_comments(
+          reactor,
+          connection,
+          *message::SearchCommentsMessage::fromView(message)
+      );
       break;
-    case Type::Hello:
     case Type::CommentOk:
     case Type::CommentsResponse:
+    case Type::CommentsBatchOk:
+    case Type::IndexedCommentsResponse:
+    case Type::CommentsPush:
+    case Type::Stats:
+    case Type::SearchResults:
+    case Type::AnnotatedCommentsResponse:
+    case Type::ReplicatedComments:
     default:
-      assert(0 && "Unexpected message");
+      // Unexpected message, drop client
+      connection.close();
       break;
     }
   }
-  close(socket);
 }
 
 static void add_comment(
-    int socket,
-    message::NewCommentMessage message,
-    std::vector<std::string> &comments
+    Reactor& reactor,
+    Connection& connection,
+    message::NewCommentMessage message
+) {
+  size_t index = 0;
+  {
+    metrics::SampledTimer timer(metrics::Distribution::AppendLatency);
+    index = reactor.comments.append(
+        message.getComment(), connection.getAuthor()
+    );
+  }
+  metrics::Metrics::add(metrics::Counter::StoredComments);
+  reactor.index_pending = true;
+
+  // Acknowledge only once comment is safely stored
+  connection.sendDurable(message::Message::commentOk(), index + 1);
+}
+
+static void add_comments_batch(
+    Reactor& reactor,
+    Connection& connection,
+    message::NewCommentsBatchMessage message
+) {
+  size_t first = 0;
+  {
+    metrics::SampledTimer timer(metrics::Distribution::AppendLatency);
+    first = reactor.comments.appendBatch(
+        message.getComments(), connection.getAuthor()
+    );
+  }
+  size_t count = message.getCount();
+  metrics::Metrics::add(metrics::Counter::StoredComments, count);
+  reactor.index_pending = true;
+
+  connection.sendDurable(
+      message::Message::commentsBatchOk(first, count),
+      first + count
+  );
+}
+
+/**
+ * @brief Shrink page [`index`, `end`) to fit into `max_bytes`, always
+ * keeping at least one comment, so that client makes progress
+ *
+ * @return Size of NUL-terminated comments in page
+ */
+static size_t fit_page(
+    const storage::CommentStore::Snapshot& snapshot,
+    size_t index,
+    size_t& end,
+    size_t max_bytes
 ) {
-  auto raw_comment = message.getComment();
-  std::string comment( raw_comment.begin(), raw_comment.end());
-  comments.emplace_back(std::move(comment));
+  size_t comments_size = 0;
+  for (size_t i = index; i < end; ++i) {
+    size_t size = snapshot.terminated(i).size();
+    if (i > index && comments_size + size > max_bytes) {
+      end = i;
+      break;
+    }
+    comments_size += size;
+  }
 
-  auto response = message::Message::commentOk();
-  auto bytes = response.getBytes();
+  // Every page is fitted before it is sent
+  snapshot.noteRead(index, end, comments_size);
+  return comments_size;
+}
 
-  int sent = send(socket, bytes.data(), bytes.size(), 0);
-  assert(sent > 0);
-  assert((size_t) sent == bytes.size());
+/**
+ * @brief Message made of `prefix`, `table` and comments of snapshot at
+ * `indices`, assembled in one buffer
+ */
+template <typename Indices>
+static std::vector<std::byte> assemble_page(
+    const storage::CommentStore::Snapshot& snapshot,
+    std::span<const std::byte> prefix,
+    std::span<const std::byte> table,
+    const Indices& indices,
+    size_t comments_size
+) {
+  std::vector<std::byte> frame(prefix.size() + table.size() + comments_size);
+  std::byte* position = frame.data();
+  position = std::ranges::copy(prefix, position).out;
+  position = std::ranges::copy(table, position).out;
+  for (size_t i : indices) {
+    position = std::ranges::copy(
+        std::as_bytes(snapshot.terminated(i)), position
+    ).out;
+  }
+  return frame;
+}
+
+/**
+ * @brief Queue message made of `prefix`, `table` and comments of snapshot
+ * at `indices`, held back until `gate` comments are durable
+ */
+template <typename Indices>
+static void queue_page(
+    Connection& connection,
+    const storage::CommentStore::Snapshot& snapshot,
+    std::span<const std::byte> prefix,
+    std::span<const std::byte> table,
+    const Indices& indices,
+    size_t comments_size,
+    size_t gate
+) {
+  // Compressor needs contiguous input, so large page is assembled first
+  if (connection.compresses() && comments_size >= message::CompressionThreshold) {
+    connection.queueFrame(
+        assemble_page(snapshot, prefix, table, indices, comments_size), gate
+    );
+    return;
+  }
+
+  connection.queue(prefix, gate);
+  connection.queue(table);
+
+  // Comments are stored NUL-terminated, so they are sent straight from store
+  for (size_t i : indices) {
+    connection.queueRef(std::as_bytes(snapshot.terminated(i)));
+  }
+}
+
+/**
+ * @brief Response with comments [`index`, `end`), apart from comment bytes
+ */
+struct Page {
+  size_t index;
+  size_t end;
+  size_t comments_size;
+  message::Message::CommentsResponsePrefix prefix;
+  std::vector<std::byte> table;
+};
+
+/**
+ * @brief Page with comments from `index` on, within limits requested by
+ * client
+ */
+static Page make_page(
+    const storage::CommentStore::Snapshot& snapshot,
+    size_t index,
+    size_t max_count,
+    size_t max_bytes,
+    message::Message::ResponseEncoding encoding
+) {
+  size_t total = snapshot.size();
+  size_t end = index < total ? total : index;
+
+  if (max_count != 0 && end - index > max_count) {
+    end = index + max_count;
+  }
+
+  if (max_bytes == 0 || max_bytes > MaxResponseBytes) {
+    max_bytes = MaxResponseBytes;
+  }
+
+  size_t comments_size = fit_page(snapshot, index, end, max_bytes);
+
+  // Table is filled in one buffer, without touching comment bytes
+  std::vector<std::byte> table(
+      message::Message::commentTableSize(end - index, encoding)
+  );
+  message::Message::writeCommentTable(
+      snapshot, index, end - index, encoding, table
+  );
+
+  return Page{
+    .index = index,
+    .end = end,
+    .comments_size = comments_size,
+    .prefix = message::Message::sendCommentsPrefix(
+        total, end - index, end, comments_size, encoding
+    ),
+    .table = std::move(table)
+  };
+}
+
+/**
+ * @brief Queue response made of `page`, without assembling it
+ */
+static void queue_whole_page(
+    Connection& connection,
+    const storage::CommentStore::Snapshot& snapshot,
+    const Page& page
+) {
+  // Replies agree with pushes and replication, which wait for durability.
+  // Page past the last comment is empty and waits for nothing
+  queue_page(
+      connection, snapshot, page.prefix, page.table,
+      std::views::iota(page.index, page.end), page.comments_size,
+      std::min(page.end, snapshot.size())
+  );
+}
+
+/**
+ * @brief Queue response with comments from `index` on, within limits
+ * requested by client
+ */
+static void send_page(
+    Connection& connection,
+    const storage::CommentStore::Snapshot& snapshot,
+    size_t index,
+    size_t max_count,
+    size_t max_bytes,
+    message::Message::ResponseEncoding encoding
+) {
+  queue_whole_page(
+      connection, snapshot,
+      make_page(snapshot, index, max_count, max_bytes, encoding)
+  );
 }
 
 static void send_comments(
-    int socket,
+    Connection& connection,
     message::GetCommentsMessage message,
-    std::vector<std::string> &comments
+    storage::CommentStore& comments,
+    ResponseCache& cache
+) {
+  using Encoding = message::Message::ResponseEncoding;
+
+  Encoding encoding = message.getEncoding();
+  if (encoding != Encoding::Indexed && encoding != Encoding::Annotated) {
+    encoding = Encoding::Plain;
+  }
+
+  auto snapshot = comments.snapshot();
+
+  // Response carries total number of comments, so store size versions it
+  const ResponseCache::Key key = {
+    .start_index = (uint32_t) message.getStartIndex(),
+    .max_count = (uint32_t) message.getMaxCount(),
+    .max_bytes = (uint32_t) message.getMaxBytes(),
+    .encoding = (uint32_t) encoding,
+    .compressed = connection.compresses()
+  };
+
+  bool admit = false;
+  ResponseCache::Frame cached = cache.find(key, snapshot.size(), admit);
+  // Cached frame does not tell which comments it holds, so it waits for
+  // every comment of its version to become durable
+  if (cached != nullptr) {
+    metrics::Metrics::add(metrics::Counter::ResponseCacheHits);
+    connection.queueShared(std::move(cached), snapshot.size());
+    return;
+  }
+  metrics::Metrics::add(metrics::Counter::ResponseCacheMisses);
+
+  if (!admit) {
+    send_page(
+        connection, snapshot, key.start_index, key.max_count, key.max_bytes,
+        encoding
+    );
+    return;
+  }
+
+  Page page = make_page(
+      snapshot, key.start_index, key.max_count, key.max_bytes, encoding
+  );
+
+  // Page too large for cache is sent from store, instead of being assembled
+  // and compressed only to be rejected. Compression may shrink frame below
+  // the limit, but is not attempted for that
+  const size_t frame_size =
+    page.prefix.size() + page.table.size() + page.comments_size;
+  if (!cache.admits(frame_size)) {
+    queue_whole_page(connection, snapshot, page);
+    return;
+  }
+
+  std::vector<std::byte> frame = assemble_page(
+      snapshot, page.prefix, page.table,
+      std::views::iota(page.index, page.end), page.comments_size
+  );
+
+  // Cached frame is sent as is, so it is compressed once for all
+  // connections which negotiated compression
+  if (key.compressed) {
+    std::vector<std::byte> compressed;
+    if (message::Compression::compressFrame(frame, compressed)) {
+      frame = std::move(compressed);
+    }
+  }
+
+  auto shared = std::make_shared<const std::vector<std::byte>>(
+      std::move(frame)
+  );
+  cache.insert(key, snapshot.size(), shared);
+  connection.queueShared(std::move(shared), snapshot.size());
+}
+
+static void send_comments_since(
+    Connection& connection,
+    message::GetCommentsSinceMessage message,
+    storage::CommentStore& comments
+) {
+  auto snapshot = comments.snapshot();
+
+  send_page(
+      connection, snapshot, snapshot.findTime(message.getSince()),
+      message.getMaxCount(), message.getMaxBytes(),
+      message::Message::ResponseEncoding::Annotated
+  );
+}
+
+static void push_comments(
+    Connection& connection,
+    const storage::CommentStore::Snapshot& snapshot
+) {
+  const size_t total = snapshot.size();
+
+  while (connection.wantsPush(total)) {
+    size_t index = connection.getPushIndex();
+    size_t end = total;
+    size_t comments_size = fit_page(snapshot, index, end, MaxResponseBytes);
+
+    // Followers get metadata of comments, so that they store them as is
+    std::vector<std::byte> table;
+    auto prefix = message::Message::pushCommentsPrefix(
+        total, end - index, end, comments_size
+    );
+    if (connection.isReplica()) {
+      using Encoding = message::Message::ResponseEncoding;
+
+      table.resize(message::Message::commentTableSize(
+          end - index, Encoding::Annotated
+      ));
+      message::Message::writeCommentTable(
+          snapshot, index, end - index, Encoding::Annotated, table
+      );
+      prefix = message::Message::replicatedCommentsPrefix(
+          total, end - index, end, comments_size
+      );
+    }
+
+    // Subscribers only see comments which survive restart
+    queue_page(
+        connection, snapshot, prefix, table, std::views::iota(index, end),
+        comments_size, end
+    );
+    connection.setPushIndex(end);
+  }
+}
+
+static void subscribe(
+    Reactor& reactor,
+    Connection& connection,
+    const message::SubscribeMessage& message
+) {
+  if (reactor.subscribers.insert(connection.getSocket()).second) {
+    reactor.push_target.subscribers.fetch_add(1, std::memory_order_relaxed);
+
+    // Pairs with fence in `signal_subscribers()`
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  auto snapshot = reactor.comments.snapshot();
+  const size_t index = message.getStartIndex();
+  connection.subscribe(index, message.isReplication());
+
+  // First push confirms subscription even if there is nothing to push yet
+  if (!connection.wantsPush(snapshot.size())) {
+    connection.queue(
+        message.isReplication()
+        ? message::Message::replicatedCommentsPrefix(
+            snapshot.size(), 0, index, 0
+          )
+        : message::Message::pushCommentsPrefix(snapshot.size(), 0, index, 0)
+    );
+    return;
+  }
+
+  push_comments(connection, snapshot);
+}
+
+static void search_comments(
+    Reactor& reactor,
+    Connection& connection,
+    message::SearchCommentsMessage message
 ) {
-  size_t index = message.getStartIndex();
-  size_t total = comments.size();
-  size_t count = index < total ? total - index : 0;
+  size_t max_count = message.getMaxCount();
+  if (max_count == 0 || max_count > MaxSearchResults) {
+    max_count = MaxSearchResults;
+  }
+
+  // Client finds comments it stored earlier in this turn
+  index_comments(reactor);
+
+  std::vector<uint32_t> results;
+  size_t next = reactor.search_index.search(
+      message.getQuery(), message.getStartIndex(), max_count, results
+  );
+
+  // Index never runs ahead of store, so all results are in snapshot
+  auto snapshot = reactor.comments.snapshot();
+
+  // Keep at least one result, so that client makes progress
+  size_t comments_size = 0;
+  size_t count = 0;
+  for (; count < results.size(); ++count) {
+    size_t size = snapshot.terminated(results[count]).size();
+    if (count > 0 && comments_size + size > MaxResponseBytes) {
+      next = results[count];
+      break;
+    }
+    comments_size += size;
+    snapshot.noteRead(results[count], results[count] + 1, size);
+  }
+  results.resize(count);
+
+  auto prefix =
+    message::Message::searchResultsPrefix(count, next, comments_size);
+
+  std::vector<uint32_t> indices;
+  indices.reserve(count);
+  for (uint32_t index : results) {
+    indices.push_back(htonl(index));
+  }
+
+  // Index may run ahead of durable comments
+  queue_page(
+      connection, snapshot, prefix, std::as_bytes(std::span(indices)),
+      results, comments_size, results.empty() ? 0 : results.back() + 1
+  );
+}
+
+static void send_stats(Reactor& reactor, Connection& connection) {
+  size_t subscribers = 0;
+  for (const PushTarget& target : reactor.push_targets) {
+    subscribers += target.subscribers.load(std::memory_order_relaxed);
+  }
+
+  std::vector<metrics::Gauge> gauges = {
+    {
+      "comments", "Comments in store",
+      (double) reactor.comments.size()
+    },
+    {
+      "durable_comments", "Comments which survive restart",
+      (double) reactor.comments.durableSize()
+    },
+    {
+      "log_failed", "Writing comment log failed, new comments are dropped",
+      (double) reactor.comments.isDurabilityLost()
+    },
+    {
+      "hot_bytes", "Memory of stored comments kept resident",
+      (double) reactor.comments.getHotBytes()
+    },
+    {
+      "cold_bytes", "Memory of stored comments served from page cache",
+      (double) reactor.comments.getColdBytes()
+    },
+    {
+      "subscribers", "Connections subscribed to new comments",
+      (double) subscribers
+    },
+    {
+      "reactors", "Event loop threads",
+      (double) reactor.push_targets.size()
+    },
+  };
 
-  auto response = message::Message::sendComments(comments, index, count);
-  auto bytes = response.getBytes();
+  if (const Follower* follower = reactor.follower) {
+    gauges.push_back({
+        "leader_connected", "Follower is connected to its leader",
+        (double) follower->isConnected()
+    });
+    gauges.push_back({
+        "replication_diverged",
+        "Leader lacks comments follower has, so nothing is replicated",
+        (double) follower->isDiverged()
+    });
+    gauges.push_back({
+        "replication_lag_comments",
+        "Comments of leader not replicated yet, as of its last push",
+        (double) follower->getLagComments()
+    });
+    gauges.push_back({
+        "replication_delay_seconds",
+        "Time from leader storing last replicated comment to follower "
+        "storing it",
+        (double) follower->getDelayUs() * 1e-6
+    });
+  }
 
-  int sent = send(socket, bytes.data(), bytes.size(), 0);
-  assert(sent > 0);
-  assert((size_t) sent == bytes.size());
+  connection.send(message::Message::stats(metrics::Metrics::format(gauges)));
 }
 
 } // namespace server
@@ -12,10 +12,79 @@
 #ifndef __SERVER_TCP_SERVER_HPP
 #define __SERVER_TCP_SERVER_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
+
+#include "Storage/CommentLog.hpp"
+#include "Storage/TieredArena.hpp"
+
 namespace server {
 
-void listen_tcp(uint8_t ip_address[4], uint16_t port);
+/**
+ * @brief How reactors wait for socket I/O
+ */
+enum class IoBackend {
+  Epoll,    // Readiness notifications, reads and writes are syscalls
+  IoUring,  // Multishot accepts and receives, sends batched per turn
+  Auto,     // Resolved with `select_io_backend()` when server starts
+};
+
+struct ServerConfig {
+  // Number of event loop threads. Each reactor owns a listening socket
+  // bound with SO_REUSEPORT
+  size_t reactor_count = 1;
+
+  // Directory of durable comment log. Comments are kept in memory only
+  // if empty
+  std::string log_directory = "";
+  storage::CommentLogOptions log_options = {};
+
+  // Placement of comments in memory. With cold directory set, old comments
+  // and comments recovered from log are served from page cache
+  storage::TieredArenaOptions arena_options = {};
+
+  // Memory of serialized GetComments responses, which are sent again while
+  // store does not change, split evenly between reactors. Zero disables
+  // caching
+  size_t response_cache_bytes = 64 * 1024 * 1024;
+
+  // Unix socket accepting clients on the same host, which then talk to
+  // server through shared memory. Not created if null
+  const char* shm_path = nullptr;
+
+  // Backend of TCP connections, io_uring must be supported by kernel.
+  // Callers which already resolved it with `select_io_backend()` pass the
+  // result, so that kernel is probed once. Shared memory connections are
+  // always served with epoll
+  IoBackend io_backend = IoBackend::Auto;
+
+  // Leader server to follow if port is not zero. Follower stores only
+  // comments replicated from leader and drops clients which send comments
+  uint8_t leader_address[4] = { 0, 0, 0, 0 };
+  uint16_t leader_port = 0;
+};
+
+/**
+ * @brief Backend server actually uses when `preferred` is requested:
+ * io_uring is used if kernel supports it, and epoll otherwise
+ */
+IoBackend select_io_backend(IoBackend preferred);
+
+/**
+ * @brief Serve clients on given address until SIGINT is received
+ *
+ * @param[in] ip_address      IPv4 address to listen on
+ * @param[in] port            TCP port to listen on
+ * @param[in] config          Server configuration
+ *
+ * @return Server was started. Otherwise reason is reported to `stderr`
+ */
+bool listen_tcp(
+    uint8_t ip_address[4],
+    uint16_t port,
+    const ServerConfig& config = {}
+);
 
 } // namespace server
 
@@ -0,0 +1,733 @@
+#include "CommentLog.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+namespace storage {
+
+struct RecordHeader {
+  uint32_t size;
+  uint32_t checksum;
+};
+
+static_assert(sizeof(RecordHeader) % alignof(CommentRecord) == 0);
+
+static constexpr size_t SegmentNameLength = 20 + 5;  // 20 digits and ".clog"
+static constexpr size_t LegacyNameLength = 20 + 4;   // 20 digits and ".log"
+static constexpr const char* MigrationMarker = "MIGRATING";
+
+static constexpr std::array<uint32_t, 256> make_crc_table(void) {
+  constexpr uint32_t Polynomial = 0x82F63B78;  // CRC-32C, reversed
+  std::array<uint32_t, 256> table = {};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+static constexpr std::array<uint32_t, 256> CrcTable = make_crc_table();
+
+static uint32_t crc32c_table(std::span<const char> bytes) {
+  uint32_t crc = ~uint32_t(0);
+  for (char c : bytes) {
+    crc = CrcTable[(crc ^ (uint8_t) c) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+#ifdef __x86_64__
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(std::span<const char> bytes) {
+  const char* data = bytes.data();
+  const size_t size = bytes.size();
+
+  uint64_t crc = ~uint32_t(0);
+  size_t position = 0;
+  for (; position + sizeof(uint64_t) <= size; position += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, data + position, sizeof(word));
+    crc = _mm_crc32_u64(crc, word);
+  }
+
+  uint32_t tail_crc = (uint32_t) crc;
+  for (; position < size; ++position) {
+    tail_crc = _mm_crc32_u8(tail_crc, (uint8_t) data[position]);
+  }
+  return ~tail_crc;
+}
+
+#endif
+
+using CrcFunction = uint32_t (*)(std::span<const char>);
+
+static CrcFunction select_crc_function(void) {
+#ifdef __x86_64__
+  if (__builtin_cpu_supports("sse4.2")) {
+    return crc32c_sse42;
+  }
+#endif
+  return crc32c_table;
+}
+
+static uint32_t crc32c(std::span<const char> bytes) {
+  static const CrcFunction crc = select_crc_function();
+  return crc(bytes);
+}
+
+static std::string segment_name(
+    size_t first_index,
+    const char* extension = ".clog"
+) {
+  char name[SegmentNameLength + 1] = "";
+  snprintf(name, sizeof(name), "%020zu%s", first_index, extension);
+  return name;
+}
+
+static void report_error(const char* action, const std::string& path) {
+  fprintf(stderr, "Comment log: cannot %s %s: %s\n",
+      action, path.c_str(), strerror(errno));
+}
+
+static bool write_all(int fd, std::span<const std::byte> bytes) {
+  size_t written = 0;
+  while (written < bytes.size()) {
+    ssize_t res = write(fd, bytes.data() + written, bytes.size() - written);
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    if (res <= 0) {
+      errno = res == 0 ? ENOSPC : errno;
+      return false;
+    }
+    written += (size_t) res;
+  }
+  return true;
+}
+
+/**
+ * @brief Rename file which recovery cannot use to `*.orphan`, leaving it for
+ * operator to restore or remove
+ */
+static bool set_aside(const std::filesystem::path& path) {
+  const std::string target = path.string() + ".orphan";
+  if (access(target.c_str(), F_OK) == 0) {
+    fprintf(stderr,
+        "Comment log: %s is left by previous recovery. Restore or remove it "
+        "before starting\n",
+        target.c_str()
+    );
+    return false;
+  }
+  if (rename(path.c_str(), target.c_str()) != 0) {
+    report_error("rename", path.string());
+    return false;
+  }
+
+  fprintf(stderr,
+      "Comment log: comments of %s are not recovered, file is kept as %s\n",
+      path.c_str(), target.c_str()
+  );
+  return true;
+}
+
+/**
+ * @brief Save bytes discarded from segment to `*.orphan` file
+ */
+static bool save_aside(const std::string& path, std::span<const char> bytes) {
+  const std::string target = path + ".orphan";
+  int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    report_error("create", target);
+    return false;
+  }
+  bool written = write_all(fd, std::as_bytes(bytes)) && fdatasync(fd) == 0;
+  close(fd);
+  if (!written) {
+    report_error("write", target);
+    return false;
+  }
+
+  fprintf(stderr,
+      "Comment log: damaged end of %s is not recovered, it is kept as %s\n",
+      path.c_str(), target.c_str()
+  );
+  return true;
+}
+
+static bool sync_directory(const std::string& directory) {
+  int dir = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir < 0) {
+    return false;
+  }
+  int res = fsync(dir);
+  close(dir);
+  return res == 0;
+}
+
+/**
+ * @brief Append record of comment without metadata, laid out as current
+ * segments expect
+ */
+static void append_legacy_record(
+    std::vector<std::byte>& out,
+    std::span<const char> text
+) {
+  const size_t start = out.size();
+  const size_t record_size = CommentRecord::allocSize(text.size());
+  out.resize(start + sizeof(RecordHeader) + record_size, std::byte{0});
+
+  std::byte* record = out.data() + start + sizeof(RecordHeader);
+  const uint32_t size = (uint32_t) text.size();
+  std::memcpy(record + offsetof(CommentRecord, size), &size, sizeof(size));
+  std::memcpy(record + sizeof(CommentRecord), text.data(), text.size());
+
+  const RecordHeader header = {
+    .size = size,
+    .checksum = crc32c(std::span(
+        reinterpret_cast<const char*>(record),
+        sizeof(CommentRecord) + text.size() + 1
+    ))
+  };
+  std::memcpy(out.data() + start, &header, sizeof(header));
+}
+
+/**
+ * @brief Convert records of legacy segment, laid out as
+ *
+ *    | uint32_t size | uint32_t crc32c | comment | '\0' |
+ *
+ * where checksum covers comment only
+ *
+ * @return Number of converted records. Segment ended with damaged record if
+ * not all of `bytes` were converted, which is reported in `intact`
+ */
+static size_t convert_legacy_segment(
+    std::span<const char> bytes,
+    bool verify,
+    std::vector<std::byte>& out,
+    bool& intact
+) {
+  size_t count = 0;
+  size_t offset = 0;
+  while (offset + sizeof(RecordHeader) <= bytes.size()) {
+    RecordHeader header;
+    std::memcpy(&header, bytes.data() + offset, sizeof(header));
+
+    const size_t record_size = sizeof(header) + header.size + 1;
+    if (record_size > bytes.size() - offset) {
+      break;
+    }
+
+    auto text = bytes.subspan(offset + sizeof(header), header.size);
+    if (bytes[offset + record_size - 1] != '\0') {
+      break;
+    }
+    if (verify && crc32c(text) != header.checksum) {
+      break;
+    }
+
+    append_legacy_record(out, text);
+    offset += record_size;
+    ++count;
+  }
+
+  intact = offset == bytes.size();
+  return count;
+}
+
+CommentLog::CommentLog(std::string directory, CommentLogOptions options)
+  : m_directory(std::move(directory)),
+    m_options(options) {
+  std::filesystem::create_directories(m_directory);
+  m_committer = std::thread(&CommentLog::runCommitter, this);
+}
+
+CommentLog::~CommentLog() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopping = true;
+  }
+  m_pending_cv.notify_one();
+  m_committer.join();
+
+  if (m_segment_fd >= 0) {
+    close(m_segment_fd);
+  }
+  for (const Mapping& mapping : m_mappings) {
+    munmap(mapping.address, mapping.size);
+  }
+}
+
+bool CommentLog::recover(
+    const std::function<void(const CommentRecord&)>& on_comment
+) {
+  if (!migrateLegacy()) {
+    return false;
+  }
+
+  std::vector<std::filesystem::path> segments;
+  for (const auto& entry : std::filesystem::directory_iterator(m_directory)) {
+    const auto name = entry.path().filename().string();
+    if (name.size() == SegmentNameLength && name.ends_with(".clog")) {
+      segments.push_back(entry.path());
+    }
+  }
+  // Zero-padded names sort in index order
+  std::sort(segments.begin(), segments.end());
+
+  std::lock_guard lock(m_mutex);
+  assert(m_appended == 0);
+
+  size_t count = 0;
+  bool log_ended = false;
+  bool set_any_aside = false;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const std::string path = segments[i].string();
+
+    if (log_ended || segments[i].filename() != segment_name(count)) {
+      // Segment after damaged one cannot be trusted
+      log_ended = true;
+      if (!set_aside(segments[i])) {
+        return false;
+      }
+      set_any_aside = true;
+      continue;
+    }
+
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      report_error("open", path);
+      return false;
+    }
+    const size_t size = (size_t) info.st_size;
+
+    const char* bytes = nullptr;
+    if (size > 0) {
+      void* address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (address == MAP_FAILED) {
+        report_error("map", path);
+        close(fd);
+        return false;
+      }
+      madvise(address, size, MADV_SEQUENTIAL);
+      m_mappings.push_back(Mapping{ address, size });
+      bytes = static_cast<const char*>(address);
+    }
+
+    // Sealed segments were synced before the next one was created, so only
+    // the last segment may contain torn records and needs full checksums
+    const bool is_last = (i + 1 == segments.size());
+
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= size) {
+      RecordHeader header;
+      std::memcpy(&header, bytes + offset, sizeof(header));
+
+      const size_t record_size =
+        sizeof(header) + CommentRecord::allocSize(header.size);
+      if (record_size > size - offset) {
+        break;
+      }
+
+      // Mapping is page-aligned and record sizes keep records aligned
+      const CommentRecord& comment = *reinterpret_cast<const CommentRecord*>(
+          bytes + offset + sizeof(header)
+      );
+      if (comment.size != header.size || comment.text[header.size] != '\0') {
+        break;
+      }
+      if (is_last && crc32c(comment.getBytes()) != header.checksum) {
+        break;
+      }
+
+      on_comment(comment);
+      offset += record_size;
+      ++count;
+    }
+
+    if (offset < size) {
+      // Torn record is expected at the end of the log only
+      log_ended = true;
+      auto tail = std::span(bytes, size).subspan(offset);
+      if (!is_last && !save_aside(path, tail)) {
+        close(fd);
+        return false;
+      }
+      if (ftruncate(fd, (off_t) offset) != 0) {
+        report_error("truncate", path);
+        close(fd);
+        return false;
+      }
+    }
+
+    if (i + 1 == segments.size() || log_ended) {
+      m_segment_fd = fd;
+      m_segment_path = path;
+      m_segment_bytes = offset;
+      lseek(fd, (off_t) offset, SEEK_SET);
+    } else {
+      close(fd);
+    }
+  }
+
+  if (set_any_aside && !sync_directory(m_directory)) {
+    report_error("sync", m_directory);
+    return false;
+  }
+
+  m_written = count;
+  m_appended = count;
+  m_durable.store(count, std::memory_order_release);
+  return true;
+}
+
+bool CommentLog::migrateLegacy(void) {
+  namespace fs = std::filesystem;
+
+  std::vector<fs::path> legacy;
+  std::vector<fs::path> current;
+  for (const auto& entry : fs::directory_iterator(m_directory)) {
+    const auto name = entry.path().filename().string();
+    if (name.size() == LegacyNameLength && name.ends_with(".log")) {
+      legacy.push_back(entry.path());
+    } else if (name.ends_with(".clog.tmp")) {
+      fs::remove(entry.path());
+    } else if (name.size() == SegmentNameLength && name.ends_with(".clog")) {
+      current.push_back(entry.path());
+    }
+  }
+
+  // Marker without legacy segments is left by finished conversion
+  const std::string marker = m_directory + "/" + MigrationMarker;
+  if (legacy.empty()) {
+    fs::remove(marker);
+    return true;
+  }
+  std::sort(legacy.begin(), legacy.end());
+
+  if (fs::exists(marker)) {
+    // Segments of interrupted conversion only repeat legacy ones
+    for (const fs::path& segment : current) {
+      fs::remove(segment);
+    }
+  } else if (!current.empty()) {
+    fprintf(stderr,
+        "Comment log: %s holds segments of both previous (*.log) and "
+        "current (*.clog) format. Move one of them away before starting\n",
+        m_directory.c_str()
+    );
+    return false;
+  } else {
+    int fd = open(marker.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || close(fd) != 0 || !sync_directory(m_directory)) {
+      report_error("create", marker);
+      return false;
+    }
+  }
+
+  size_t count = 0;
+  size_t intact_segments = 0;
+  bool intact = true;
+  std::vector<std::byte> converted;
+  for (size_t i = 0; i < legacy.size() && intact; ++i) {
+    if (legacy[i].filename() != segment_name(count, ".log")) {
+      break;
+    }
+
+    const std::string path = legacy[i].string();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      report_error("open", path);
+      return false;
+    }
+
+    const size_t size = (size_t) info.st_size;
+    void* address = size > 0
+      ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)
+      : nullptr;
+    close(fd);
+    if (address == MAP_FAILED) {
+      report_error("map", path);
+      return false;
+    }
+
+    // As in recovery, only the last segment may hold torn records
+    converted.clear();
+    const size_t first_index = count;
+    count += convert_legacy_segment(
+        std::span(static_cast<const char*>(address), size),
+        i + 1 == legacy.size(), converted, intact
+    );
+    if (address != nullptr) {
+      munmap(address, size);
+    }
+
+    const std::string target = m_directory + "/" + segment_name(first_index);
+    const std::string temporary = target + ".tmp";
+    fd = open(
+        temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+    );
+    bool written = fd >= 0 && write_all(fd, converted) && fdatasync(fd) == 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!written || rename(temporary.c_str(), target.c_str()) != 0) {
+      report_error("write", target);
+      return false;
+    }
+    intact_segments += intact;
+  }
+
+  if (!sync_directory(m_directory)) {
+    report_error("sync", m_directory);
+    return false;
+  }
+
+  // Legacy segments left after marker make next start refuse both formats,
+  // while marker left after legacy segments would drop converted ones
+  fs::remove(marker);
+  if (!sync_directory(m_directory)) {
+    report_error("sync", m_directory);
+    return false;
+  }
+
+  // Damaged segment and ones after it are set aside, as recovery would do
+  for (size_t i = 0; i < legacy.size(); ++i) {
+    if (i < intact_segments) {
+      fs::remove(legacy[i]);
+    } else if (!set_aside(legacy[i])) {
+      return false;
+    }
+  }
+  if (!sync_directory(m_directory)) {
+    report_error("sync", m_directory);
+    return false;
+  }
+
+  printf("Converted %zu comments of %s to current log format\n",
+      count, m_directory.c_str());
+  return true;
+}
+
+std::vector<std::span<const char>> CommentLog::getMappings(void) const {
+  std::vector<std::span<const char>> mappings;
+  for (const Mapping& mapping : m_mappings) {
+    mappings.emplace_back(
+        static_cast<const char*>(mapping.address), mapping.size
+    );
+  }
+  return mappings;
+}
+
+void CommentLog::append(const CommentRecord& comment) {
+  stageRecord(comment);
+  queueStaged(1);
+}
+
+void CommentLog::appendBatch(std::span<const CommentRecord* const> comments) {
+  if (comments.empty()) {
+    return;
+  }
+
+  for (const CommentRecord* comment : comments) {
+    stageRecord(*comment);
+  }
+  queueStaged(comments.size());
+}
+
+bool CommentLog::waitForSpace(std::unique_lock<std::mutex>& lock) {
+  // Batch above the limit is still taken once queue is short enough
+  m_space_cv.wait(lock, [this] {
+    return m_pending.size() < m_options.max_pending_bytes
+      || m_stopping || hasFailed();
+  });
+  return !hasFailed();
+}
+
+void CommentLog::stageRecord(const CommentRecord& comment) {
+  RecordHeader header;
+  header.size = comment.size;
+  header.checksum = crc32c(comment.getBytes());
+
+  auto header_bytes = std::as_bytes(std::span(&header, 1));
+  auto comment_bytes = std::as_bytes(comment.getBytes());
+
+  m_staged.insert(m_staged.end(), header_bytes.begin(), header_bytes.end());
+  m_staged.insert(m_staged.end(), comment_bytes.begin(), comment_bytes.end());
+
+  // Zero padding keeps the next record aligned
+  const size_t padding =
+    CommentRecord::allocSize(comment.size) - comment_bytes.size();
+  m_staged.insert(m_staged.end(), padding, std::byte{0});
+}
+
+void CommentLog::queueStaged(size_t count) {
+  bool notify = false;
+  {
+    // Committer takes whole pending buffer, so batch never spans commits
+    std::unique_lock lock(m_mutex);
+    if (waitForSpace(lock)) {
+      const bool was_empty = m_pending.empty();
+      m_pending.insert(m_pending.end(), m_staged.begin(), m_staged.end());
+      m_appended += count;
+
+      if (was_empty) {
+        m_first_pending = std::chrono::steady_clock::now();
+      }
+      notify = was_empty || m_pending.size() >= m_options.commit_bytes;
+    }
+  }
+
+  // Buffer of unusually large batch is not kept for every later append
+  m_staged.clear();
+  if (m_staged.capacity() > m_options.commit_bytes) {
+    m_staged.shrink_to_fit();
+  }
+
+  if (notify) {
+    m_pending_cv.notify_one();
+  }
+}
+
+void CommentLog::addListener(int event_fd) {
+  std::lock_guard lock(m_mutex);
+  m_listeners.push_back(event_fd);
+}
+
+void CommentLog::removeListener(int event_fd) {
+  std::lock_guard lock(m_mutex);
+  std::erase(m_listeners, event_fd);
+}
+
+void CommentLog::runCommitter(void) {
+  std::vector<std::byte> batch;
+
+  for (;;) {
+    std::unique_lock lock(m_mutex);
+    m_pending_cv.wait(lock, [this] {
+      return m_stopping || !m_pending.empty();
+    });
+    if (m_pending.empty()) {
+      break;
+    }
+
+    // Give other appends a chance to join the batch
+    m_pending_cv.wait_until(
+        lock,
+        m_first_pending + m_options.commit_delay,
+        [this] {
+          return m_stopping || m_pending.size() >= m_options.commit_bytes;
+        }
+    );
+
+    batch.swap(m_pending);
+    const size_t batch_end = m_appended;
+    lock.unlock();
+    m_space_cv.notify_all();
+
+    if (!writeBatch(batch, batch_end)) {
+      // Nothing after failed write can become durable, so appends stop
+      lock.lock();
+      m_failed.store(true, std::memory_order_release);
+      m_pending.clear();
+      lock.unlock();
+
+      m_space_cv.notify_all();
+      notifyListeners();
+      break;
+    }
+    batch.clear();
+
+    m_durable.store(batch_end, std::memory_order_release);
+    notifyListeners();
+  }
+}
+
+bool CommentLog::writeBatch(
+    const std::vector<std::byte>& batch,
+    size_t batch_end
+) {
+  bool new_segment = false;
+  if (m_segment_fd < 0 || m_segment_bytes >= m_options.segment_size) {
+    if (!openSegment(m_written)) {
+      return false;
+    }
+    new_segment = true;
+  }
+
+  // Torn record left by failed write is discarded by recovery
+  if (!write_all(m_segment_fd, batch)) {
+    report_error("write", m_segment_path);
+    return false;
+  }
+  if (fdatasync(m_segment_fd) != 0) {
+    report_error("sync", m_segment_path);
+    return false;
+  }
+
+  // Make new directory entry durable as well
+  if (new_segment && !sync_directory(m_directory)) {
+    report_error("sync", m_directory);
+    return false;
+  }
+
+  m_segment_bytes += batch.size();
+  m_written = batch_end;
+  return true;
+}
+
+bool CommentLog::openSegment(size_t first_index) {
+  if (m_segment_fd >= 0) {
+    close(m_segment_fd);
+  }
+
+  m_segment_path = m_directory + "/" + segment_name(first_index);
+  m_segment_fd = open(
+      m_segment_path.c_str(),
+      O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+      0644
+  );
+  if (m_segment_fd < 0) {
+    report_error("create", m_segment_path);
+    return false;
+  }
+
+  m_segment_bytes = 0;
+  return true;
+}
+
+void CommentLog::notifyListeners(void) {
+  std::lock_guard lock(m_mutex);
+
+  const uint64_t value = 1;
+  for (int listener : m_listeners) {
+    ssize_t res = write(listener, &value, sizeof(value));
+    (void) res;  // Counter overflow only means listener is already woken up
+  }
+}
+
+} // namespace storage
@@ -0,0 +1,204 @@
+/**
+ * @file CommentLog.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Durable append-only comment log with group commit
+ *
+ * Log is a directory of segment files named after index of their first
+ * comment. Every record is laid out as
+ *
+ *    | uint32_t size | uint32_t crc32c | CommentRecord |
+ *
+ * in host byte order, where checksum covers comment record up to its
+ * terminating NUL, and padding of comment record keeps the next record
+ * aligned. Appends are buffered and written by a background thread, which
+ * issues one `fdatasync` per batch. On startup segments are mapped into
+ * memory and comment records are served directly from mappings.
+ *
+ * Segments of the previous format, which had no comment metadata, are named
+ * `*.log`. Recovery converts them into current segments with zero timestamps
+ * and authors, and removes them once conversion is durable. `MIGRATING`
+ * marker in directory tells that conversion was interrupted and is redone.
+ *
+ * @version 0.0.1
+ * @date 2024-11-10
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __STORAGE_COMMENT_LOG_HPP
+#define __STORAGE_COMMENT_LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Storage/CommentRecord.hpp"
+
+namespace storage {
+
+struct CommentLogOptions {
+  // Segment is sealed and new one started when it grows above this size
+  size_t segment_size = 64 * 1024 * 1024;
+
+  // Batch is committed as soon as it reaches this size...
+  size_t commit_bytes = 256 * 1024;
+
+  // ...or when its oldest comment waited this long
+  std::chrono::microseconds commit_delay = std::chrono::microseconds(500);
+
+  // Appends wait while this much is queued, so that slow disk slows down
+  // appending threads instead of growing queue without limit
+  size_t max_pending_bytes = 64 * 1024 * 1024;
+};
+
+class CommentLog final {
+public:
+  /**
+   * @brief Open log in given directory, creating directory if needed
+   */
+  explicit CommentLog(std::string directory, CommentLogOptions options = {});
+
+  // Non-Copyable
+  CommentLog(const CommentLog&) = delete;
+  CommentLog& operator=(const CommentLog&) = delete;
+
+  // Non-Movable
+  CommentLog(CommentLog&&) = delete;
+  CommentLog& operator=(CommentLog&&) = delete;
+
+  /**
+   * @brief Commit pending comments and close log
+   */
+  ~CommentLog();
+
+  /**
+   * @brief Map existing segments and report every stored comment in order.
+   *
+   * Reported records stay valid for log lifetime. Torn record at the end of
+   * the log is discarded. Segments which cannot follow recovered ones, and
+   * damaged parts of sealed segments, are kept as `*.orphan` files for the
+   * operator. Must be called once, before any `append()`.
+   *
+   * @return Log was recovered. Otherwise reason is reported to `stderr` and
+   * log must not be used
+   */
+  bool recover(const std::function<void(const CommentRecord&)>& on_comment);
+
+  /**
+   * @brief Mappings of recovered segments, which hold reported records
+   */
+  std::vector<std::span<const char>> getMappings(void) const;
+
+  /**
+   * @brief Queue comment for writing. Callers must serialize appends.
+   * Blocks while `max_pending_bytes` are queued already
+   */
+  void append(const CommentRecord& comment);
+
+  /**
+   * @brief Queue several comments, which are always committed together
+   */
+  void appendBatch(std::span<const CommentRecord* const> comments);
+
+  /**
+   * @brief Number of comments that are safely stored on disk
+   */
+  size_t durableCount(void) const noexcept {
+    return m_durable.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Writing to disk failed and was reported to `stderr`. Comments
+   * above `durableCount()` never become durable, later appends are dropped
+   */
+  bool hasFailed(void) const noexcept {
+    return m_failed.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Register eventfd which is signalled after every commit and once
+   * log fails
+   */
+  void addListener(int event_fd);
+
+  void removeListener(int event_fd);
+
+private:
+  struct Mapping {
+    void* address;
+    size_t size;
+  };
+
+  /**
+   * @brief Convert segments of the previous format, if there are any
+   *
+   * @return Directory holds only current segments
+   */
+  bool migrateLegacy(void);
+
+  /**
+   * @brief Wait until pending buffer has room for more records
+   *
+   * @return Records may be queued, log has not failed
+   */
+  bool waitForSpace(std::unique_lock<std::mutex>& lock);
+
+  /**
+   * @brief Serialize record and its checksum into staging buffer, without
+   * holding `m_mutex`
+   */
+  void stageRecord(const CommentRecord& comment);
+
+  /**
+   * @brief Move `count` staged records into pending buffer, waking
+   * committer up when needed
+   */
+  void queueStaged(size_t count);
+
+  void runCommitter(void);
+
+  /**
+   * @return Batch is durable, otherwise failure is reported
+   */
+  bool writeBatch(const std::vector<std::byte>& batch, size_t batch_end);
+  bool openSegment(size_t first_index);
+  void notifyListeners(void);
+
+  const std::string m_directory;
+  const CommentLogOptions m_options;
+
+  std::vector<Mapping> m_mappings{};
+
+  // Appender-only state, appends are serialized by callers
+  std::vector<std::byte> m_staged{};
+
+  // Committer-only state
+  int m_segment_fd = -1;
+  std::string m_segment_path{};
+  size_t m_segment_bytes = 0;
+  size_t m_written = 0;
+
+  std::mutex m_mutex{};
+  std::condition_variable m_pending_cv{};
+  std::condition_variable m_space_cv{};
+  std::vector<std::byte> m_pending{};
+  size_t m_appended = 0;
+  std::chrono::steady_clock::time_point m_first_pending{};
+  std::vector<int> m_listeners{};
+  bool m_stopping = false;
+
+  std::atomic<size_t> m_durable = 0;
+  std::atomic<bool> m_failed = false;
+  std::thread m_committer{};
+};
+
+} // namespace storage
+
+#endif /* CommentLog.hpp */
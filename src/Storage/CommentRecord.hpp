@@ -0,0 +1,66 @@
+/**
+ * @file CommentRecord.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Stored comment with its metadata
+ *
+ * Record is laid out as
+ *
+ *    | uint64_t timestamp | uint32_t author | uint32_t size |
+ *    | size bytes of comment | '\0' | padding to 8 bytes |
+ *
+ * in host byte order, so metadata shares cache line with the beginning of
+ * comment. Store arena and log segments hold records in exactly this
+ * layout, and store serves both without copying.
+ *
+ * @version 0.0.1
+ * @date 2024-11-20
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __STORAGE_COMMENT_RECORD_HPP
+#define __STORAGE_COMMENT_RECORD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace storage {
+
+struct CommentRecord {
+  uint64_t timestamp;  // Microseconds since Unix epoch, assigned by server
+  uint32_t author;     // Zero if comment is anonymous
+  uint32_t size;       // Of comment, without terminating NUL
+
+  char text[];
+
+  /**
+   * @brief Memory taken by record with comment of given size, including
+   * padding which keeps the next record aligned
+   */
+  static constexpr size_t allocSize(size_t size) noexcept {
+    const size_t unaligned = sizeof(CommentRecord) + size + 1;
+    return (unaligned + alignof(CommentRecord) - 1)
+      & ~(alignof(CommentRecord) - 1);
+  }
+
+  std::string_view getText(void) const noexcept {
+    return std::string_view(text, size);
+  }
+
+  /**
+   * @brief Header and comment bytes with terminating NUL, without padding
+   */
+  std::span<const char> getBytes(void) const noexcept {
+    return std::span(
+        reinterpret_cast<const char*>(this),
+        sizeof(CommentRecord) + size + 1
+    );
+  }
+};
+static_assert(sizeof(CommentRecord) == 16);
+
+} // namespace storage
+
+#endif /* CommentRecord.hpp */
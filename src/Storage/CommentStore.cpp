@@ -0,0 +1,274 @@
+#include "CommentStore.hpp"
+#include "Storage/CommentLog.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace storage {
+
+CommentStore::CommentStore(CommentLog* log, TieredArenaOptions arena_options)
+  : m_log(log),
+    m_arena(arena_options) {
+}
+
+CommentStore::~CommentStore() {
+  for (Entry* segment : m_segments) {
+    delete[] segment;
+  }
+  for (uint64_t* segment : m_time_samples) {
+    delete[] segment;
+  }
+  for (std::atomic<bool>* segment : m_touched) {
+    delete[] segment;
+  }
+}
+
+size_t CommentStore::append(std::span<const char> comment, uint32_t author) {
+  std::lock_guard lock(m_write_mutex);
+
+  const CommentRecord* record = copyComment(
+      m_size.load(std::memory_order_relaxed), comment, author,
+      nextTimestamp()
+  );
+
+  if (m_log != nullptr) {
+    m_log->append(*record);
+  }
+
+  return publish(record);
+}
+
+size_t CommentStore::appendBatch(
+    std::span<const std::string_view> comments,
+    uint32_t author
+) {
+  std::lock_guard lock(m_write_mutex);
+
+  const size_t first = m_size.load(std::memory_order_relaxed);
+  const uint64_t timestamp = nextTimestamp();
+
+  m_batch.clear();
+  for (size_t i = 0; i < comments.size(); ++i) {
+    const CommentRecord* record =
+      copyComment(first + i, comments[i], author, timestamp);
+    place(first + i, record);
+    m_batch.push_back(record);
+  }
+
+  if (m_log != nullptr) {
+    m_log->appendBatch(m_batch);
+  }
+
+  // Single release store makes the whole batch visible at once
+  m_size.store(first + comments.size(), std::memory_order_release);
+
+  return first;
+}
+
+size_t CommentStore::appendStamped(std::span<const StampedComment> comments) {
+  std::lock_guard lock(m_write_mutex);
+
+  const size_t first = m_size.load(std::memory_order_relaxed);
+
+  m_batch.clear();
+  for (size_t i = 0; i < comments.size(); ++i) {
+    const StampedComment& comment = comments[i];
+    assert(comment.timestamp >= m_last_timestamp);
+
+    const CommentRecord* record = copyComment(
+        first + i, comment.text, comment.author, comment.timestamp
+    );
+    place(first + i, record);
+    m_batch.push_back(record);
+    m_last_timestamp = comment.timestamp;
+  }
+
+  if (m_log != nullptr) {
+    m_log->appendBatch(m_batch);
+  }
+
+  m_size.store(first + comments.size(), std::memory_order_release);
+
+  return first;
+}
+
+size_t CommentStore::adopt(const CommentRecord& record) {
+  assert(record.text[record.size] == '\0');
+
+  std::lock_guard lock(m_write_mutex);
+  m_last_timestamp = std::max(m_last_timestamp, record.timestamp);
+  return publish(&record);
+}
+
+void CommentStore::adoptMemory(std::span<const char> memory) {
+  std::lock_guard lock(m_write_mutex);
+  m_arena.adoptCold(memory, m_size.load(std::memory_order_relaxed));
+}
+
+void CommentStore::releaseCold(void) {
+  m_arena.releaseCold();
+}
+
+size_t CommentStore::durableSize(void) const noexcept {
+  if (m_log == nullptr) {
+    return size();
+  }
+  return m_log->durableCount();
+}
+
+bool CommentStore::isDurabilityLost(void) const noexcept {
+  return m_log != nullptr && m_log->hasFailed();
+}
+
+size_t CommentStore::findTime(size_t size, uint64_t timestamp) const noexcept {
+  // First sample not earlier than timestamp
+  size_t low = 0;
+  size_t high = (size + TimeSampleInterval - 1) / TimeSampleInterval;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if (timeSample(middle) < timestamp) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  // Comment is after the previous sample and not after this one, so only
+  // a few records are read
+  high = std::min(size, low * TimeSampleInterval);
+  low = low == 0 ? 0 : (low - 1) * TimeSampleInterval + 1;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if (entry(middle)->timestamp < timestamp) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+void CommentStore::noteColdRead(size_t first, size_t end, size_t bytes) const {
+  for (size_t block = first / ReleaseBlockSize;
+       block * ReleaseBlockSize < end; ++block) {
+    std::atomic<bool>& touched = touchedBlock(block);
+    if (!touched.load(std::memory_order_relaxed) &&
+        !touched.exchange(true, std::memory_order_relaxed)) {
+      std::lock_guard lock(m_release_mutex);
+      m_touched_blocks.push_back(block);
+    }
+  }
+
+  // Cold memory read again may stay resident up to a segment size
+  const size_t read =
+    m_cold_read_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  if (read >= m_arena.getSegmentSize()) {
+    releaseTouched();
+  }
+}
+
+void CommentStore::releaseTouched(void) const {
+  std::vector<size_t> blocks;
+  {
+    std::lock_guard lock(m_release_mutex);
+
+    // Another reader may have released them first
+    if (m_cold_read_bytes.load(std::memory_order_relaxed) <
+        m_arena.getSegmentSize()) {
+      return;
+    }
+    m_cold_read_bytes.store(0, std::memory_order_relaxed);
+    blocks.swap(m_touched_blocks);
+  }
+
+  // Blocks read later are touched again and released by next pass
+  const size_t size = this->size();
+  std::sort(blocks.begin(), blocks.end());
+  std::vector<const void*> addresses;
+  for (size_t block : blocks) {
+    touchedBlock(block).store(false, std::memory_order_relaxed);
+
+    const size_t end = std::min(size, (block + 1) * ReleaseBlockSize);
+    for (size_t i = block * ReleaseBlockSize; i < end; ++i) {
+      addresses.push_back(entry(i));
+    }
+  }
+
+  m_arena.release(addresses);
+}
+
+uint64_t CommentStore::nextTimestamp(void) {
+  using namespace std::chrono;
+
+  const uint64_t now = (uint64_t)
+    duration_cast<microseconds>(system_clock::now().time_since_epoch())
+    .count();
+
+  // Clock may step back, but time index needs ordered timestamps
+  m_last_timestamp = std::max(m_last_timestamp, now);
+  return m_last_timestamp;
+}
+
+const CommentRecord* CommentStore::copyComment(
+    size_t index,
+    std::span<const char> comment,
+    uint32_t author,
+    uint64_t timestamp
+) {
+  static_assert(alignof(CommentRecord) <= TieredArena::Alignment);
+  char* bytes =
+    m_arena.allocate(CommentRecord::allocSize(comment.size()), index);
+
+  CommentRecord* record = reinterpret_cast<CommentRecord*>(bytes);
+  record->timestamp = timestamp;
+  record->author = author;
+  record->size = (uint32_t) comment.size();
+  std::copy(comment.begin(), comment.end(), record->text);
+  record->text[comment.size()] = '\0';
+
+  return record;
+}
+
+void CommentStore::place(size_t index, const CommentRecord* record) {
+  Location location = locate(index);
+  assert(location.segment < MaxSegments);
+
+  if (m_segments[location.segment] == nullptr) {
+    m_segments[location.segment] =
+      new Entry[FirstSegmentSize << location.segment];
+  }
+
+  m_segments[location.segment][location.offset] = record;
+
+  if (index % TimeSampleInterval == 0) {
+    Location sample = locate(index / TimeSampleInterval);
+    if (m_time_samples[sample.segment] == nullptr) {
+      m_time_samples[sample.segment] =
+        new uint64_t[FirstSegmentSize << sample.segment];
+    }
+
+    m_time_samples[sample.segment][sample.offset] = record->timestamp;
+  }
+
+  if (index % ReleaseBlockSize == 0) {
+    Location block = locate(index / ReleaseBlockSize);
+    if (m_touched[block.segment] == nullptr) {
+      m_touched[block.segment] =
+        new std::atomic<bool>[FirstSegmentSize << block.segment]();
+    }
+  }
+}
+
+size_t CommentStore::publish(const CommentRecord* record) {
+  const size_t index = m_size.load(std::memory_order_relaxed);
+  place(index, record);
+
+  // Entry must be fully written before readers can observe it
+  m_size.store(index + 1, std::memory_order_release);
+
+  return index;
+}
+
+} // namespace storage
@@ -0,0 +1,302 @@
+/**
+ * @file CommentStore.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Append-only comment log with lock-free readers
+ *
+ * Comments are stored in segments of geometrically growing size, so entry
+ * addresses never change once written. Every entry points to a record
+ * holding comment with its metadata (see CommentRecord.hpp). Records are
+ * allocated from tiered arena, so consecutive records are mostly adjacent
+ * in memory, and old ones may be served from page cache (see
+ * TieredArena.hpp). Readers report comments they send with `noteRead()`,
+ * and once enough cold memory was read, pages of cold memory holding
+ * touched blocks of comments are released. Writers are serialized
+ * and publish new log length with release semantics; readers take a
+ * snapshot of the length and may access any entry below it without locking.
+ *
+ * Store assigns non-decreasing timestamps, and keeps timestamp of every
+ * `TimeSampleInterval`-th comment in a sparse index. First comment of
+ * given time is found by binary search over the compact index, which then
+ * reads only a few records between two samples.
+ *
+ * @version 0.0.1
+ * @date 2024-11-07
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __STORAGE_COMMENT_STORE_HPP
+#define __STORAGE_COMMENT_STORE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "Storage/CommentRecord.hpp"
+#include "Storage/TieredArena.hpp"
+
+namespace storage {
+
+class CommentLog;
+
+/**
+ * @brief Comment with metadata already assigned, e.g. by leader server
+ */
+struct StampedComment {
+  std::string_view text;
+  uint64_t timestamp;
+  uint32_t author;
+};
+
+class CommentStore final {
+public:
+  /**
+   * @brief Consistent view of store prefix, valid while store is alive
+   */
+  class Snapshot final {
+  public:
+    size_t size(void) const noexcept { return m_size; }
+
+    std::string_view operator[](size_t index) const {
+      return record(index).getText();
+    }
+
+    /**
+     * @brief Comment bytes followed by terminating NUL character
+     */
+    std::span<const char> terminated(size_t index) const {
+      const CommentRecord& comment = record(index);
+      return std::span(comment.text, comment.size + 1);
+    }
+
+    /**
+     * @brief Comment together with its metadata
+     */
+    const CommentRecord& record(size_t index) const {
+      assert(index < m_size);
+      return *m_store->entry(index);
+    }
+
+    /**
+     * @brief Index of first comment stored at `timestamp` or later, or
+     * `size()` if there is no such comment
+     */
+    size_t findTime(uint64_t timestamp) const {
+      return m_store->findTime(m_size, timestamp);
+    }
+
+    /**
+     * @brief Report that comments [`first`, `end`) of `bytes` total size
+     * were read, so that cold pages faulted in for them are released later
+     */
+    void noteRead(size_t first, size_t end, size_t bytes) const {
+      if (first < m_store->m_arena.getColdEnd()) {
+        m_store->noteColdRead(first, std::min(end, m_size), bytes);
+      }
+    }
+
+  private:
+    friend class CommentStore;
+
+    Snapshot(const CommentStore* store, size_t size)
+      : m_store(store), m_size(size) {
+    }
+
+    const CommentStore* m_store;
+    size_t m_size;
+  };
+
+  /**
+   * @brief Create empty store
+   *
+   * @param[in] log             Durable log to mirror appends to, may be
+   *                            `nullptr`
+   * @param[in] arena_options   Placement of appended records
+   */
+  explicit CommentStore(
+      CommentLog* log = nullptr,
+      TieredArenaOptions arena_options = {}
+  );
+
+  // Non-Copyable
+  CommentStore(const CommentStore&) = delete;
+  CommentStore& operator=(const CommentStore&) = delete;
+
+  // Non-Movable
+  CommentStore(CommentStore&&) = delete;
+  CommentStore& operator=(CommentStore&&) = delete;
+
+  ~CommentStore();
+
+  /**
+   * @brief Append comment to the end of the log, stamped with current time
+   *
+   * @param[in] comment   Comment bytes
+   * @param[in] author    Author id, zero if anonymous
+   *
+   * @return Index of appended comment
+   */
+  size_t append(std::span<const char> comment, uint32_t author = 0);
+
+  /**
+   * @brief Append several comments of one author under consecutive indices.
+   *
+   * Readers observe either none or all comments of batch, and the batch is
+   * committed to log as a whole. All comments get the same timestamp.
+   *
+   * @return Index of first appended comment
+   */
+  size_t appendBatch(
+      std::span<const std::string_view> comments,
+      uint32_t author = 0
+  );
+
+  /**
+   * @brief Append comments keeping their timestamps and authors, which must
+   * not be earlier than those already stored. Committed as `appendBatch()`
+   *
+   * @return Index of first appended comment
+   */
+  size_t appendStamped(std::span<const StampedComment> comments);
+
+  /**
+   * @brief Append record without copying it and without writing it to log
+   *
+   * Used to restore comments from log. Record must outlive the store.
+   */
+  size_t adopt(const CommentRecord& record);
+
+  /**
+   * @brief Manage memory mapped from file, which holds adopted records, as
+   * cold memory of arena. Its pages are released same as those of cold
+   * segments
+   */
+  void adoptMemory(std::span<const char> memory);
+
+  /**
+   * @brief Drop pages of all cold memory, e.g. once adopted records were
+   * read to build indices
+   */
+  void releaseCold(void);
+
+  size_t size(void) const noexcept {
+    return m_size.load(std::memory_order_acquire);
+  }
+
+  Snapshot snapshot(void) const noexcept {
+    return Snapshot(this, size());
+  }
+
+  /**
+   * @brief Number of comments which will not be lost on restart
+   */
+  size_t durableSize(void) const noexcept;
+
+  /**
+   * @brief Log failed, so comments above `durableSize()` never become
+   * durable
+   */
+  bool isDurabilityLost(void) const noexcept;
+
+  /**
+   * @brief Memory of appended records kept resident
+   */
+  size_t getHotBytes(void) const noexcept { return m_arena.getHotBytes(); }
+
+  /**
+   * @brief Memory of appended and adopted records served from page cache
+   */
+  size_t getColdBytes(void) const noexcept { return m_arena.getColdBytes(); }
+
+private:
+  static constexpr size_t FirstSegmentSize = 1024;
+  static constexpr size_t MaxSegments = 32;
+  static constexpr size_t TimeSampleInterval = 64;
+  static constexpr size_t ReleaseBlockSize = 1024;
+
+  using Entry = const CommentRecord*;
+
+  struct Location {
+    size_t segment;
+    size_t offset;
+  };
+
+  static Location locate(size_t index) noexcept {
+    // Segment k holds FirstSegmentSize << k entries and starts at index
+    // FirstSegmentSize * (2^k - 1)
+    size_t segment = std::bit_width(index / FirstSegmentSize + 1) - 1;
+    size_t first = FirstSegmentSize * ((size_t(1) << segment) - 1);
+    return Location{ segment, index - first };
+  }
+
+  Entry entry(size_t index) const noexcept {
+    Location location = locate(index);
+    return m_segments[location.segment][location.offset];
+  }
+
+  /**
+   * @brief Timestamp of comment `sample * TimeSampleInterval`
+   */
+  uint64_t timeSample(size_t sample) const noexcept {
+    Location location = locate(sample);
+    return m_time_samples[location.segment][location.offset];
+  }
+
+  size_t findTime(size_t size, uint64_t timestamp) const noexcept;
+
+  /**
+   * @brief Flag of block `block` of `ReleaseBlockSize` comments
+   */
+  std::atomic<bool>& touchedBlock(size_t block) const noexcept {
+    Location location = locate(block);
+    return m_touched[location.segment][location.offset];
+  }
+
+  void noteColdRead(size_t first, size_t end, size_t bytes) const;
+  void releaseTouched(void) const;
+
+  uint64_t nextTimestamp(void);
+  const CommentRecord* copyComment(
+      size_t index,
+      std::span<const char> comment,
+      uint32_t author,
+      uint64_t timestamp
+  );
+  void place(size_t index, const CommentRecord* record);
+  size_t publish(const CommentRecord* record);
+
+  Entry* m_segments[MaxSegments] = {};
+
+  // Sparse time index, laid out in segments same as entries
+  uint64_t* m_time_samples[MaxSegments] = {};
+
+  // Blocks with comments read since their cold memory was released, laid
+  // out in segments same as entries
+  std::atomic<bool>* m_touched[MaxSegments] = {};
+
+  std::atomic<size_t> m_size = 0;
+
+  CommentLog* const m_log;
+
+  // Touched blocks which are not released yet
+  mutable std::mutex m_release_mutex{};
+  mutable std::vector<size_t> m_touched_blocks{};
+  mutable std::atomic<size_t> m_cold_read_bytes = 0;
+
+  // Writer-only state
+  std::mutex m_write_mutex{};
+  TieredArena m_arena;
+  uint64_t m_last_timestamp = 0;
+  std::vector<const CommentRecord*> m_batch{};
+};
+
+} // namespace storage
+
+#endif /* CommentStore.hpp */
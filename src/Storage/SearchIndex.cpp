@@ -0,0 +1,272 @@
+#include "SearchIndex.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+
+namespace storage {
+
+PostingList::Cursor::Cursor(const PostingList& list)
+  : m_bytes(list.m_bytes),
+    m_skips(list.m_skips),
+    m_count(list.m_count),
+    m_skip_count(list.m_skip_count) {
+  if (!atEnd()) {
+    decode();
+  }
+}
+
+void PostingList::Cursor::next(void) noexcept {
+  ++m_position;
+  if (!atEnd()) {
+    decode();
+  }
+}
+
+void PostingList::Cursor::seek(uint32_t target) noexcept {
+  if (atEnd() || m_value >= target) {
+    return;
+  }
+
+  // Resume from the last skip below target, if it is ahead of cursor
+  const Skip* skips = m_skips.get();
+  const Skip* first = skips + m_position / SkipInterval;
+  const Skip* skip = std::upper_bound(first, skips + m_skip_count, target,
+      [](uint32_t value, const Skip& skip) { return value < skip.value; }
+  );
+  if (skip != first) {
+    --skip;
+    const size_t position = (size_t) (skip - skips) * SkipInterval;
+    if (position > m_position) {
+      m_position = position;
+      m_value = skip->value;
+      m_offset = skip->offset;
+    }
+  }
+
+  while (!atEnd() && m_value < target) {
+    next();
+  }
+}
+
+void PostingList::Cursor::decode(void) noexcept {
+  const uint8_t* bytes = m_bytes.get();
+
+  uint32_t delta = 0;
+  for (unsigned shift = 0; ; shift += 7) {
+    const uint8_t byte = bytes[m_offset++];
+    delta |= (uint32_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+
+  m_value += delta;
+}
+
+/**
+ * @brief Make room for `count` more elements after `size` ones, moving them
+ * to a new buffer if needed
+ */
+template <typename T>
+static void reserve_shared(
+    std::shared_ptr<T[]>& buffer,
+    size_t size,
+    size_t& capacity,
+    size_t count
+) {
+  if (size + count <= capacity) {
+    return;
+  }
+
+  capacity = std::max(2 * capacity, size + count);
+  std::shared_ptr<T[]> grown = std::make_shared_for_overwrite<T[]>(capacity);
+  std::copy(buffer.get(), buffer.get() + size, grown.get());
+  buffer = std::move(grown);
+}
+
+void PostingList::add(uint32_t value) {
+  assert(m_count == 0 || value > m_last);
+
+  // Varint of 32-bit delta takes at most 5 bytes
+  reserve_shared(m_bytes, m_byte_count, m_byte_capacity, 5);
+
+  // First posting is stored as is
+  uint32_t delta = value - m_last;
+  while (delta >= 0x80) {
+    m_bytes[m_byte_count++] = (uint8_t) (delta | 0x80);
+    delta >>= 7;
+  }
+  m_bytes[m_byte_count++] = (uint8_t) delta;
+
+  if (m_count % SkipInterval == 0) {
+    reserve_shared(m_skips, m_skip_count, m_skip_capacity, 1);
+    m_skips[m_skip_count++] = Skip{
+      .value = value, .offset = (uint32_t) m_byte_count
+    };
+  }
+
+  ++m_count;
+  m_last = value;
+}
+
+static bool is_word_byte(unsigned char byte) {
+  return byte >= 0x80
+      || (byte >= '0' && byte <= '9')
+      || (byte >= 'a' && byte <= 'z')
+      || (byte >= 'A' && byte <= 'Z');
+}
+
+/**
+ * @brief Call `handle(std::string_view)` for every lowercase word of text
+ */
+template <typename Handler>
+static void for_each_term(std::string_view text, Handler&& handle) {
+  char term[SearchIndex::MaxTermLength];
+  size_t length = 0;
+  bool in_word = false;
+
+  for (char c : text) {
+    const unsigned char byte = (unsigned char) c;
+    if (is_word_byte(byte)) {
+      if (length < SearchIndex::MaxTermLength) {
+        term[length++] = byte >= 'A' && byte <= 'Z' ? (char) (byte | 0x20) : c;
+      }
+      in_word = true;
+      continue;
+    }
+
+    if (in_word) {
+      handle(std::string_view(term, length));
+      length = 0;
+      in_word = false;
+    }
+  }
+
+  if (in_word) {
+    handle(std::string_view(term, length));
+  }
+}
+
+void SearchIndex::update(const CommentStore::Snapshot& snapshot) {
+  if (snapshot.size() <= size()) {
+    return;
+  }
+
+  std::unique_lock lock(m_mutex);
+
+  // Other thread may have indexed the same comments meanwhile
+  size_t indexed = m_size.load(std::memory_order_relaxed);
+  for (; indexed < snapshot.size(); ++indexed) {
+    index((uint32_t) indexed, snapshot[indexed]);
+  }
+
+  m_size.store(indexed, std::memory_order_release);
+}
+
+void SearchIndex::index(uint32_t comment, std::string_view text) {
+  for_each_term(text, [this, comment](std::string_view term) {
+    auto it = m_terms.find(term);
+    if (it == m_terms.end()) {
+      it = m_terms.try_emplace(std::string(term)).first;
+    }
+
+    // Word may repeat within comment
+    PostingList& postings = it->second;
+    if (postings.empty() || postings.back() != comment) {
+      postings.add(comment);
+    }
+  });
+}
+
+size_t SearchIndex::search(
+    std::string_view query,
+    size_t start_index,
+    size_t max_count,
+    std::vector<uint32_t>& results
+) const {
+  results.clear();
+
+  std::vector<std::string> terms;
+  for_each_term(query, [&terms](std::string_view term) {
+    terms.emplace_back(term);
+  });
+  std::ranges::sort(terms);
+  const auto duplicates = std::ranges::unique(terms);
+  terms.erase(duplicates.begin(), duplicates.end());
+
+  // Lock is only held while cursors are created, updates go on during
+  // intersection
+  std::shared_lock lock(m_mutex);
+  const size_t exhausted = std::max(start_index, size());
+  if (terms.empty() || max_count == 0 || start_index > UINT32_MAX) {
+    return exhausted;
+  }
+
+  std::vector<const PostingList*> lists;
+  lists.reserve(terms.size());
+  for (const std::string& term : terms) {
+    auto it = m_terms.find(term);
+    if (it == m_terms.end()) {
+      return exhausted;
+    }
+    lists.push_back(&it->second);
+  }
+
+  // Shortest list leads, others only seek to its postings
+  std::ranges::sort(lists, {}, &PostingList::size);
+  std::vector<PostingList::Cursor> cursors;
+  cursors.reserve(lists.size());
+  for (const PostingList* list : lists) {
+    cursors.emplace_back(*list);
+  }
+  lock.unlock();
+
+  PostingList::Cursor& lead = cursors.front();
+  lead.seek((uint32_t) start_index);
+
+  while (!lead.atEnd()) {
+    const uint32_t candidate = lead.get();
+
+    bool matched = true;
+    for (size_t i = 1; i < cursors.size(); ++i) {
+      cursors[i].seek(candidate);
+      if (cursors[i].atEnd()) {
+        return exhausted;
+      }
+      if (cursors[i].get() != candidate) {
+        lead.seek(cursors[i].get());
+        matched = false;
+        break;
+      }
+    }
+    if (!matched) {
+      continue;
+    }
+
+    results.push_back(candidate);
+    if (results.size() == max_count) {
+      return (size_t) candidate + 1;
+    }
+    lead.next();
+  }
+
+  return exhausted;
+}
+
+size_t SearchIndex::getTermCount(void) const {
+  std::shared_lock lock(m_mutex);
+  return m_terms.size();
+}
+
+size_t SearchIndex::getPostingBytes(void) const {
+  std::shared_lock lock(m_mutex);
+
+  size_t bytes = 0;
+  for (const auto& [term, postings] : m_terms) {
+    bytes += postings.getByteSize();
+  }
+  return bytes;
+}
+
+} // namespace storage
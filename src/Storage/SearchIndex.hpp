@@ -0,0 +1,209 @@
+/**
+ * @file SearchIndex.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Inverted index of words of stored comments
+ *
+ * Every word maps to the list of comments containing it. Lists hold
+ * increasing comment indices as varint-encoded deltas, with a skip entry
+ * every `PostingList::SkipInterval` postings, so that search seeks past
+ * comments which cannot match instead of decoding them. Search cost then
+ * depends on lengths of posting lists and number of results, not on
+ * number of stored comments.
+ *
+ * Index follows store: `update()` indexes comments appended since its last
+ * call, always in index order, so that it may be called by any thread
+ * after appending.
+ *
+ * Search only holds index lock while it looks words up. Cursors remember
+ * how many postings their list had, and share its buffers, which are
+ * replaced rather than reallocated when list grows, so that intersection
+ * runs concurrently with updates.
+ *
+ * @version 0.0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __STORAGE_SEARCH_INDEX_HPP
+#define __STORAGE_SEARCH_INDEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Storage/CommentStore.hpp"
+
+namespace storage {
+
+/**
+ * @brief Increasing comment indices, compressed
+ */
+class PostingList final {
+private:
+  // Where to resume decoding at every `SkipInterval`-th posting
+  struct Skip {
+    uint32_t value;
+    uint32_t offset;  // Of delta following the posting
+  };
+
+public:
+  static constexpr size_t SkipInterval = 64;
+
+  /**
+   * @brief Forward iterator over postings added before it was created.
+   * Stays valid when list grows or is destroyed
+   */
+  class Cursor final {
+  public:
+    explicit Cursor(const PostingList& list);
+
+    bool atEnd(void) const noexcept { return m_position >= m_count; }
+
+    uint32_t get(void) const noexcept { return m_value; }
+
+    void next(void) noexcept;
+
+    /**
+     * @brief Advance to first posting not less than `target`
+     */
+    void seek(uint32_t target) noexcept;
+
+  private:
+    void decode(void) noexcept;
+
+    std::shared_ptr<const uint8_t[]> m_bytes;
+    std::shared_ptr<const Skip[]> m_skips;
+    size_t m_count;
+    size_t m_skip_count;
+
+    size_t m_offset = 0;    // Of next encoded delta
+    size_t m_position = 0;  // Ordinal of current posting
+    uint32_t m_value = 0;
+  };
+
+  PostingList() = default;
+
+  /**
+   * @brief Append posting greater than all previous ones
+   */
+  void add(uint32_t value);
+
+  size_t size(void) const noexcept { return m_count; }
+
+  bool empty(void) const noexcept { return m_count == 0; }
+
+  uint32_t back(void) const noexcept { return m_last; }
+
+  /**
+   * @brief Memory taken by encoded postings and skips
+   */
+  size_t getByteSize(void) const noexcept {
+    return m_byte_count + m_skip_count * sizeof(Skip);
+  }
+
+private:
+  // Cursors may still read full buffer, so it is copied into a larger one
+  // instead of growing in place. Bytes past the counts are only written
+  std::shared_ptr<uint8_t[]> m_bytes{};
+  size_t m_byte_count = 0;
+  size_t m_byte_capacity = 0;
+
+  std::shared_ptr<Skip[]> m_skips{};
+  size_t m_skip_count = 0;
+  size_t m_skip_capacity = 0;
+
+  size_t m_count = 0;
+  uint32_t m_last = 0;
+};
+
+class SearchIndex final {
+public:
+  // Longer words are indexed and searched by their prefix
+  static constexpr size_t MaxTermLength = 64;
+
+  SearchIndex() = default;
+
+  // Non-Copyable
+  SearchIndex(const SearchIndex&) = delete;
+  SearchIndex& operator=(const SearchIndex&) = delete;
+
+  // Non-Movable
+  SearchIndex(SearchIndex&&) = delete;
+  SearchIndex& operator=(SearchIndex&&) = delete;
+
+  ~SearchIndex() = default;
+
+  /**
+   * @brief Index comments of snapshot which are not indexed yet
+   */
+  void update(const CommentStore::Snapshot& snapshot);
+
+  /**
+   * @brief Number of comments indexed so far
+   */
+  size_t size(void) const noexcept {
+    return m_size.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Find comments containing every word of `query`.
+   *
+   * Words are runs of ASCII letters and digits and of non-ASCII bytes,
+   * compared case-insensitively.
+   *
+   * @param[in]  query        Words to look for
+   * @param[in]  start_index  Smallest comment index to report
+   * @param[in]  max_count    Largest number of results
+   * @param[out] results      Indices of matching comments, in increasing
+   *                          order
+   *
+   * @return Index to continue search from: past the last result if
+   * `max_count` results were found, otherwise number of indexed comments
+   */
+  size_t search(
+      std::string_view query,
+      size_t start_index,
+      size_t max_count,
+      std::vector<uint32_t>& results
+  ) const;
+
+  /**
+   * @brief Number of distinct words
+   */
+  size_t getTermCount(void) const;
+
+  /**
+   * @brief Memory taken by posting lists
+   */
+  size_t getPostingBytes(void) const;
+
+private:
+  struct TermHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view term) const noexcept {
+      return std::hash<std::string_view>{}(term);
+    }
+  };
+
+  using TermMap =
+    std::unordered_map<std::string, PostingList, TermHash, std::equal_to<>>;
+
+  void index(uint32_t comment, std::string_view text);
+
+  mutable std::shared_mutex m_mutex{};
+  TermMap m_terms{};
+  std::atomic<size_t> m_size = 0;
+};
+
+} // namespace storage
+
+#endif /* SearchIndex.hpp */
@@ -0,0 +1,225 @@
+#include "TieredArena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace storage {
+
+static size_t round_to_pages(size_t size) {
+  static const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+TieredArena::TieredArena(TieredArenaOptions options)
+  : m_directory(
+        options.cold_directory != nullptr ? options.cold_directory : ""
+    ),
+    m_segment_size(options.segment_size),
+    m_hot_budget(options.hot_bytes) {
+  // Failure shows up as soon as first segment file is created
+  if (!m_directory.empty()) {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+  }
+}
+
+TieredArena::~TieredArena() {
+  if (m_current.address != nullptr) {
+    if (m_current.fd >= 0) {
+      close(m_current.fd);
+    }
+    munmap(m_current.address, m_current.size);
+  }
+  for (const Segment& segment : m_sealed) {
+    munmap(segment.address, segment.size);
+  }
+}
+
+char* TieredArena::allocate(size_t size, size_t index) {
+  assert(size % Alignment == 0);
+
+  // Large allocation gets own segment, leaving current one usable
+  if (size > m_segment_size / 4) {
+    Segment segment = map(size);
+    segment.end_index = index + 1;
+    seal(segment, size);
+    return segment.address;
+  }
+
+  if (m_current.address == nullptr || m_used + size > m_current.size) {
+    if (m_current.address != nullptr) {
+      seal(m_current, m_used);
+    }
+    m_current = map(m_segment_size);
+    m_used = 0;
+    m_hot_bytes.store(
+        m_sealed_hot_bytes + m_current.size, std::memory_order_relaxed
+    );
+  }
+
+  // Segments are page-aligned, so allocations stay aligned
+  char* bytes = m_current.address + m_used;
+  m_used += size;
+  m_current.end_index = index + 1;
+  return bytes;
+}
+
+void TieredArena::adoptCold(std::span<const char> memory, size_t end_index) {
+  if (m_directory.empty()) {
+    return;
+  }
+
+  m_cold_bytes.fetch_add(memory.size(), std::memory_order_relaxed);
+  makeCold(memory.data(), memory.size(), end_index);
+}
+
+void TieredArena::releaseCold(void) {
+  std::lock_guard lock(m_cold_mutex);
+  for (const auto& [address, size] : m_cold_memory) {
+    madvise(const_cast<char*>(address), size, MADV_DONTNEED);
+  }
+}
+
+void TieredArena::release(std::span<const void* const> addresses) const {
+  std::lock_guard lock(m_cold_mutex);
+
+  // Neighbouring addresses mostly fall into the same cold memory
+  const char* released = nullptr;
+  const char* released_end = nullptr;
+  for (const void* pointer : addresses) {
+    const char* address = static_cast<const char*>(pointer);
+    if (released <= address && address < released_end) {
+      continue;
+    }
+
+    auto cold = m_cold_memory.upper_bound(address);
+    if (cold == m_cold_memory.begin()) {
+      continue;
+    }
+    --cold;
+    if (address >= cold->first + cold->second) {
+      continue;
+    }
+
+    released = cold->first;
+    released_end = cold->first + cold->second;
+    madvise(const_cast<char*>(released), cold->second, MADV_DONTNEED);
+  }
+}
+
+/**
+ * @brief Create unlinked file of `size` bytes in `directory`
+ *
+ * @return File descriptor, or -1 with error code in `errno`
+ */
+static int create_segment_file(const std::string& directory, size_t size) {
+  // File only lives as long as its mapping
+  std::string path = directory + "/segment-XXXXXX";
+  int fd = mkostemp(path.data(), O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path.c_str());
+
+  // Writes through mapping would raise SIGBUS if disk ran out of space
+  int res = posix_fallocate(fd, 0, (off_t) size);
+  if (res != 0) {
+    close(fd);
+    errno = res;
+    return -1;
+  }
+
+  return fd;
+}
+
+TieredArena::Segment TieredArena::map(size_t size) {
+  size = round_to_pages(size);
+
+  if (!m_directory.empty()) {
+    int fd = create_segment_file(m_directory, size);
+    void* address = fd < 0
+      ? MAP_FAILED
+      : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address != MAP_FAILED) {
+      return Segment{ static_cast<char*>(address), size, 0, fd, true, 0 };
+    }
+
+    // Comments are still stored, they only stay resident
+    fprintf(stderr,
+        "Tiered arena: cannot create segment in %s: %s, "
+        "keeping it in anonymous memory\n",
+        m_directory.c_str(), strerror(errno));
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  void* address = mmap(
+      NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+  );
+  assert(address != MAP_FAILED);
+  return Segment{ static_cast<char*>(address), size, 0, -1, false, 0 };
+}
+
+void TieredArena::seal(Segment segment, size_t used) {
+  segment.used = round_to_pages(used);
+
+  if (segment.fd >= 0) {
+    // Pages past the used part are never touched, file keeps them if it
+    // cannot be trimmed
+    (void) ftruncate(segment.fd, (off_t) segment.used);
+    close(segment.fd);
+    segment.fd = -1;
+  }
+
+  m_sealed.push_back(segment);
+  m_sealed_hot_bytes += segment.used;
+  evict();
+}
+
+void TieredArena::evict(void) {
+  if (!m_directory.empty()) {
+    // Pages of segments which are already cold are released by readers,
+    // so only newly cold ones are dropped here
+    while (m_sealed_hot_bytes > m_hot_budget &&
+           m_first_hot < m_sealed.size()) {
+      const Segment& segment = m_sealed[m_first_hot++];
+      if (segment.shared) {
+        m_sealed_hot_bytes -= segment.used;
+        m_cold_bytes.fetch_add(segment.used, std::memory_order_relaxed);
+        makeCold(segment.address, segment.used, segment.end_index);
+      }
+    }
+  }
+
+  const size_t current = m_current.address != nullptr ? m_current.size : 0;
+  m_hot_bytes.store(m_sealed_hot_bytes + current, std::memory_order_relaxed);
+}
+
+void TieredArena::makeCold(
+    const char* address,
+    size_t size,
+    size_t end_index
+) {
+  std::lock_guard lock(m_cold_mutex);
+  m_cold_memory.emplace(address, size);
+  m_cold_end.store(
+      std::max(end_index, m_cold_end.load(std::memory_order_relaxed)),
+      std::memory_order_relaxed
+  );
+
+  // Shared file mapping keeps contents, dirty pages are written back by
+  // kernel and later reads fault pages in from page cache or file
+  madvise(const_cast<char*>(address), size, MADV_DONTNEED);
+}
+
+} // namespace storage
@@ -0,0 +1,178 @@
+/**
+ * @file TieredArena.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Append-only memory of comment records, split into hot and cold
+ * segments
+ *
+ * Memory is handed out from contiguous segments, filled one at a time.
+ * With cold directory set, every segment is a shared mapping of an unlinked
+ * file in that directory. Once sealed segments exceed the hot budget, the
+ * oldest ones become cold: their pages are dropped from process memory,
+ * but stay in page cache, from which the kernel may write them back and
+ * reclaim them as any other file pages. Cold memory is still readable at
+ * the same address, so pointers into the arena never change. Pages read
+ * again are dropped by `release()`, which owner calls for memory it knows
+ * to be read. Memory mapped elsewhere, such as recovered log, may be added
+ * to cold memory and is released the same way. Without cold directory, or
+ * if segment file cannot be created there, segments are anonymous and
+ * always hot.
+ *
+ * @version 0.0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __STORAGE_TIERED_ARENA_HPP
+#define __STORAGE_TIERED_ARENA_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+struct TieredArenaOptions {
+  // Directory of cold segment files, which are removed as soon as they are
+  // created. Comments are kept in anonymous memory if null
+  const char* cold_directory = nullptr;
+
+  // Size of segment, allocations above a quarter of it get own segment
+  size_t segment_size = 16 * 1024 * 1024;
+
+  // Sealed segments kept resident, in addition to segment being filled
+  size_t hot_bytes = 256 * 1024 * 1024;
+};
+
+class TieredArena final {
+public:
+  /**
+   * @brief Alignment of every allocation
+   */
+  static constexpr size_t Alignment = 8;
+
+  explicit TieredArena(TieredArenaOptions options = {});
+
+  // Non-Copyable
+  TieredArena(const TieredArena&) = delete;
+  TieredArena& operator=(const TieredArena&) = delete;
+
+  // Non-Movable
+  TieredArena(TieredArena&&) = delete;
+  TieredArena& operator=(TieredArena&&) = delete;
+
+  ~TieredArena();
+
+  /**
+   * @brief Allocate `size` bytes, multiple of `Alignment`, valid for arena
+   * lifetime. Callers must serialize allocations
+   *
+   * @param[in] size    Size of allocation
+   * @param[in] index   Position of allocation in owner's order, never
+   *                    decreasing, see `getColdEnd()`
+   */
+  char* allocate(size_t size, size_t index);
+
+  /**
+   * @brief Add memory mapped from file by owner, which holds allocations
+   * below `end_index`, to cold memory and drop its pages. Ignored if
+   * segments are anonymous
+   */
+  void adoptCold(std::span<const char> memory, size_t end_index);
+
+  /**
+   * @brief Drop pages of all cold memory from process memory
+   */
+  void releaseCold(void);
+
+  /**
+   * @brief Drop pages of cold memory holding any of `addresses`, which were
+   * read since it was released. Addresses in hot memory are skipped. May be
+   * called concurrently with allocations
+   */
+  void release(std::span<const void* const> addresses) const;
+
+  /**
+   * @brief Allocations with index below this may be in cold memory, later
+   * ones are hot
+   */
+  size_t getColdEnd(void) const noexcept {
+    return m_cold_end.load(std::memory_order_relaxed);
+  }
+
+  size_t getSegmentSize(void) const noexcept { return m_segment_size; }
+
+  /**
+   * @brief Bytes of segments which are kept resident
+   */
+  size_t getHotBytes(void) const noexcept {
+    return m_hot_bytes.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Bytes of segments and adopted memory which are served from page
+   * cache
+   */
+  size_t getColdBytes(void) const noexcept {
+    return m_cold_bytes.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Segment {
+    char* address;
+    size_t size;  // Of mapping
+    size_t used;  // Pages which may be touched, set once sealed
+    int fd;       // Of backing file while segment is filled, or -1
+    bool shared;  // Backed by file, so that pages may be dropped
+    size_t end_index;
+  };
+
+  /**
+   * @brief Map segment backed by file in cold directory, or anonymous one
+   * if there is no cold directory or file cannot be created there
+   */
+  Segment map(size_t size);
+
+  /**
+   * @brief Trim file of segment to its used part and make it hot
+   */
+  void seal(Segment segment, size_t used);
+
+  /**
+   * @brief Make oldest hot segments cold until hot ones fit into budget.
+   * Anonymous segments stay resident and hot
+   */
+  void evict(void);
+
+  /**
+   * @brief Add memory to cold memory and drop its pages
+   */
+  void makeCold(const char* address, size_t size, size_t end_index);
+
+  const std::string m_directory;  // Empty if segments are anonymous
+  const size_t m_segment_size;
+  const size_t m_hot_budget;
+
+  Segment m_current{};
+  size_t m_used = 0;
+
+  std::vector<Segment> m_sealed{};  // In order of sealing
+  size_t m_first_hot = 0;           // Sealed segments before it are cold
+  size_t m_sealed_hot_bytes = 0;
+
+  // Sizes of cold memory by its address, looked up by releasing readers
+  mutable std::mutex m_cold_mutex{};
+  std::map<const char*, size_t> m_cold_memory{};
+
+  std::atomic<size_t> m_cold_end = 0;
+  std::atomic<size_t> m_hot_bytes = 0;
+  std::atomic<size_t> m_cold_bytes = 0;
+};
+
+} // namespace storage
+
+#endif /* TieredArena.hpp */
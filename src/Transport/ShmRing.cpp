@@ -0,0 +1,120 @@
+#include "ShmRing.hpp"
+
+#include <algorithm>
+
+namespace transport {
+
+void ShmRing::loadTail(void) {
+  const uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+
+  // Consumer never reads past producer, nor moves backwards
+  if (tail < m_peer_position || tail > m_position) {
+    m_corrupt = true;
+    return;
+  }
+  m_peer_position = tail;
+}
+
+void ShmRing::loadHead(void) {
+  const uint64_t head = m_header->head.load(std::memory_order_acquire);
+
+  // Producer never overwrites unread bytes, nor moves backwards
+  if (head < m_peer_position || head - m_position > m_data.size()) {
+    m_corrupt = true;
+    return;
+  }
+  m_peer_position = head;
+}
+
+size_t ShmRing::write(std::span<const std::byte> bytes) {
+  if (m_corrupt) {
+    return 0;
+  }
+
+  if (freeSpace() < bytes.size()) {
+    loadTail();
+  }
+  const size_t count = std::min(bytes.size(), freeSpace());
+  if (m_corrupt || count == 0) {
+    return 0;
+  }
+
+  // Copy may wrap around the end of data
+  const size_t offset = (size_t) m_position & m_mask;
+  const size_t first = std::min(count, m_data.size() - offset);
+  std::copy_n(bytes.data(), first, m_data.data() + offset);
+  std::copy_n(bytes.data() + first, count - first, m_data.data());
+
+  m_position += count;
+  m_header->head.store(m_position, std::memory_order_release);
+  return count;
+}
+
+size_t ShmRing::read(std::span<std::byte> buffer) {
+  if (m_corrupt) {
+    return 0;
+  }
+
+  if (usedSpace() < buffer.size()) {
+    loadHead();
+  }
+  const size_t count = std::min(buffer.size(), usedSpace());
+  if (m_corrupt || count == 0) {
+    return 0;
+  }
+
+  const size_t offset = (size_t) m_position & m_mask;
+  const size_t first = std::min(count, m_data.size() - offset);
+  std::copy_n(m_data.data() + offset, first, buffer.data());
+  std::copy_n(m_data.data(), count - first, buffer.data() + first);
+
+  m_position += count;
+  m_header->tail.store(m_position, std::memory_order_release);
+  return count;
+}
+
+bool ShmRing::prepareRead(void) {
+  m_header->reader_waiting.store(1, std::memory_order_relaxed);
+
+  // Pairs with fence in `takeReaderWaiting()`: either producer sees the
+  // flag, or bytes it wrote are seen here
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  loadHead();
+  if (m_corrupt || usedSpace() > 0) {
+    m_header->reader_waiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool ShmRing::prepareWrite(void) {
+  m_header->writer_waiting.store(1, std::memory_order_relaxed);
+
+  // Pairs with fence in `takeWriterWaiting()`
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  loadTail();
+  if (m_corrupt || freeSpace() > 0) {
+    m_header->writer_waiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool ShmRing::takeReaderWaiting(void) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  // Plain load first, so that the line is not written while nobody waits
+  return m_header->reader_waiting.load(std::memory_order_relaxed) != 0
+      && m_header->reader_waiting.exchange(0, std::memory_order_relaxed) != 0;
+}
+
+bool ShmRing::takeWriterWaiting(void) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  return m_header->writer_waiting.load(std::memory_order_relaxed) != 0
+      && m_header->writer_waiting.exchange(0, std::memory_order_relaxed) != 0;
+}
+
+} // namespace transport
@@ -0,0 +1,153 @@
+/**
+ * @file ShmRing.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Single-producer single-consumer byte ring in shared memory
+ *
+ * Producer advances `head`, consumer advances `tail`; both only grow, and
+ * position in data is taken modulo capacity, which is a power of two. Each
+ * side keeps the last seen position of the other side locally, so that the
+ * shared cache line of the peer is touched only when the ring looks full or
+ * empty.
+ *
+ * Side which finds ring empty (full) sets its waiting flag and rechecks
+ * the ring. Other side takes the flag after making progress and wakes the
+ * waiter up. Fences on both sides guarantee that either the waiter sees the
+ * progress or the other side sees the flag.
+ *
+ * Peer may be a different, possibly misbehaving, process. Positions read
+ * from shared memory are checked, and ring which breaks its invariants is
+ * reported as corrupt instead of being used.
+ *
+ * @version 0.0.1
+ * @date 2024-11-16
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __TRANSPORT_SHM_RING_HPP
+#define __TRANSPORT_SHM_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace transport {
+
+constexpr size_t CacheLineSize = 64;
+
+/**
+ * @brief Shared ring state, placed in shared memory
+ */
+struct ShmRingHeader {
+  // Written by producer
+  alignas(CacheLineSize) std::atomic<uint64_t> head = 0;
+  std::atomic<uint32_t> writer_waiting = 0;
+
+  // Written by consumer, which starts out waiting for the first bytes
+  alignas(CacheLineSize) std::atomic<uint64_t> tail = 0;
+  std::atomic<uint32_t> reader_waiting = 1;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+/**
+ * @brief View of ring used by one of its sides
+ */
+class ShmRing final {
+public:
+  /**
+   * @param[in] header    Shared state, default-constructed before first use
+   * @param[in] data      Ring data, size must be a power of two
+   */
+  ShmRing(ShmRingHeader* header, std::span<std::byte> data)
+    : m_header(header), m_data(data), m_mask(data.size() - 1) {
+  }
+
+  // Copyable, copies are just views
+
+  /**
+   * @brief Copy as many bytes as fit into ring
+   *
+   * @return Number of bytes written
+   */
+  size_t write(std::span<const std::byte> bytes);
+
+  /**
+   * @brief Copy as many bytes as available from ring
+   *
+   * @return Number of bytes read
+   */
+  size_t read(std::span<std::byte> buffer);
+
+  /**
+   * @brief Ring is empty and consumer should wait to be woken up.
+   * Returns `false` if bytes arrived meanwhile, in which case consumer
+   * should read them instead
+   */
+  bool prepareRead(void);
+
+  /**
+   * @brief Ring is full and producer should wait to be woken up.
+   * Returns `false` if space appeared meanwhile
+   */
+  bool prepareWrite(void);
+
+  /**
+   * @brief Consumer waits for bytes written before the call. Clears the
+   * flag, so that consumer is woken up once
+   */
+  bool takeReaderWaiting(void);
+
+  /**
+   * @brief Producer waits for space freed before the call
+   */
+  bool takeWriterWaiting(void);
+
+  /**
+   * @brief Peer broke ring invariants
+   */
+  bool isCorrupt(void) const noexcept { return m_corrupt; }
+
+private:
+  /**
+   * @brief Refresh position of consumer, as seen by producer
+   */
+  void loadTail(void);
+
+  /**
+   * @brief Refresh position of producer, as seen by consumer
+   */
+  void loadHead(void);
+
+  /**
+   * @brief Bytes producer may write without overwriting unread ones
+   */
+  size_t freeSpace(void) const noexcept {
+    return m_data.size() - (size_t) (m_position - m_peer_position);
+  }
+
+  /**
+   * @brief Bytes consumer may read
+   */
+  size_t usedSpace(void) const noexcept {
+    return (size_t) (m_peer_position - m_position);
+  }
+
+  ShmRingHeader* m_header;
+  std::span<std::byte> m_data;
+  size_t m_mask;
+
+  // Own position is kept locally, peer cannot move it
+  uint64_t m_position = 0;
+
+  // Last seen position of the other side
+  uint64_t m_peer_position = 0;
+
+  bool m_corrupt = false;
+};
+
+} // namespace transport
+
+#endif /* ShmRing.hpp */
@@ -0,0 +1,368 @@
+#include "ShmTransport.hpp"
+
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace transport {
+
+/**
+ * @brief Start of shared memory. Ring data follows at `HeaderSize`,
+ * client-to-server ring first
+ */
+struct ShmHeaders {
+  ShmRingHeader to_server = {};
+  ShmRingHeader to_client = {};
+};
+
+static constexpr size_t HeaderSize = 4096;
+static_assert(sizeof(ShmHeaders) <= HeaderSize);
+
+static size_t mapping_size(size_t capacity) {
+  return HeaderSize + 2 * capacity;
+}
+
+static bool make_address(const char* path, struct sockaddr_un& address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  strcpy(address.sun_path, path);
+  return true;
+}
+
+int ShmTransport::listen(const char* path) {
+  struct sockaddr_un address;
+  if (!make_address(path, address)) {
+    return -1;
+  }
+
+  // Never remove anything but a socket
+  struct stat status = {};
+  if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+    unlink(path);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (bind(fd, (const struct sockaddr*) &address, sizeof(address)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+
+  return fd;
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::serve(int socket, size_t capacity) {
+  const size_t size = mapping_size(capacity);
+
+  int memory = memfd_create("comment-rings", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memory < 0) {
+    close(socket);
+    return nullptr;
+  }
+
+  // Client must not be able to shrink memory under server, which would
+  // make server crash with SIGBUS
+  void* mapping = MAP_FAILED;
+  if (ftruncate(memory, (off_t) size) == 0 &&
+      fcntl(memory, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0) {
+    mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    close(memory);
+    close(socket);
+    return nullptr;
+  }
+
+  new (mapping) ShmHeaders{};
+
+  ShmHandshake handshake = {
+    .magic = Magic,
+    .version = Version,
+    .capacity = capacity
+  };
+  struct iovec iovec = { .iov_base = &handshake, .iov_len = sizeof(handshake) };
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  struct msghdr header = {};
+  header.msg_iov = &iovec;
+  header.msg_iovlen = 1;
+  header.msg_control = control;
+  header.msg_controllen = sizeof(control);
+
+  struct cmsghdr* rights = CMSG_FIRSTHDR(&header);
+  rights->cmsg_level = SOL_SOCKET;
+  rights->cmsg_type = SCM_RIGHTS;
+  rights->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(rights), &memory, sizeof(memory));
+
+  // Fresh socket buffer always has room for the handshake
+  ssize_t sent = sendmsg(socket, &header, MSG_NOSIGNAL);
+  close(memory);
+  if (sent != (ssize_t) sizeof(handshake)) {
+    munmap(mapping, size);
+    close(socket);
+    return nullptr;
+  }
+
+  return std::unique_ptr<ShmTransport>(new ShmTransport(
+      socket,
+      std::span(static_cast<std::byte*>(mapping), size),
+      capacity,
+      Side::Server
+  ));
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::connect(const char* path) {
+  struct sockaddr_un address;
+  if (!make_address(path, address)) {
+    return nullptr;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  // Connect and receive handshake while blocking
+  if (::connect(fd, (const struct sockaddr*) &address, sizeof(address)) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  ShmHandshake handshake = {};
+  struct iovec iovec = { .iov_base = &handshake, .iov_len = sizeof(handshake) };
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  struct msghdr header = {};
+  header.msg_iov = &iovec;
+  header.msg_iovlen = 1;
+  header.msg_control = control;
+  header.msg_controllen = sizeof(control);
+
+  ssize_t received = 0;
+  do {
+    errno = 0;
+    received = recvmsg(fd, &header, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+  } while (received < 0 && errno == EINTR);
+
+  int memory = -1;
+  struct cmsghdr* rights = CMSG_FIRSTHDR(&header);
+  if (rights != nullptr &&
+      rights->cmsg_level == SOL_SOCKET &&
+      rights->cmsg_type == SCM_RIGHTS &&
+      rights->cmsg_len == CMSG_LEN(sizeof(int))) {
+    memcpy(&memory, CMSG_DATA(rights), sizeof(memory));
+  }
+
+  const size_t capacity = handshake.capacity;
+  bool valid =
+    received == (ssize_t) sizeof(handshake) &&
+    memory >= 0 &&
+    handshake.magic == Magic &&
+    handshake.version == Version &&
+    std::has_single_bit(capacity) &&
+    capacity <= MaxCapacity;
+
+  struct stat status = {};
+  valid = valid
+    && fstat(memory, &status) == 0
+    && (size_t) status.st_size >= mapping_size(capacity);
+
+  void* mapping = MAP_FAILED;
+  if (valid) {
+    mapping = mmap(
+        NULL, mapping_size(capacity), PROT_READ | PROT_WRITE, MAP_SHARED,
+        memory, 0
+    );
+  }
+  if (memory >= 0) {
+    close(memory);
+  }
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  return std::unique_ptr<ShmTransport>(new ShmTransport(
+      fd,
+      std::span(static_cast<std::byte*>(mapping), mapping_size(capacity)),
+      capacity,
+      Side::Client
+  ));
+}
+
+static ShmRing make_ring(
+    std::span<std::byte> mapping,
+    size_t capacity,
+    bool to_server
+) {
+  auto* headers = reinterpret_cast<ShmHeaders*>(mapping.data());
+  return ShmRing(
+      to_server ? &headers->to_server : &headers->to_client,
+      mapping.subspan(HeaderSize + (to_server ? 0 : capacity), capacity)
+  );
+}
+
+ShmTransport::ShmTransport(
+    int socket,
+    std::span<std::byte> mapping,
+    size_t capacity,
+    Side side
+) : m_socket(socket),
+    m_mapping(mapping),
+    m_input(make_ring(mapping, capacity, side == Side::Server)),
+    m_output(make_ring(mapping, capacity, side == Side::Client)) {
+}
+
+ShmTransport::~ShmTransport() {
+  munmap(m_mapping.data(), m_mapping.size());
+  close(m_socket);
+}
+
+ssize_t ShmTransport::read(std::span<std::byte> buffer) {
+  size_t count = 0;
+  while (count < buffer.size()) {
+    count += m_input.read(buffer.subspan(count));
+    if (m_input.isCorrupt()) {
+      errno = EPROTO;
+      return -1;
+    }
+    if (count == buffer.size()) {
+      break;
+    }
+
+    // Ring is empty. Short read must leave doorbell armed, like a socket
+    // which becomes readable again once data arrives
+    drainDoorbell();
+    if (m_input.prepareRead()) {
+      break;
+    }
+  }
+
+  if (count > 0 && m_input.takeWriterWaiting()) {
+    ringDoorbell();
+  }
+
+  if (count > 0) {
+    return (ssize_t) count;
+  }
+  if (m_peer_closed) {
+    return 0;
+  }
+  errno = EAGAIN;
+  return -1;
+}
+
+ssize_t ShmTransport::write(std::span<const struct iovec> iovecs) {
+  if (m_peer_closed) {
+    errno = EPIPE;
+    return -1;
+  }
+
+  size_t count = 0;
+  size_t skip = 0;  // Bytes of current iovec already written
+  for (size_t i = 0; i < iovecs.size(); ) {
+    auto bytes = std::span(
+        static_cast<const std::byte*>(iovecs[i].iov_base), iovecs[i].iov_len
+    ).subspan(skip);
+
+    const size_t written = m_output.write(bytes);
+    count += written;
+    if (m_output.isCorrupt()) {
+      errno = EPROTO;
+      return -1;
+    }
+    if (written == bytes.size()) {
+      ++i;
+      skip = 0;
+      continue;
+    }
+    skip += written;
+
+    // Ring is full, wait for reader to free some space. Consumed doorbells
+    // may have announced input as well, which must not be lost
+    if (drainDoorbell() > 0) {
+      m_input_pending = true;
+    }
+    if (m_peer_closed) {
+      errno = EPIPE;
+      return -1;
+    }
+    if (m_output.prepareWrite()) {
+      break;
+    }
+  }
+
+  if (count > 0 && m_output.takeReaderWaiting()) {
+    ringDoorbell();
+  }
+
+  if (count > 0) {
+    return (ssize_t) count;
+  }
+  errno = EAGAIN;
+  return -1;
+}
+
+uint32_t ShmTransport::getWriteEvents(void) const noexcept {
+  return EPOLLIN;
+}
+
+void ShmTransport::ringDoorbell(void) {
+  // Full socket buffer already holds doorbells peer did not consume yet,
+  // so failure to add one more is harmless
+  const std::byte bell{1};
+  ssize_t res = send(m_socket, &bell, sizeof(bell), MSG_NOSIGNAL | MSG_DONTWAIT);
+  (void) res;
+}
+
+size_t ShmTransport::drainDoorbell(void) {
+  std::byte bells[64];
+  size_t drained = 0;
+
+  while (!m_peer_closed) {
+    errno = 0;
+    ssize_t res = recv(m_socket, bells, sizeof(bells), MSG_DONTWAIT);
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (res <= 0) {
+      m_peer_closed = true;
+      break;
+    }
+    drained += (size_t) res;
+    if ((size_t) res < sizeof(bells)) {
+      break;
+    }
+  }
+
+  return drained;
+}
+
+} // namespace transport
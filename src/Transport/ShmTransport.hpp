@@ -0,0 +1,135 @@
+/**
+ * @file ShmTransport.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Transport over shared memory rings for clients on the same host
+ *
+ * Client connects to server's Unix domain socket. Server creates a sealed
+ * memfd holding two `ShmRing`s, one per direction, and passes it to client
+ * with `SCM_RIGHTS` together with `ShmHandshake`. Both sides then exchange
+ * the usual message frames through the rings.
+ *
+ * The Unix socket stays open: it is the descriptor both sides wait on with
+ * epoll, peer writes a single byte to it (the doorbell) when it makes
+ * progress the other side waits for, and its closing tells that peer left.
+ *
+ * @version 0.0.1
+ * @date 2024-11-16
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __TRANSPORT_SHM_TRANSPORT_HPP
+#define __TRANSPORT_SHM_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "Transport/ShmRing.hpp"
+#include "Transport/Transport.hpp"
+
+namespace transport {
+
+/**
+ * @brief Description of shared memory sent along with its descriptor
+ */
+struct ShmHandshake {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;  // Data size of each ring
+};
+
+class ShmTransport final : public Transport {
+public:
+  static constexpr uint32_t Magic = 0x53484d52;  // "SHMR"
+  static constexpr uint32_t Version = 1;
+  static constexpr size_t DefaultCapacity = 1024 * 1024;
+  static constexpr size_t MaxCapacity = 64 * 1024 * 1024;
+
+  /**
+   * @brief Create non-blocking Unix socket accepting shared memory clients.
+   * Stale socket left at `path` by previous run is replaced
+   *
+   * @return Listening socket, or -1 with `errno` set
+   */
+  static int listen(const char* path);
+
+  /**
+   * @brief Set up shared memory for accepted client and send it over
+   *
+   * @param[in] socket    Accepted non-blocking socket, owned by transport
+   *                      (closed on failure)
+   * @param[in] capacity  Size of each ring, power of two
+   *
+   * @return Server side of transport, or `nullptr` on failure
+   */
+  static std::unique_ptr<ShmTransport> serve(
+      int socket,
+      size_t capacity = DefaultCapacity
+  );
+
+  /**
+   * @brief Connect to server listening at `path` and map shared memory
+   *
+   * @return Client side of transport, or `nullptr` on failure
+   */
+  static std::unique_ptr<ShmTransport> connect(const char* path);
+
+  ~ShmTransport() override;
+
+  ssize_t read(std::span<std::byte> buffer) override;
+
+  ssize_t write(std::span<const struct iovec> iovecs) override;
+
+  int getFd(void) const noexcept override { return m_socket; }
+
+  /**
+   * @brief Freed space is announced by doorbell, which makes socket readable
+   */
+  uint32_t getWriteEvents(void) const noexcept override;
+
+  /**
+   * @brief Doorbells of both directions share the socket, so waiting for
+   * space in output ring may consume doorbell announcing new input
+   */
+  bool takeInputPending(void) noexcept override {
+    bool pending = m_input_pending;
+    m_input_pending = false;
+    return pending;
+  }
+
+private:
+  enum class Side { Server, Client };
+
+  ShmTransport(
+      int socket,
+      std::span<std::byte> mapping,
+      size_t capacity,
+      Side side
+  );
+
+  /**
+   * @brief Wake peer up
+   */
+  void ringDoorbell(void);
+
+  /**
+   * @brief Consume pending doorbells, so that socket stops being readable.
+   * Sets `m_peer_closed` if peer left
+   *
+   * @return Number of doorbells consumed
+   */
+  size_t drainDoorbell(void);
+
+  int m_socket;
+  std::span<std::byte> m_mapping;
+  ShmRing m_input;
+  ShmRing m_output;
+  bool m_peer_closed = false;
+  bool m_input_pending = false;
+};
+
+} // namespace transport
+
+#endif /* ShmTransport.hpp */
@@ -0,0 +1,29 @@
+#include "Transport.hpp"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace transport {
+
+SocketTransport::~SocketTransport() {
+  close(m_socket);
+}
+
+ssize_t SocketTransport::read(std::span<std::byte> buffer) {
+  return recv(m_socket, buffer.data(), buffer.size(), 0);
+}
+
+ssize_t SocketTransport::write(std::span<const struct iovec> iovecs) {
+  struct msghdr header = {};
+  header.msg_iov = const_cast<struct iovec*>(iovecs.data());
+  header.msg_iovlen = iovecs.size();
+
+  return sendmsg(m_socket, &header, MSG_NOSIGNAL);
+}
+
+uint32_t SocketTransport::getWriteEvents(void) const noexcept {
+  return EPOLLOUT;
+}
+
+} // namespace transport
@@ -0,0 +1,106 @@
+/**
+ * @file Transport.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Non-blocking byte stream carrying message frames
+ *
+ * Connections and clients read and write through a transport, so that the
+ * same framing, pipelining and backpressure work over TCP sockets and over
+ * shared memory rings.
+ *
+ * @version 0.0.1
+ * @date 2024-11-16
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __TRANSPORT_TRANSPORT_HPP
+#define __TRANSPORT_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace transport {
+
+class Transport {
+public:
+  Transport() = default;
+
+  // Non-Copyable
+  Transport(const Transport&) = delete;
+  Transport& operator=(const Transport&) = delete;
+
+  // Non-Movable
+  Transport(Transport&&) = delete;
+  Transport& operator=(Transport&&) = delete;
+
+  virtual ~Transport() = default;
+
+  /**
+   * @brief Read available bytes without blocking, like `recv()`.
+   *
+   * Read which returns less than requested, or fails with `EAGAIN`, makes
+   * `getFd()` report readiness once more bytes arrive.
+   *
+   * @return Number of bytes read, zero if peer closed connection, or -1
+   * with `errno` set (`EAGAIN` if nothing is available)
+   */
+  virtual ssize_t read(std::span<std::byte> buffer) = 0;
+
+  /**
+   * @brief Write bytes without blocking, like `sendmsg()`
+   *
+   * @return Number of bytes written, or -1 with `errno` set (`EAGAIN` if
+   * nothing fits)
+   */
+  virtual ssize_t write(std::span<const struct iovec> iovecs) = 0;
+
+  /**
+   * @brief Descriptor to wait on with epoll
+   */
+  virtual int getFd(void) const noexcept = 0;
+
+  /**
+   * @brief Epoll events of `getFd()` which signal that blocked write may
+   * progress
+   */
+  virtual uint32_t getWriteEvents(void) const noexcept = 0;
+
+  /**
+   * @brief Last `write()` consumed readiness of `getFd()` which was meant
+   * for reading, so bytes may be available although descriptor does not
+   * report them. Clears the flag
+   */
+  virtual bool takeInputPending(void) noexcept { return false; }
+};
+
+/**
+ * @brief Transport over connected stream socket
+ */
+class SocketTransport final : public Transport {
+public:
+  /**
+   * @param[in] socket  Connected non-blocking socket, owned by transport
+   */
+  explicit SocketTransport(int socket) : m_socket(socket) {}
+
+  ~SocketTransport() override;
+
+  ssize_t read(std::span<std::byte> buffer) override;
+
+  ssize_t write(std::span<const struct iovec> iovecs) override;
+
+  int getFd(void) const noexcept override { return m_socket; }
+
+  uint32_t getWriteEvents(void) const noexcept override;
+
+private:
+  int m_socket;
+};
+
+} // namespace transport
+
+#endif /* Transport.hpp */
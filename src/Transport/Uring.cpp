@@ -0,0 +1,310 @@
+#include "Uring.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace transport {
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* params) {
+  return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_register(
+    int fd,
+    unsigned opcode,
+    const void* arg,
+    unsigned count
+) {
+  return (int) syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+bool Uring::isSupported(void) {
+  struct io_uring_params params = {};
+  params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+  int fd = io_uring_setup(4, &params);
+  if (fd < 0) {
+    return false;
+  }
+
+  constexpr size_t MaxOps = 256;
+  const size_t probe_size =
+    sizeof(struct io_uring_probe) + MaxOps * sizeof(struct io_uring_probe_op);
+  std::vector<std::byte> buffer(probe_size);
+  auto* probe = reinterpret_cast<struct io_uring_probe*>(buffer.data());
+
+  bool supported =
+    io_uring_register(fd, IORING_REGISTER_PROBE, probe, MaxOps) == 0 &&
+    (params.features & IORING_FEAT_SINGLE_MMAP) &&
+    (params.features & IORING_FEAT_NODROP);
+
+  // Multishot receive cannot be probed, but kernels which defer task work
+  // support it
+  for (uint8_t op : { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+                      IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS }) {
+    supported = supported && op <= probe->last_op
+                && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  close(fd);
+  return supported;
+}
+
+std::unique_ptr<Uring> Uring::create(void) {
+  auto uring = std::unique_ptr<Uring>(new Uring());
+  if (!uring->setup() || !uring->setupBuffers()) {
+    return nullptr;
+  }
+  return uring;
+}
+
+bool Uring::setup(void) {
+  struct io_uring_params params = {};
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL
+               | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN
+               | IORING_SETUP_TASKRUN_FLAG;
+  // Every connection may have a multishot receive posting completions
+  params.cq_entries = 4 * Entries;
+
+  m_fd = io_uring_setup(Entries, &params);
+  if (m_fd < 0) {
+    return false;
+  }
+
+  const size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  const size_t cq_size =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  m_rings_size = std::max(sq_size, cq_size);
+  m_rings = mmap(
+      NULL, m_rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+      m_fd, IORING_OFF_SQ_RING
+  );
+  if (m_rings == MAP_FAILED) {
+    m_rings = nullptr;
+    return false;
+  }
+
+  m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(
+      NULL, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+      m_fd, IORING_OFF_SQES
+  );
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+  auto* rings = static_cast<std::byte*>(m_rings);
+  auto field = [rings](uint32_t offset) {
+    return reinterpret_cast<uint32_t*>(rings + offset);
+  };
+
+  m_sq_head = field(params.sq_off.head);
+  m_sq_tail = field(params.sq_off.tail);
+  m_sq_flags = field(params.sq_off.flags);
+  m_sq_mask = *field(params.sq_off.ring_mask);
+  m_sq_entries = params.sq_entries;
+  m_sq_local_tail = *m_sq_tail;
+
+  // Submission entry `i` always sits at index `i` of the ring
+  uint32_t* array = field(params.sq_off.array);
+  for (uint32_t i = 0; i < m_sq_entries; ++i) {
+    array[i] = i;
+  }
+
+  m_cq_head = field(params.cq_off.head);
+  m_cq_tail = field(params.cq_off.tail);
+  m_cq_mask = *field(params.cq_off.ring_mask);
+  m_cqes = reinterpret_cast<struct io_uring_cqe*>(rings + params.cq_off.cqes);
+
+  m_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  return m_event >= 0
+    && io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &m_event, 1) == 0;
+}
+
+bool Uring::setupBuffers(void) {
+  // Buffer memory is only touched once kernel receives into it
+  m_buffers.reset(new std::byte[BufferCount * BufferSize]);
+
+  struct io_uring_sqe& sqe = getSqe();
+  sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe.fd = (int) BufferCount;
+  sqe.addr = (uint64_t) (uintptr_t) m_buffers.get();
+  sqe.len = BufferSize;
+  sqe.buf_group = BufferGroup;
+  sqe.off = 0;
+  if (!submit()) {
+    return false;
+  }
+
+  // Wait until buffers are there, so that first receives do not fail
+  int res = enter(0, IORING_ENTER_GETEVENTS);
+  if (res < 0 || !hasCompletions()) {
+    return false;
+  }
+
+  bool provided = false;
+  reap([&provided](const struct io_uring_cqe& cqe) {
+    provided = cqe.res >= 0;
+  });
+  return provided;
+}
+
+Uring::~Uring() {
+  // Closing the instance cancels everything still in flight
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+  if (m_event >= 0) {
+    close(m_event);
+  }
+  if (m_sqes != nullptr) {
+    munmap(m_sqes, m_sqes_size);
+  }
+  if (m_rings != nullptr) {
+    munmap(m_rings, m_rings_size);
+  }
+}
+
+struct io_uring_sqe& Uring::getSqe(void) {
+  uint32_t head = std::atomic_ref(*m_sq_head).load(std::memory_order_acquire);
+  if (m_sq_local_tail - head == m_sq_entries && submit()) {
+    head = std::atomic_ref(*m_sq_head).load(std::memory_order_acquire);
+    assert(m_sq_local_tail - head < m_sq_entries);
+  }
+  if (m_failed) {
+    memset(&m_discarded, 0, sizeof(m_discarded));
+    return m_discarded;
+  }
+
+  struct io_uring_sqe& sqe = m_sqes[m_sq_local_tail & m_sq_mask];
+  memset(&sqe, 0, sizeof(sqe));
+  ++m_sq_local_tail;
+  return sqe;
+}
+
+int Uring::enter(uint32_t to_submit, uint32_t flags) {
+  int res = 0;
+  do {
+    errno = 0;
+    res = (int) syscall(
+        __NR_io_uring_enter, m_fd, to_submit, 0, flags, NULL, 0
+    );
+  } while (res < 0 && errno == EINTR);
+  return res;
+}
+
+bool Uring::canRetry(int entered) {
+  // Kernel refuses to submit while completion queue overflows (EBUSY) or
+  // while it runs short of memory (EAGAIN)
+  if (entered >= 0 || errno == EBUSY || errno == EAGAIN) {
+    return true;
+  }
+
+  fprintf(stderr, "io_uring: cannot enter instance: %s\n", strerror(errno));
+  m_failed = true;
+  return false;
+}
+
+bool Uring::submit(void) {
+  if (m_failed) {
+    return false;
+  }
+
+  const uint32_t head =
+    std::atomic_ref(*m_sq_head).load(std::memory_order_acquire);
+  const uint32_t pending = m_sq_local_tail - head;
+  const uint32_t flags =
+    std::atomic_ref(*m_sq_flags).load(std::memory_order_relaxed);
+  if (pending == 0 && !(flags & IORING_SQ_TASKRUN)) {
+    return true;
+  }
+
+  std::atomic_ref(*m_sq_tail).store(m_sq_local_tail, std::memory_order_release);
+
+  // Queued entries stay queued until kernel accepts them
+  int entered = 0;
+  while ((entered = enter(pending, IORING_ENTER_GETEVENTS)) < 0) {
+    if (!canRetry(entered)) {
+      return false;
+    }
+    if (!stashCompletions()) {
+      sched_yield();
+    }
+  }
+  return true;
+}
+
+void Uring::runTaskWork(void) {
+  uint64_t value = 0;
+  ssize_t res = read(m_event, &value, sizeof(value));
+  (void) res;  // Nothing to clear if eventfd was not signalled
+
+  const uint32_t flags =
+    std::atomic_ref(*m_sq_flags).load(std::memory_order_relaxed);
+  // Full completion queue makes kernel refuse, `reap()` empties it and
+  // enters again to flush overflow
+  if (!m_failed && (flags & IORING_SQ_TASKRUN)) {
+    canRetry(enter(0, IORING_ENTER_GETEVENTS));
+  }
+}
+
+bool Uring::hasCompletions(void) const noexcept {
+  const uint32_t tail =
+    std::atomic_ref(*m_cq_tail).load(std::memory_order_acquire);
+  const uint32_t flags =
+    std::atomic_ref(*m_sq_flags).load(std::memory_order_relaxed);
+  return *m_cq_head != tail
+    || !m_backlog.empty()
+    || (flags & (IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN));
+}
+
+bool Uring::flushOverflow(void) {
+  const uint32_t flags =
+    std::atomic_ref(*m_sq_flags).load(std::memory_order_relaxed);
+  if (m_failed || !(flags & IORING_SQ_CQ_OVERFLOW)) {
+    return false;
+  }
+
+  // Part of overflow may not fit yet, it is flushed after queue is reaped
+  return canRetry(enter(0, IORING_ENTER_GETEVENTS));
+}
+
+bool Uring::stashCompletions(void) {
+  uint32_t head = *m_cq_head;
+  const uint32_t tail =
+    std::atomic_ref(*m_cq_tail).load(std::memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+
+  for (; head != tail; ++head) {
+    m_backlog.push_back(m_cqes[head & m_cq_mask]);
+  }
+  std::atomic_ref(*m_cq_head).store(head, std::memory_order_release);
+  return true;
+}
+
+void Uring::recycleBuffer(uint16_t id) {
+  // Goes to kernel with other submissions of the turn, and only posts
+  // a completion if it fails
+  struct io_uring_sqe& sqe = getSqe();
+  sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe.flags = IOSQE_CQE_SKIP_SUCCESS;
+  sqe.fd = 1;
+  sqe.addr = (uint64_t) (uintptr_t) (m_buffers.get() + (size_t) id * BufferSize);
+  sqe.len = BufferSize;
+  sqe.buf_group = BufferGroup;
+  sqe.off = id;
+}
+
+} // namespace transport
@@ -0,0 +1,218 @@
+/**
+ * @file Uring.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Minimal io_uring instance owned by one reactor thread
+ *
+ * Talks to the kernel through raw syscalls, so that no library is needed.
+ * Besides submission and completion queues, instance owns a group of
+ * provided buffers, which multishot receives fill, so that idle
+ * connections do not hold any receive memory.
+ *
+ * Completions are posted by the owning thread only when it enters the
+ * kernel (deferred task work), so that socket events never interrupt it,
+ * and an eventfd tells when there is work to run.
+ *
+ * Buffers are handed to kernel with `IORING_OP_PROVIDE_BUFFERS` rather
+ * than a registered buffer ring, which some kernels accept but never
+ * select buffers from. Requests with `user_data` of 0 belong to instance.
+ *
+ * @version 0.0.1
+ * @date 2024-11-17
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __TRANSPORT_URING_HPP
+#define __TRANSPORT_URING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+namespace transport {
+
+class Uring final {
+public:
+  static constexpr unsigned Entries = 1024;
+
+  // Provided buffers for receives
+  static constexpr uint16_t BufferGroup = 0;
+  static constexpr size_t BufferCount = 512;
+  static constexpr size_t BufferSize = 16 * 1024;
+
+  /**
+   * @brief Kernel supports every operation used by `UringTransport`
+   */
+  static bool isSupported(void);
+
+  /**
+   * @brief Set up instance
+   *
+   * @return Instance, or `nullptr` if kernel refused to create it
+   */
+  static std::unique_ptr<Uring> create(void);
+
+  // Non-Copyable
+  Uring(const Uring&) = delete;
+  Uring& operator=(const Uring&) = delete;
+
+  // Non-Movable
+  Uring(Uring&&) = delete;
+  Uring& operator=(Uring&&) = delete;
+
+  ~Uring();
+
+  /**
+   * @brief Descriptor which becomes readable when completions are ready
+   * to be reaped
+   */
+  int getFd(void) const noexcept { return m_event; }
+
+  /**
+   * @brief Get zeroed submission entry, submitting queued ones if the
+   * queue is full. Entries of failed instance are never submitted
+   */
+  struct io_uring_sqe& getSqe(void);
+
+  /**
+   * @brief Pass queued submissions to kernel and post ready completions
+   * without waiting. Kernel refuses submissions while it cannot post
+   * completions, so posted ones are moved aside until it accepts them, and
+   * are handled by next `reap()`
+   *
+   * @return Kernel accepted submissions. Otherwise instance has failed,
+   * see `isFailed()`
+   */
+  bool submit(void);
+
+  /**
+   * @brief Kernel refused to enter instance for reason other than lack of
+   * resources, which was reported to `stderr`. Requests in flight are
+   * cancelled only when instance is destroyed
+   */
+  bool isFailed(void) const noexcept { return m_failed; }
+
+  bool hasCompletions(void) const noexcept;
+
+  /**
+   * @brief Call `handle(const io_uring_cqe&)` for every posted completion
+   */
+  template <typename Handler>
+  void reap(Handler&& handle) {
+    runTaskWork();
+    do {
+      // Handler may submit and move more completions aside meanwhile
+      stashCompletions();
+      while (!m_backlog.empty()) {
+        m_reaping.swap(m_backlog);
+        for (const struct io_uring_cqe& cqe : m_reaping) {
+          handle(cqe);
+        }
+        m_reaping.clear();
+      }
+    } while (flushOverflow());
+  }
+
+  /**
+   * @brief Received bytes in provided buffer `id`
+   */
+  std::span<const std::byte> getBuffer(uint16_t id, size_t length) const {
+    return std::span(m_buffers.get() + (size_t) id * BufferSize, length);
+  }
+
+  /**
+   * @brief Give provided buffer back to kernel with next submission
+   */
+  void recycleBuffer(uint16_t id);
+
+  /**
+   * @brief Keep memory of request whose owner is gone until the request
+   * completes, see `releaseOrphan()`
+   */
+  void adoptOrphan(uint64_t user_data, std::vector<std::byte>&& memory) {
+    m_orphans.emplace(user_data, std::move(memory));
+  }
+
+  /**
+   * @brief Free memory of completed request
+   */
+  void releaseOrphan(uint64_t user_data) { m_orphans.erase(user_data); }
+
+private:
+  Uring() = default;
+
+  bool setup(void);
+  bool setupBuffers(void);
+
+  /**
+   * @brief Move completions which did not fit into queue back to it
+   *
+   * @return Some completions were moved
+   */
+  bool flushOverflow(void);
+
+  /**
+   * @brief Move posted completions out of completion queue, in order
+   *
+   * @return Some completions were moved
+   */
+  bool stashCompletions(void);
+
+  /**
+   * @brief Post completions which kernel deferred until instance is entered
+   */
+  void runTaskWork(void);
+
+  int enter(uint32_t to_submit, uint32_t flags);
+
+  /**
+   * @brief Handle result of `enter()`, failing instance on unexpected error
+   *
+   * @return Kernel may accept the same call later
+   */
+  bool canRetry(int entered);
+
+  int m_fd = -1;
+  int m_event = -1;  // Signalled by kernel when task work is deferred
+
+  // Mapped rings
+  void* m_rings = nullptr;
+  size_t m_rings_size = 0;
+  struct io_uring_sqe* m_sqes = nullptr;
+  size_t m_sqes_size = 0;
+
+  uint32_t* m_sq_head = nullptr;
+  uint32_t* m_sq_tail = nullptr;
+  uint32_t* m_sq_flags = nullptr;
+  uint32_t m_sq_mask = 0;
+  uint32_t m_sq_entries = 0;
+  uint32_t m_sq_local_tail = 0;  // Entries up to it are queued
+
+  bool m_failed = false;
+  struct io_uring_sqe m_discarded = {};  // Handed out once instance failed
+
+  uint32_t* m_cq_head = nullptr;
+  uint32_t* m_cq_tail = nullptr;
+  uint32_t m_cq_mask = 0;
+  struct io_uring_cqe* m_cqes = nullptr;
+
+  // Completions taken from queue, which are not handled yet
+  std::vector<struct io_uring_cqe> m_backlog{};
+  std::vector<struct io_uring_cqe> m_reaping{};
+
+  // Memory of provided buffers
+  std::unique_ptr<std::byte[]> m_buffers = nullptr;
+
+  std::unordered_map<uint64_t, std::vector<std::byte>> m_orphans{};
+};
+
+} // namespace transport
+
+#endif /* Uring.hpp */
@@ -0,0 +1,203 @@
+#include "UringTransport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace transport {
+
+using Operation = UringTag::Operation;
+
+UringTransport::~UringTransport() {
+  setReceiving(false);
+
+  for (const Received& received : m_input) {
+    m_uring.recycleBuffer(received.id);
+  }
+
+  // Kernel still reads staging buffer until send completes
+  if (m_sending) {
+    m_uring.adoptOrphan(tag(Operation::Send), std::move(m_send_buffer));
+  }
+
+  // Queued requests refer to socket by descriptor, which may be reused
+  // once closed, while requests in flight hold their own reference to it.
+  // Failed instance never submits them
+  m_uring.submit();
+  close(m_socket);
+}
+
+ssize_t UringTransport::read(std::span<std::byte> buffer) {
+  size_t count = 0;
+  while (count < buffer.size() && !m_input.empty()) {
+    Received& received = m_input.front();
+    const size_t size = std::min<size_t>(
+        received.size - received.offset, buffer.size() - count
+    );
+
+    auto bytes = m_uring.getBuffer(received.id, received.size)
+      .subspan(received.offset, size);
+    std::ranges::copy(bytes, buffer.data() + count);
+    count += size;
+    received.offset += (uint32_t) size;
+
+    if (received.offset == received.size) {
+      m_uring.recycleBuffer(received.id);
+      m_input.pop_front();
+    }
+  }
+
+  if (count > 0) {
+    return (ssize_t) count;
+  }
+  if (m_error != 0) {
+    errno = m_error;
+    return -1;
+  }
+  if (m_peer_closed) {
+    return 0;
+  }
+  errno = EAGAIN;
+  return -1;
+}
+
+ssize_t UringTransport::write(std::span<const struct iovec> iovecs) {
+  if (m_error != 0) {
+    errno = m_error;
+    return -1;
+  }
+  if (m_sending) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  size_t size = 0;
+  for (const struct iovec& iovec : iovecs) {
+    size += iovec.iov_len;
+  }
+  size = std::min(size, MaxSendSize);
+
+  m_send_buffer.resize(size);
+  size_t copied = 0;
+  for (const struct iovec& iovec : iovecs) {
+    if (copied == size) {
+      break;
+    }
+    const size_t length = std::min(iovec.iov_len, size - copied);
+    std::copy_n(
+        static_cast<const std::byte*>(iovec.iov_base), length,
+        m_send_buffer.data() + copied
+    );
+    copied += length;
+  }
+
+  m_send_offset = 0;
+  m_sending = true;
+  submitSend();
+  return (ssize_t) size;
+}
+
+void UringTransport::submitSend(void) {
+  struct io_uring_sqe& sqe = m_uring.getSqe();
+  sqe.opcode = IORING_OP_SEND;
+  sqe.fd = m_socket;
+  sqe.addr = (uint64_t) (uintptr_t) (m_send_buffer.data() + m_send_offset);
+  sqe.len = (uint32_t) (m_send_buffer.size() - m_send_offset);
+  // Kernel retries short sends by itself
+  sqe.msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+  sqe.user_data = tag(Operation::Send);
+}
+
+void UringTransport::setReceiving(bool receiving) {
+  if (receiving && m_receive == ReceiveState::Idle &&
+      !m_peer_closed && m_error == 0) {
+    struct io_uring_sqe& sqe = m_uring.getSqe();
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = m_socket;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = Uring::BufferGroup;
+    sqe.user_data = tag(Operation::Receive);
+    m_receive = ReceiveState::Armed;
+    return;
+  }
+
+  if (!receiving && m_receive == ReceiveState::Armed) {
+    struct io_uring_sqe& sqe = m_uring.getSqe();
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.addr = tag(Operation::Receive);
+    sqe.user_data = tag(Operation::Cancel);
+    m_receive = ReceiveState::Cancelling;
+  }
+}
+
+bool UringTransport::complete(const struct io_uring_cqe& cqe) {
+  const Operation operation = UringTag::decode(cqe.user_data).operation;
+
+  if (operation == Operation::Receive) {
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      const uint16_t id = (uint16_t) (cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      if (cqe.res > 0) {
+        m_input.push_back(Received{
+          .id = id, .offset = 0, .size = (uint32_t) cqe.res
+        });
+      } else {
+        m_uring.recycleBuffer(id);
+      }
+    }
+
+    // Receive ends on error, end of stream, cancellation, or when reactor
+    // runs out of provided buffers. It is armed again if connection reads
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+      m_receive = ReceiveState::Idle;
+    }
+    if (cqe.res == 0) {
+      m_peer_closed = true;
+    } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+      m_error = -cqe.res;
+    }
+    return true;
+  }
+
+  if (operation == Operation::Send) {
+    if (cqe.res <= 0) {
+      m_error = cqe.res == 0 ? EPIPE : -cqe.res;
+      m_sending = false;
+      return true;
+    }
+
+    m_send_offset += (size_t) cqe.res;
+    if (m_send_offset < m_send_buffer.size()) {
+      submitSend();
+      return false;
+    }
+
+    m_sending = false;
+    if (m_send_buffer.capacity() > KeptSendBuffer) {
+      std::vector<std::byte>().swap(m_send_buffer);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+void UringTransport::completeStale(
+    Uring& uring,
+    const struct io_uring_cqe& cqe
+) {
+  const Operation operation = UringTag::decode(cqe.user_data).operation;
+
+  if (operation == Operation::Receive && (cqe.flags & IORING_CQE_F_BUFFER)) {
+    uring.recycleBuffer((uint16_t) (cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+  }
+  if (operation == Operation::Send) {
+    uring.releaseOrphan(cqe.user_data);
+  }
+}
+
+} // namespace transport
@@ -0,0 +1,154 @@
+/**
+ * @file UringTransport.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Socket transport driven by io_uring completions
+ *
+ * Socket is not polled for readiness. Instead, one multishot receive keeps
+ * filling provided buffers of the reactor's `Uring` while connection reads,
+ * and `read()` only copies out what completions delivered. `write()` copies
+ * pending output into a staging buffer and queues a send, which reactor
+ * submits together with all other requests of its turn.
+ *
+ * Reactor passes every completion to `complete()` of the transport it
+ * belongs to (see `UringTag`), and serves connection when that returns
+ * `true`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-17
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __TRANSPORT_URING_TRANSPORT_HPP
+#define __TRANSPORT_URING_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+#include "Transport/Transport.hpp"
+#include "Transport/Uring.hpp"
+
+namespace transport {
+
+/**
+ * @brief Request identity, packed into `user_data` of submission
+ */
+struct UringTag {
+  // Zero `user_data` is left to requests of `Uring` itself
+  enum class Operation : uint8_t {
+    Accept = 1,
+    Receive,
+    Send,
+    Cancel,
+  };
+
+  Operation operation;
+  int fd;
+  uint32_t generation;  // Tells apart transports which reused the same fd
+
+  uint64_t encode(void) const noexcept {
+    return ((uint64_t) operation << 56)
+         | ((uint64_t) (uint32_t) fd & 0xFFFFFF) << 32
+         | generation;
+  }
+
+  static UringTag decode(uint64_t user_data) noexcept {
+    return UringTag{
+      .operation = Operation(user_data >> 56),
+      .fd = (int) ((user_data >> 32) & 0xFFFFFF),
+      .generation = (uint32_t) user_data
+    };
+  }
+};
+
+class UringTransport final : public Transport {
+public:
+  /**
+   * @param[in] uring       Instance of reactor, must outlive transport
+   * @param[in] socket      Connected socket, owned by transport
+   * @param[in] generation  Number unique among transports of `uring`
+   */
+  UringTransport(Uring& uring, int socket, uint32_t generation)
+    : m_uring(uring), m_socket(socket), m_generation(generation) {
+  }
+
+  /**
+   * @brief Cancel receive and close socket. Last send still completes
+   */
+  ~UringTransport() override;
+
+  ssize_t read(std::span<std::byte> buffer) override;
+
+  ssize_t write(std::span<const struct iovec> iovecs) override;
+
+  int getFd(void) const noexcept override { return m_socket; }
+
+  /**
+   * @brief Socket is never polled, completions resume writing
+   */
+  uint32_t getWriteEvents(void) const noexcept override { return 0; }
+
+  uint32_t getGeneration(void) const noexcept { return m_generation; }
+
+  /**
+   * @brief Keep receiving into provided buffers, or stop doing so, e.g.
+   * while connection does not read because of pending output
+   */
+  void setReceiving(bool receiving);
+
+  /**
+   * @brief Handle completion of request of this transport
+   *
+   * @return Connection may progress and should be served
+   */
+  bool complete(const struct io_uring_cqe& cqe);
+
+  /**
+   * @brief Handle completion of request whose transport is destroyed
+   */
+  static void completeStale(Uring& uring, const struct io_uring_cqe& cqe);
+
+private:
+  // Largest send in flight. Staging buffer larger than `KeptSendBuffer`
+  // is freed once its send completes
+  static constexpr size_t MaxSendSize = 256 * 1024;
+  static constexpr size_t KeptSendBuffer = 4 * 1024;
+
+  enum class ReceiveState {
+    Idle,
+    Armed,
+    Cancelling,
+  };
+
+  struct Received {
+    uint16_t id;      // Provided buffer
+    uint32_t offset;  // Bytes already read
+    uint32_t size;
+  };
+
+  uint64_t tag(UringTag::Operation operation) const noexcept {
+    return UringTag{ operation, m_socket, m_generation }.encode();
+  }
+
+  void submitSend(void);
+
+  Uring& m_uring;
+  int m_socket;
+  uint32_t m_generation;
+
+  ReceiveState m_receive = ReceiveState::Idle;
+  std::deque<Received> m_input{};
+  bool m_peer_closed = false;
+  int m_error = 0;  // Reported by `read()` and `write()` once set
+
+  std::vector<std::byte> m_send_buffer{};
+  size_t m_send_offset = 0;
+  bool m_sending = false;
+};
+
+} // namespace transport
+
+#endif /* UringTransport.hpp */
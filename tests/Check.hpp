@@ -0,0 +1,49 @@
+/**
+ * @file Check.hpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Assertions of test programs
+ *
+ * Every test in `tests/` is a program of its own, built and run by
+ * `make test`. Failed `CHECK()` is reported to `stderr` and the test goes
+ * on, so that one run shows every failure. Test returns `test::result()`
+ * from `main()`.
+ *
+ * @version 0.0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#ifndef __TESTS_CHECK_HPP
+#define __TESTS_CHECK_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace test {
+
+inline size_t s_failures = 0;
+
+/**
+ * @brief Exit status of test, reporting number of failed checks
+ */
+inline int result(void) {
+  if (s_failures > 0) {
+    fprintf(stderr, "%zu check(s) failed\n", s_failures);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace test
+
+#define CHECK(condition)                                                    \
+  do {                                                                      \
+    if (!(condition)) {                                                     \
+      fprintf(stderr, "%s:%d: check failed: %s\n",                          \
+          __FILE__, __LINE__, #condition);                                  \
+      ++test::s_failures;                                                   \
+    }                                                                       \
+  } while (0)
+
+#endif /* Check.hpp */
@@ -0,0 +1,299 @@
+/**
+ * @file CommentLogTest.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Recovery of comment log after crashes and damage
+ *
+ * Every case writes log into a fresh temporary directory, damages its
+ * files the way a crash or faulty disk would, and checks which comments
+ * recovery reports and which files it leaves behind.
+ *
+ * @version 0.0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Check.hpp"
+#include "Storage/CommentLog.hpp"
+#include "Storage/CommentRecord.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using storage::CommentLog;
+using storage::CommentRecord;
+
+// Record of current segments is preceded by its size and checksum
+static constexpr size_t RecordHeaderSize = 2 * sizeof(uint32_t);
+
+static std::string segment_path(
+    const std::string& directory,
+    size_t first_index,
+    const char* extension = ".clog"
+) {
+  char name[32] = "";
+  snprintf(name, sizeof(name), "%020zu%s", first_index, extension);
+  return directory + "/" + name;
+}
+
+static std::string comment_text(size_t index) {
+  return "comment " + std::to_string(index) + std::string(index % 13, '!');
+}
+
+static size_t record_size(size_t index) {
+  return RecordHeaderSize
+    + CommentRecord::allocSize(comment_text(index).size());
+}
+
+static std::string make_directory(void) {
+  char name[] = "/tmp/comment-log-test-XXXXXX";
+  if (mkdtemp(name) == nullptr) {
+    perror("mkdtemp");
+    exit(EXIT_FAILURE);
+  }
+  return name;
+}
+
+/**
+ * @brief Open log and recover its comments
+ *
+ * @return Recovered comment texts, empty if recovery failed
+ */
+static std::vector<std::string> recover(
+    const std::string& directory,
+    bool& recovered
+) {
+  std::vector<std::string> texts;
+  CommentLog log(directory);
+  recovered = log.recover([&texts](const CommentRecord& comment) {
+    texts.emplace_back(comment.getText());
+  });
+  return texts;
+}
+
+/**
+ * @brief Append comments [`first`, `end`) to log in `directory`
+ */
+static void write_comments(
+    const std::string& directory,
+    size_t first,
+    size_t end
+) {
+  CommentLog log(directory);
+  bool recovered = log.recover([](const CommentRecord&) {});
+  CHECK(recovered);
+
+  for (size_t i = first; i < end; ++i) {
+    const std::string text = comment_text(i);
+
+    // Records are aligned like those of comment store
+    std::vector<uint64_t> buffer(
+        CommentRecord::allocSize(text.size()) / sizeof(uint64_t) + 1, 0
+    );
+    CommentRecord* record = reinterpret_cast<CommentRecord*>(buffer.data());
+    record->timestamp = i;
+    record->author = 0;
+    record->size = (uint32_t) text.size();
+    std::memcpy(record->text, text.data(), text.size());
+
+    log.append(*record);
+  }
+  // Destructor commits pending comments
+}
+
+static bool has_comments(
+    const std::vector<std::string>& texts,
+    size_t count
+) {
+  if (texts.size() != count) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (texts[i] != comment_text(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void patch_file(
+    const std::string& path,
+    size_t offset,
+    std::span<const char> bytes
+) {
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp((std::streamoff) offset);
+  file.write(bytes.data(), (std::streamsize) bytes.size());
+}
+
+static void test_round_trip(void) {
+  const std::string directory = make_directory();
+  write_comments(directory, 0, 100);
+  write_comments(directory, 100, 150);
+
+  bool recovered = false;
+  CHECK(has_comments(recover(directory, recovered), 150));
+  CHECK(recovered);
+
+  fs::remove_all(directory);
+}
+
+static void test_torn_tail(void) {
+  const std::string directory = make_directory();
+  write_comments(directory, 0, 20);
+
+  // Crash in the middle of writing the last record
+  const std::string segment = segment_path(directory, 0);
+  const size_t size = fs::file_size(segment);
+  fs::resize_file(segment, size - 3);
+
+  bool recovered = false;
+  CHECK(has_comments(recover(directory, recovered), 19));
+  CHECK(recovered);
+  CHECK(fs::file_size(segment) == size - record_size(19));
+  CHECK(!fs::exists(segment + ".orphan"));
+
+  // Log goes on right after the last intact record
+  write_comments(directory, 19, 25);
+  CHECK(has_comments(recover(directory, recovered), 25));
+
+  fs::remove_all(directory);
+}
+
+static void test_bad_checksum(void) {
+  const std::string directory = make_directory();
+  write_comments(directory, 0, 20);
+
+  // Damage text of the last record, leaving its layout intact
+  const std::string segment = segment_path(directory, 0);
+  const size_t last = fs::file_size(segment) - record_size(19);
+  const char damage[] = "?";
+  patch_file(
+      segment, last + RecordHeaderSize + sizeof(CommentRecord),
+      std::span(damage, 1)
+  );
+
+  bool recovered = false;
+  CHECK(has_comments(recover(directory, recovered), 19));
+  CHECK(recovered);
+  CHECK(fs::file_size(segment) == last);
+
+  fs::remove_all(directory);
+}
+
+static void test_damaged_sealed_segment(void) {
+  const std::string directory = make_directory();
+  write_comments(directory, 0, 20);
+
+  // Sealed segment followed by one more
+  const std::string first = segment_path(directory, 0);
+  const std::string second = segment_path(directory, 20);
+  fs::copy_file(first, second);
+
+  bool recovered = false;
+  CHECK(recover(directory, recovered).size() == 40);
+
+  // Damaged size of record 10 makes the rest of the log unusable
+  size_t offset = 0;
+  for (size_t i = 0; i < 10; ++i) {
+    offset += record_size(i);
+  }
+  const size_t size = fs::file_size(first);
+  const uint32_t bad_size = 0xFFFFFF;
+  patch_file(
+      first, offset,
+      std::span(reinterpret_cast<const char*>(&bad_size), sizeof(bad_size))
+  );
+
+  CHECK(has_comments(recover(directory, recovered), 10));
+  CHECK(recovered);
+  CHECK(fs::file_size(first) == offset);
+
+  // Nothing is deleted, operator decides what to restore
+  CHECK(fs::file_size(first + ".orphan") == size - offset);
+  CHECK(!fs::exists(second));
+  CHECK(fs::file_size(second + ".orphan") == size);
+
+  fs::remove_all(directory);
+}
+
+static uint32_t crc32c(std::string_view bytes) {
+  uint32_t crc = ~uint32_t(0);
+  for (char c : bytes) {
+    crc ^= (uint8_t) c;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+    }
+  }
+  return ~crc;
+}
+
+static void test_interrupted_migration(void) {
+  const std::string directory = make_directory();
+
+  // Legacy record is | uint32_t size | uint32_t crc32c | comment | '\0' |
+  std::string legacy;
+  for (size_t i = 0; i < 30; ++i) {
+    const std::string text = comment_text(i);
+    const uint32_t header[2] = { (uint32_t) text.size(), crc32c(text) };
+    legacy.append(reinterpret_cast<const char*>(header), sizeof(header));
+    legacy.append(text);
+    legacy.push_back('\0');
+  }
+  std::ofstream(segment_path(directory, 0, ".log"), std::ios::binary)
+    << legacy;
+
+  // Conversion stopped after writing part of the current segment
+  std::ofstream(directory + "/MIGRATING");
+  std::ofstream(segment_path(directory, 0), std::ios::binary)
+    << legacy.substr(0, legacy.size() / 2);
+
+  bool recovered = false;
+  CHECK(has_comments(recover(directory, recovered), 30));
+  CHECK(recovered);
+  CHECK(!fs::exists(directory + "/MIGRATING"));
+  CHECK(!fs::exists(segment_path(directory, 0, ".log")));
+
+  // Converted log is recovered as current one
+  CHECK(has_comments(recover(directory, recovered), 30));
+  CHECK(recovered);
+
+  fs::remove_all(directory);
+}
+
+static void test_mixed_formats(void) {
+  const std::string directory = make_directory();
+  write_comments(directory, 0, 5);
+
+  // Without marker, current segments may hold comments legacy ones do not
+  std::ofstream(segment_path(directory, 0, ".log"), std::ios::binary);
+
+  bool recovered = true;
+  CHECK(recover(directory, recovered).empty());
+  CHECK(!recovered);
+  CHECK(fs::exists(segment_path(directory, 0)));
+
+  fs::remove_all(directory);
+}
+
+int main(void) {
+  test_round_trip();
+  test_torn_tail();
+  test_bad_checksum();
+  test_damaged_sealed_segment();
+  test_interrupted_migration();
+  test_mixed_formats();
+
+  return test::result();
+}
@@ -0,0 +1,237 @@
+/**
+ * @file CompressionTest.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Round trip of block codec and compressed frames, and rejection of
+ * malformed compressed input
+ *
+ * @version 0.0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Check.hpp"
+#include "Message/Compression.hpp"
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+using message::Compression;
+using message::Message;
+using message::MessageView;
+
+static std::vector<std::byte> text_bytes(size_t size) {
+  static const char* const words[] = {
+    "the ", "comment ", "server ", "is ", "fast ", "and ", "works ", "well ",
+  };
+  std::mt19937 random(1);
+
+  std::vector<std::byte> bytes;
+  while (bytes.size() < size) {
+    const char* word = words[random() % std::size(words)];
+    for (size_t i = 0; word[i] != '\0' && bytes.size() < size; ++i) {
+      bytes.push_back(std::byte(word[i]));
+    }
+  }
+  return bytes;
+}
+
+static std::vector<std::byte> random_bytes(size_t size) {
+  std::mt19937 random(2);
+
+  std::vector<std::byte> bytes(size);
+  for (std::byte& byte : bytes) {
+    byte = std::byte(random());
+  }
+  return bytes;
+}
+
+static bool round_trips(const std::vector<std::byte>& input) {
+  std::vector<std::byte> compressed;
+  message::lz_compress(input, compressed);
+  if (compressed.size() > message::lz_compress_bound(input.size())) {
+    return false;
+  }
+
+  std::vector<std::byte> restored(input.size());
+  return message::lz_decompress(compressed, restored) && restored == input;
+}
+
+static void test_codec_round_trip(void) {
+  CHECK(round_trips({}));
+  CHECK(round_trips(text_bytes(1)));
+  CHECK(round_trips(text_bytes(15)));
+  CHECK(round_trips(text_bytes(4096)));
+  CHECK(round_trips(text_bytes(1 << 20)));
+  CHECK(round_trips(random_bytes(4096)));
+  CHECK(round_trips(std::vector<std::byte>(100000, std::byte{'a'})));
+
+  std::vector<std::byte> compressed;
+  message::lz_compress(text_bytes(4096), compressed);
+  CHECK(compressed.size() < 4096 / 2);
+}
+
+static void test_codec_rejects_malformed(void) {
+  const std::vector<std::byte> input = text_bytes(4096);
+  std::vector<std::byte> compressed;
+  message::lz_compress(input, compressed);
+
+  // Output size must match exactly
+  std::vector<std::byte> shorter(input.size() - 1);
+  std::vector<std::byte> longer(input.size() + 1);
+  CHECK(!message::lz_decompress(compressed, shorter));
+  CHECK(!message::lz_decompress(compressed, longer));
+
+  // Every truncation of valid block is detected
+  std::vector<std::byte> restored(input.size());
+  for (size_t size = 0; size < compressed.size(); ++size) {
+    CHECK(!message::lz_decompress(
+        std::span(compressed).first(size), restored
+    ));
+  }
+
+  // Garbage never reads or writes out of bounds, which sanitizers check
+  std::mt19937 random(3);
+  for (size_t attempt = 0; attempt < 1000; ++attempt) {
+    std::vector<std::byte> garbage = random_bytes(1 + random() % 256);
+    garbage[0] = std::byte(random());
+    std::vector<std::byte> output(random() % 1024);
+    message::lz_decompress(garbage, output);
+  }
+
+  // Match reaching before the start of output is rejected
+  const std::byte far_match[] = {
+    std::byte{0x04}, std::byte{0x00}, std::byte{0x10}
+  };
+  std::vector<std::byte> output(8);
+  CHECK(!message::lz_decompress(far_match, output));
+}
+
+static std::vector<std::byte> batch_frame(size_t count) {
+  std::vector<std::string> comments;
+  for (size_t i = 0; i < count; ++i) {
+    comments.push_back("comment number " + std::to_string(i));
+  }
+
+  const Message message = Message::newCommentsBatch(comments);
+  const auto bytes = message.getBytes();
+  return std::vector<std::byte>(bytes.begin(), bytes.end());
+}
+
+static void test_frame_round_trip(void) {
+  const std::vector<std::byte> frame = batch_frame(500);
+
+  std::vector<std::byte> compressed;
+  CHECK(Compression::compressFrame(frame, compressed));
+  CHECK(compressed.size() < frame.size());
+
+  size_t message_size = 0;
+  auto view = MessageView::fromBytes(compressed, message_size);
+  CHECK(view.has_value() && view->isCompressed());
+  CHECK(message_size == compressed.size());
+  if (!view.has_value()) {
+    return;
+  }
+
+  std::vector<std::byte> inflated;
+  auto restored = Compression::decompressFrame(*view, inflated);
+  CHECK(restored.has_value() && !restored->isCompressed());
+  CHECK(restored.has_value()
+      && restored->getType() == Message::Type::NewCommentsBatch);
+  CHECK(inflated == frame);
+
+  // Small payloads are sent as they are
+  CHECK(!Compression::compressFrame(batch_frame(1), compressed));
+}
+
+/**
+ * @brief Compressed frame with given raw size and compressed payload
+ */
+static std::vector<std::byte> compressed_frame(
+    Message::Type type,
+    uint32_t raw_size,
+    std::span<const std::byte> payload
+) {
+  const uint32_t payload_size =
+    (uint32_t) (sizeof(raw_size) + payload.size());
+
+  std::vector<std::byte> frame = {
+    std::byte{'M'}, std::byte{'S'}, std::byte{'G'},
+    std::byte((uint8_t) type | Message::CompressedFlag),
+  };
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    frame.push_back(std::byte(payload_size >> shift));
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    frame.push_back(std::byte(raw_size >> shift));
+  }
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  return frame;
+}
+
+static bool decompresses(const std::vector<std::byte>& frame) {
+  size_t message_size = 0;
+  auto view = MessageView::fromBytes(frame, message_size);
+  if (!view.has_value()) {
+    return false;
+  }
+
+  std::vector<std::byte> inflated;
+  return Compression::decompressFrame(*view, inflated).has_value();
+}
+
+static void test_frame_rejects_malformed(void) {
+  const std::vector<std::byte> frame = batch_frame(500);
+  std::vector<std::byte> compressed;
+  Compression::compressFrame(frame, compressed);
+  const auto payload =
+    std::span(compressed).subspan(Message::MinSize + sizeof(uint32_t));
+  const uint32_t raw_size = (uint32_t) (frame.size() - Message::MinSize);
+
+  CHECK(decompresses(compressed_frame(
+      Message::Type::NewCommentsBatch, raw_size, payload
+  )));
+
+  // Declared size disagrees with compressed data
+  CHECK(!decompresses(compressed_frame(
+      Message::Type::NewCommentsBatch, raw_size + 1, payload
+  )));
+  CHECK(!decompresses(compressed_frame(
+      Message::Type::NewCommentsBatch, 0, payload
+  )));
+
+  // Too large to inflate at all
+  CHECK(!decompresses(compressed_frame(
+      Message::Type::NewCommentsBatch,
+      (uint32_t) message::MaxDecompressedSize + 1, payload
+  )));
+
+  // Inflated payload must be valid for its type
+  const std::byte tiny[] = { std::byte{'a'}, std::byte{'\0'} };
+  std::vector<std::byte> tiny_compressed;
+  message::lz_compress(tiny, tiny_compressed);
+  CHECK(!decompresses(compressed_frame(
+      Message::Type::CommentsResponse, sizeof(tiny), tiny_compressed
+  )));
+
+  // Fixed-size messages are never compressed
+  CHECK(!decompresses(compressed_frame(
+      Message::Type::CommentsRequest, raw_size, payload
+  )));
+}
+
+int main(void) {
+  test_codec_round_trip();
+  test_codec_rejects_malformed();
+  test_frame_round_trip();
+  test_frame_rejects_malformed();
+
+  return test::result();
+}
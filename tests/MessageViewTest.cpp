@@ -0,0 +1,186 @@
+/**
+ * @file MessageViewTest.cpp
+ * @author MeerkatBoss (solodovnikov.ia@phystech.su)
+ *
+ * @brief Validation of received frames by `MessageView::fromBytes()`
+ *
+ * Reader relies on `message_size` to tell incomplete frame, which it reads
+ * further, from invalid one, which it drops. Both are checked here along
+ * with frames of every kind that must be rejected.
+ *
+ * @version 0.0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright MeerkatBoss (c) 2024
+ */
+#include "Check.hpp"
+#include "Message/Message.hpp"
+#include "Message/MessageView.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+using message::Message;
+using message::MessageView;
+
+static std::vector<std::byte> frame(
+    uint8_t type,
+    uint32_t payload_size,
+    std::span<const std::byte> payload = {}
+) {
+  std::vector<std::byte> bytes = {
+    std::byte{'M'}, std::byte{'S'}, std::byte{'G'}, std::byte(type),
+  };
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    bytes.push_back(std::byte(payload_size >> shift));
+  }
+  bytes.insert(bytes.end(), payload.begin(), payload.end());
+  return bytes;
+}
+
+static std::vector<std::byte> frame(
+    Message::Type type,
+    std::span<const std::byte> payload
+) {
+  return frame((uint8_t) type, (uint32_t) payload.size(), payload);
+}
+
+static std::vector<std::byte> bytes_of(const Message& message) {
+  const auto bytes = message.getBytes();
+  return std::vector<std::byte>(bytes.begin(), bytes.end());
+}
+
+/**
+ * @brief Frame is rejected as invalid, rather than waiting for more bytes
+ */
+static bool is_invalid(std::span<const std::byte> bytes) {
+  size_t message_size = 0;
+  auto view = MessageView::fromBytes(bytes, message_size);
+  return !view.has_value() && message_size == 0;
+}
+
+static void test_valid_frames(void) {
+  const std::string comment = "hello, world";
+  const std::vector<std::string> batch = { "first", "", "third" };
+  const Message messages[] = {
+    Message::hello(Message::CapabilityCompression, 7),
+    Message::goodbye(),
+    Message::newComment(comment),
+    Message::getComments(10, 20, 4096, Message::ResponseEncoding::Indexed),
+    Message::getCommentsSince(123456),
+    Message::newCommentsBatch(batch),
+    Message::getStats(),
+    Message::searchComments("apple banana", 5, 10),
+  };
+
+  for (const Message& message : messages) {
+    // Frame is followed by the next one in the same buffer
+    std::vector<std::byte> bytes = bytes_of(message);
+    const size_t size = bytes.size();
+    const std::vector<std::byte> next = bytes_of(Message::goodbye());
+    bytes.insert(bytes.end(), next.begin(), next.end());
+
+    size_t message_size = 0;
+    auto view = MessageView::fromBytes(bytes, message_size);
+    CHECK(view.has_value());
+    CHECK(message_size == size);
+    CHECK(view.has_value() && view->getBytes().size() == size);
+  }
+}
+
+static void test_truncated_frames(void) {
+  const std::vector<std::byte> bytes =
+    bytes_of(Message::newComment(std::string(100, 'c')));
+
+  // Header is incomplete, size is not known yet
+  for (size_t size = 0; size < Message::MinSize; ++size) {
+    size_t message_size = 0;
+    auto view =
+      MessageView::fromBytes(std::span(bytes).first(size), message_size);
+    CHECK(!view.has_value());
+    CHECK(message_size <= Message::MinSize);
+  }
+
+  // Header tells how much more to read
+  for (size_t size = Message::MinSize; size < bytes.size(); ++size) {
+    size_t message_size = 0;
+    auto view =
+      MessageView::fromBytes(std::span(bytes).first(size), message_size);
+    CHECK(!view.has_value());
+    CHECK(message_size == bytes.size());
+  }
+}
+
+static void test_wrong_type(void) {
+  // Unknown types
+  CHECK(is_invalid(frame(0x7F, 0)));
+  CHECK(is_invalid(frame(0x40, 4, std::as_bytes(std::span("abc", 4)))));
+
+  // Messages which never carry payload
+  const std::byte payload[4] = {};
+  CHECK(is_invalid(frame(Message::Type::Goodbye, payload)));
+  CHECK(is_invalid(frame(Message::Type::GetStats, payload)));
+
+  // Messages which always carry payload
+  CHECK(is_invalid(frame(Message::Type::CommentsRequest, {})));
+  CHECK(is_invalid(frame(Message::Type::CommentsBatchOk, {})));
+
+  // Fixed payload of wrong size
+  const std::byte odd[3] = {};
+  CHECK(is_invalid(frame(Message::Type::Hello, odd)));
+  CHECK(is_invalid(frame(Message::Type::CommentsRequest, odd)));
+  CHECK(is_invalid(frame(Message::Type::Subscribe, odd)));
+  CHECK(is_invalid(frame(Message::Type::CommentsSinceRequest, odd)));
+
+  // Fixed-size messages are never compressed
+  CHECK(is_invalid(frame(
+      (uint8_t) Message::Type::CommentsRequest | Message::CompressedFlag,
+      (uint32_t) sizeof(payload), payload
+  )));
+
+  // Bad magic
+  std::vector<std::byte> bytes = bytes_of(Message::goodbye());
+  bytes[0] = std::byte{'X'};
+  CHECK(is_invalid(bytes));
+}
+
+static void test_oversize_frames(void) {
+  // Rejected from header alone, without waiting for payload
+  CHECK(is_invalid(frame(
+      (uint8_t) Message::Type::NewComment, (uint32_t) Message::MaxPayloadSize + 1
+  )));
+  CHECK(is_invalid(frame(
+      (uint8_t) Message::Type::NewCommentsBatch | Message::CompressedFlag,
+      UINT32_MAX
+  )));
+
+  // Largest payload is still read
+  size_t message_size = 0;
+  auto view = MessageView::fromBytes(
+      frame(
+        (uint8_t) Message::Type::NewComment, (uint32_t) Message::MaxPayloadSize
+      ),
+      message_size
+  );
+  CHECK(!view.has_value());
+  CHECK(message_size == Message::MinSize + Message::MaxPayloadSize);
+
+  // Batch of too many comments, even empty ones
+  std::vector<std::byte> empty_comments(Message::MaxBatchCount + 1);
+  CHECK(is_invalid(frame(Message::Type::NewCommentsBatch, empty_comments)));
+  empty_comments.pop_back();
+  CHECK(!is_invalid(frame(Message::Type::NewCommentsBatch, empty_comments)));
+}
+
+int main(void) {
+  test_valid_frames();
+  test_truncated_frames();
+  test_wrong_type();
+  test_oversize_frames();
+
+  return test::result();
+}